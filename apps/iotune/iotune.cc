@@ -667,6 +667,10 @@ int main(int ac, char** av) {
                 auto read_iops = iotune_tests.read_random_data(test_directory.minimum_io_size(), duration * 0.1).get0();
                 fmt::print("{} IOPS\n", uint64_t(read_iops.iops));
 
+                // The I/O scheduler charges writes by these ratios, relative to reads.
+                fmt::print("Write cost relative to read: {:.2f}x bandwidth, {:.2f}x IOPS\n",
+                        read_bw.bytes_per_sec / write_bw.bytes_per_sec, read_iops.iops / write_iops.iops);
+
                 struct disk_descriptor desc;
                 desc.mountpoint = mountpoint;
                 desc.read_iops = read_iops.iops;
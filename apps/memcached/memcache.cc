@@ -1224,6 +1224,9 @@ class udp_server {
 public:
     static const size_t default_max_datagram_size = 1400;
 private:
+    // Most requests received at once; their replies are sent together
+    static constexpr size_t max_batch = 32;
+    using reply_batch = std::vector<std::pair<socket_address, packet>>;
     compat::optional<future<>> _task;
     sharded_cache& _cache;
     distributed<system_stats>& _system_stats;
@@ -1260,19 +1263,49 @@ class udp_server {
             , _proto(c, system_stats)
         {}
 
-        future<> respond(udp_channel& chan) {
+        void respond(reply_batch& replies) {
             int i = 0;
-            return do_for_each(_out_bufs.begin(), _out_bufs.end(), [this, i, &chan] (packet& p) mutable {
+            for (auto&& p : _out_bufs) {
                 header* out_hdr = p.prepend_header<header>(0);
                 out_hdr->_request_id = _request_id;
                 out_hdr->_sequence_number = i++;
                 out_hdr->_n = _out_bufs.size();
                 *out_hdr = hton(*out_hdr);
-                return chan.send(_src, std::move(p));
-            });
+                replies.emplace_back(_src, std::move(p));
+            }
         }
     };
 
+    future<> handle(udp_datagram& dgram, reply_batch& replies) {
+        packet& p = dgram.get_data();
+        if (p.len() < sizeof(header)) {
+            // dropping invalid packet
+            return make_ready_future<>();
+        }
+
+        header hdr = ntoh(*p.get_header<header>());
+        p.trim_front(sizeof(hdr));
+
+        auto request_id = hdr._request_id;
+        auto in = as_input_stream(std::move(p));
+        auto conn = make_lw_shared<connection>(dgram.get_src(), request_id, std::move(in),
+            _max_datagram_size - sizeof(header), _cache, _system_stats);
+
+        if (hdr._n != 1 || hdr._sequence_number != 0) {
+            return conn->_out.write("CLIENT_ERROR only single-datagram requests supported\r\n").then([conn] {
+                return conn->_out.flush();
+            }).then([conn, &replies] {
+                conn->respond(replies);
+            });
+        }
+
+        return conn->_proto.handle(conn->_in, conn->_out).then([conn] {
+            return conn->_out.flush();
+        }).then([conn, &replies] {
+            conn->respond(replies);
+        });
+    }
+
 public:
     udp_server(sharded_cache& c, distributed<system_stats>& system_stats, uint16_t port = 11211)
          : _cache(c)
@@ -1288,32 +1321,12 @@ class udp_server {
         _chan = make_udp_channel({_port});
         // Run in the background.
         _task = keep_doing([this] {
-            return _chan.receive().then([this](udp_datagram dgram) {
-                packet& p = dgram.get_data();
-                if (p.len() < sizeof(header)) {
-                    // dropping invalid packet
-                    return make_ready_future<>();
-                }
-
-                header hdr = ntoh(*p.get_header<header>());
-                p.trim_front(sizeof(hdr));
-
-                auto request_id = hdr._request_id;
-                auto in = as_input_stream(std::move(p));
-                auto conn = make_lw_shared<connection>(dgram.get_src(), request_id, std::move(in),
-                    _max_datagram_size - sizeof(header), _cache, _system_stats);
-
-                if (hdr._n != 1 || hdr._sequence_number != 0) {
-                    return conn->_out.write("CLIENT_ERROR only single-datagram requests supported\r\n").then([this, conn] {
-                        return conn->_out.flush().then([this, conn] {
-                            return conn->respond(_chan).then([conn] {});
-                        });
-                    });
-                }
-
-                return conn->_proto.handle(conn->_in, conn->_out).then([this, conn]() mutable {
-                    return conn->_out.flush().then([this, conn] {
-                        return conn->respond(_chan).then([conn] {});
+            return _chan.receive_batch(max_batch).then([this] (std::vector<udp_datagram> dgrams) {
+                return do_with(std::move(dgrams), reply_batch(), [this] (std::vector<udp_datagram>& dgrams, reply_batch& replies) {
+                    return parallel_for_each(dgrams, [this, &replies] (udp_datagram& dgram) {
+                        return handle(dgram, replies);
+                    }).then([this, &replies] {
+                        return _chan.send_batch(std::move(replies));
                     });
                 });
             });
@@ -0,0 +1,139 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#pragma once
+
+/// \file
+
+// A user-space cache of file blocks
+//
+// Files are opened with O_DIRECT, so repeated reads of the same data always
+// go to the disk. A block_cache keeps recently read blocks of the files that
+// were wrapped with make_cached_file() in memory, evicting the least recently
+// used ones when it is full or when the shard runs low on memory.
+
+#include <seastar/core/file.hh>
+#include <seastar/core/memory.hh>
+#include <seastar/core/metrics_registration.hh>
+#include <seastar/core/sstring.hh>
+#include <boost/intrusive/list.hpp>
+#include <unordered_map>
+#include <memory>
+
+namespace seastar {
+
+class cached_file_impl;
+
+/// A per-shard cache of file blocks.
+///
+/// The cache must outlive the files using it, and is only to be used on
+/// the shard that created it.
+class block_cache {
+public:
+    struct config {
+        size_t capacity = 64 * 1024 * 1024; ///< Maximum size of the cached blocks, in bytes
+        size_t block_size = 32 * 1024;      ///< Size of a cached block, a multiple of the files' read alignment
+        /// Value of the "cache" label of the cache's metrics. Must be unique
+        /// among the caches that exist at the same time on a shard.
+        sstring name = "default";
+    };
+    struct stats {
+        uint64_t hits = 0;          ///< Blocks read from the cache
+        uint64_t misses = 0;        ///< Blocks read from the disk
+        uint64_t evictions = 0;     ///< Blocks evicted to make room or release memory
+        uint64_t invalidations = 0; ///< Blocks dropped because their file was modified or closed
+        uint64_t bytes = 0;         ///< Memory held by cached blocks
+    };
+private:
+    struct key {
+        uint64_t file_id;
+        uint64_t index;
+        bool operator==(const key& o) const {
+            return file_id == o.file_id && index == o.index;
+        }
+    };
+    struct key_hash {
+        size_t operator()(const key& k) const {
+            return std::hash<uint64_t>()(k.file_id * 0x9e3779b97f4a7c15ull + k.index);
+        }
+    };
+    using auto_unlink_hook = boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>>;
+    struct block {
+        key k;
+        temporary_buffer<uint8_t> data;
+        auto_unlink_hook lru_link;
+        auto_unlink_hook file_link;
+    };
+    using lru_list = boost::intrusive::list<block,
+            boost::intrusive::member_hook<block, auto_unlink_hook, &block::lru_link>,
+            boost::intrusive::constant_time_size<false>>;
+    using file_list = boost::intrusive::list<block,
+            boost::intrusive::member_hook<block, auto_unlink_hook, &block::file_link>,
+            boost::intrusive::constant_time_size<false>>;
+
+    config _cfg;
+    std::unordered_map<key, block, key_hash> _blocks;
+    // Least recently used first
+    lru_list _lru;
+    uint64_t _next_file_id = 0;
+    stats _stats;
+    memory::reclaimer _reclaimer;
+    metrics::metric_groups _metrics;
+private:
+    temporary_buffer<uint8_t>* find(uint64_t file_id, uint64_t index);
+    void insert(uint64_t file_id, uint64_t index, temporary_buffer<uint8_t> data, file_list& owner);
+    void erase(const key& k);
+    void invalidate(uint64_t file_id, file_list& blocks, uint64_t from, uint64_t to);
+    size_t evict(size_t bytes);
+
+    friend class cached_file_impl;
+public:
+    /// \throws metrics::double_registration if another cache with the
+    ///         same name exists on this shard
+    explicit block_cache(config cfg);
+    ~block_cache();
+    block_cache(const block_cache&) = delete;
+    block_cache& operator=(const block_cache&) = delete;
+
+    size_t block_size() const {
+        return _cfg.block_size;
+    }
+    const stats& get_stats() const {
+        return _stats;
+    }
+    /// Changes the capacity, evicting blocks if the cache no longer fits.
+    void set_capacity(size_t capacity);
+    /// Evicts all blocks.
+    void clear();
+};
+
+/// Wraps a file with a read-through block cache.
+///
+/// Reads are served from \c cache, reading whole blocks from \c f on
+/// misses. Everything else is forwarded to \c f; modifications drop the
+/// blocks they affect, so reads never see stale data as long as the file
+/// is only modified through the returned object.
+///
+/// \throws std::invalid_argument if the cache's block size is not a
+///         multiple of the file's read alignment
+file make_cached_file(file f, block_cache& cache);
+
+}
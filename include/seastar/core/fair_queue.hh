@@ -26,6 +26,8 @@
 #include <seastar/util/noncopyable_function.hh>
 #include <queue>
 #include <chrono>
+#include <array>
+#include <atomic>
 #include <unordered_set>
 
 namespace seastar {
@@ -86,6 +88,53 @@ class fair_queue_ticket {
     /// It is however not legal for the axis to have any quantity set to zero.
     /// \param axis another \ref fair_queue_ticket to be used as a a base vector against which to normalize this fair_queue_ticket.
     float normalize(fair_queue_ticket axis) const;
+
+    friend class fair_queue;
+    friend class fair_group;
+};
+
+/// \brief Resources shared by several \ref fair_queue instances
+///
+/// Queues which dispatch to the same device, usually from different shards, can draw
+/// the resources they put in flight from a common pool instead of being limited to a
+/// static slice of the device each. A queue may always dispatch within its own capacity,
+/// which guarantees it a fair share of the device; beyond that it borrows from the pool
+/// for as long as the other queues leave something in it, so a busy queue can use the
+/// capacity idle ones don't need. Borrowed resources return to the pool as the requests
+/// complete. Since queues dispatching within their own capacity don't wait for borrowers,
+/// the device may transiently see up to twice the pool's capacity in flight.
+///
+/// The pool is a single lock-free counter which is safe to use from any shard.
+///
+/// \related fair_queue
+class fair_group {
+    // Resources left in the pool, as two signed 32-bit counters packed into
+    // one word so that both can be updated together. They become negative
+    // when queues dispatch within their own capacity from an empty pool.
+    std::atomic<uint64_t> _available;
+
+    static uint64_t pack(int64_t weight, int64_t size) noexcept;
+    static int32_t weight(uint64_t packed) noexcept;
+    static int32_t size(uint64_t packed) noexcept;
+public:
+    /// Constructs a pool with the given \c capacity, which is clamped so that
+    /// overdrawing it cannot overflow.
+    explicit fair_group(fair_queue_ticket capacity);
+    fair_group(const fair_group&) = delete;
+    fair_group(fair_group&&) = delete;
+
+    /// Takes \c desc out of the pool.
+    ///
+    /// \param desc the resources to take
+    /// \param force take the resources even if nothing is left in the pool
+    /// \return true if the resources were taken
+    bool grab(fair_queue_ticket desc, bool force) noexcept;
+
+    /// Returns \c desc to the pool.
+    void release(fair_queue_ticket desc) noexcept;
+
+    /// \return the resources currently left in the pool
+    fair_queue_ticket available() const noexcept;
 };
 
 /// \addtogroup io-module
@@ -163,10 +212,50 @@ class fair_queue {
         std::chrono::microseconds tau = std::chrono::milliseconds(100);
         unsigned max_req_count = std::numeric_limits<unsigned>::max();
         unsigned max_bytes_count = std::numeric_limits<unsigned>::max();
+        /// When non-zero, the queue adjusts its capacity so that the \c latency_quantile
+        /// of the requests' latencies stays within \c latency_target, see
+        /// \ref notify_request_latency(). \c max_req_count and \c max_bytes_count are
+        /// then only the initial capacity.
+        std::chrono::microseconds latency_target = std::chrono::microseconds(0);
+        float latency_quantile = 0.99;
+        /// Minimal period between two capacity adjustments.
+        std::chrono::microseconds latency_window = std::chrono::milliseconds(10);
+        /// When set, resources are drawn from this pool as well, and the queue can
+        /// go beyond its own capacity while the pool has resources left. The pool
+        /// must outlive the queue.
+        fair_group* group = nullptr;
     };
 private:
     friend priority_class;
 
+    using latency_clock = std::chrono::steady_clock;
+    // Requests are grouped into size classes by the log2 of their ticket's size.
+    static constexpr unsigned nr_latency_size_classes = 32;
+    // Number of windows during which the minimal latency of a size class is tracked.
+    static constexpr unsigned latency_baseline_windows = 64;
+
+    struct latency_state {
+        // Minimal latency of each size class over the current and the previous
+        // period of latency_baseline_windows windows, approximating the latency
+        // of requests of that size on an idle device.
+        std::array<latency_clock::duration, nr_latency_size_classes> baseline;
+        std::array<latency_clock::duration, nr_latency_size_classes> prev_baseline;
+        unsigned windows = 0;
+        // Enough samples for the configured quantile to be meaningful.
+        unsigned min_samples = 1;
+        latency_clock::time_point window_start = latency_clock::now();
+        unsigned samples = 0;
+        unsigned late = 0;
+        fair_queue_ticket completed;
+        fair_queue_ticket peak_executing;
+        bool throttled = false;
+
+        latency_state() {
+            baseline.fill(latency_clock::duration::max());
+            prev_baseline.fill(latency_clock::duration::max());
+        }
+    };
+
     struct class_compare {
         bool operator() (const priority_class_ptr& lhs, const priority_class_ptr& rhs) const {
             return lhs->_accumulated > rhs->_accumulated;
@@ -178,6 +267,7 @@ class fair_queue {
     fair_queue_ticket _current_capacity;
     fair_queue_ticket _resources_executing;
     fair_queue_ticket _resources_queued;
+    fair_group* _group;
     unsigned _requests_executing = 0;
     unsigned _requests_queued = 0;
     using clock_type = std::chrono::steady_clock::time_point;
@@ -185,6 +275,7 @@ class fair_queue {
     using prioq = std::priority_queue<priority_class_ptr, std::vector<priority_class_ptr>, class_compare>;
     prioq _handles;
     std::unordered_set<priority_class_ptr> _all_classes;
+    latency_state _latency;
 
     void push_priority_class(priority_class_ptr pc);
 
@@ -195,6 +286,8 @@ class fair_queue {
     void normalize_stats();
 
     bool can_dispatch() const;
+
+    void adjust_capacity();
 public:
     /// Constructs a fair queue with configuration parameters \c cfg.
     ///
@@ -232,6 +325,9 @@ class fair_queue {
     /// \return the amount of resources (weight, size) currently executing
     fair_queue_ticket resources_currently_executing() const;
 
+    /// \return the amount of resources (weight, size) allowed to execute at the same time
+    fair_queue_ticket current_capacity() const;
+
     /// Queue the function \c func through this class' \ref fair_queue, with weight \c weight
     ///
     /// It is expected that \c func doesn't throw. If it does throw, it will be just removed from
@@ -245,6 +341,20 @@ class fair_queue {
     /// \param desc an instance of \c fair_queue_ticket structure describing the request that just finished.
     void notify_requests_finished(fair_queue_ticket desc);
 
+    /// Reports the latency of a request which finished executing.
+    ///
+    /// Only used when the queue is configured with a latency target. A request
+    /// is late when its latency exceeds the minimal recent latency of requests
+    /// of its size by more than the target, so the target bounds the time spent
+    /// waiting in an overcommitted device rather than the transfer time of large
+    /// requests. Once per window, the queue backs off from the resources it had
+    /// in flight if too many requests were late, and allows more resources to
+    /// execute if none were and requests had to wait for capacity.
+    ///
+    /// \param desc the \c fair_queue_ticket describing the request
+    /// \param latency the time between dispatching the request and its completion
+    void notify_request_latency(fair_queue_ticket desc, std::chrono::steady_clock::duration latency);
+
     /// Try to execute new requests if there is capacity left in the queue.
     void dispatch_requests();
 
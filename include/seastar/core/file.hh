@@ -78,6 +78,7 @@ struct file_open_options {
     bool sloppy_size = false; ///< Allow the file size not to track the amount of data written until a flush
     uint64_t sloppy_size_hint = 1 << 20; ///< Hint as to what the eventual file size will be
     file_permissions create_permissions = file_permissions::default_file_permissions; ///< File permissions to use when creating a file
+    bool register_fd = false; ///< Register the file descriptor with the kernel for the lifetime of the file, where the reactor backend supports it, to save a file lookup on every I/O
 };
 
 /// \cond internal
@@ -465,6 +466,14 @@ struct file::read_state {
     , _to_read(to_read)
     , _front(front) {}
 
+    // Reads into a caller-provided buffer, which must be suitably aligned
+    // and at least align_up(to_read, disk_alignment) bytes long.
+    read_state(uint64_t offset, uint64_t front, size_t to_read, tmp_buf_type buffer)
+    : buf(std::move(buffer))
+    , _offset(offset)
+    , _to_read(to_read)
+    , _front(front) {}
+
     bool done() const {
         return eof || pos >= _to_read;
     }
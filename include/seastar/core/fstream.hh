@@ -55,8 +55,23 @@ struct file_input_stream_options {
     unsigned read_ahead = 0;      ///< Maximum number of extra read-ahead operations
     ::seastar::io_priority_class io_priority_class = default_priority_class();
     lw_shared_ptr<file_input_stream_history> dynamic_adjustments = { }; ///< Input stream history, if null dynamic adjustments are disabled
+    /// Adaptive read-ahead: sequential reads grow the buffer size towards
+    /// \c max_buffer_size and read-ahead towards \c max_read_ahead, while
+    /// skips shrink them back to \c buffer_size and \c read_ahead. Growth
+    /// stops when the shard's read-ahead memory limit is reached (see
+    /// set_file_input_stream_read_ahead_memory_limit()). \c dynamic_adjustments
+    /// is ignored in this mode.
+    bool adaptive_read_ahead = false;
+    size_t max_buffer_size = 1024 * 1024; ///< Maximum I/O buffer size for adaptive read-ahead
+    unsigned max_read_ahead = 8;          ///< Maximum number of extra read-ahead operations for adaptive read-ahead
 };
 
+/// Limits the memory held by buffers which file input streams of the
+/// current shard have read, or are reading, but which were not yet consumed.
+/// Streams using adaptive read-ahead stop growing and issuing read-aheads
+/// beyond the current read while the limit is exceeded. The default is 64MB.
+void set_file_input_stream_read_ahead_memory_limit(size_t limit);
+
 /// \brief Creates an input_stream to read a portion of a file.
 ///
 /// \param file File to read; multiple streams for the same file may coexist
@@ -92,6 +107,15 @@ struct file_output_stream_options {
     unsigned buffer_size = 65536;
     unsigned preallocation_size = 0; ///< Preallocate extents. For large files, set to a large number (a few megabytes) to reduce fragmentation
     unsigned write_behind = 1; ///< Number of buffers to write in parallel
+    /// Buffers put while all write-behind slots are busy are merged into a
+    /// single vectored write of up to this many bytes, issued when a slot
+    /// frees up. Zero, the default, disables merging.
+    ///
+    /// While merging, put() does not wait for a free slot, so the stream can
+    /// hold up to this many bytes of pending buffers in addition to the ones
+    /// being written. 1MB, the request size iotune uses to measure
+    /// sequential write bandwidth, is a reasonable value.
+    unsigned max_coalesced_write = 0;
     ::seastar::io_priority_class io_priority_class = default_priority_class();
 };
 
@@ -60,6 +60,10 @@ class io_request {
         socklen_t socklen;
     } _size;
     kernel_completion* _kernel_completion;
+    // Resources pre-registered with the kernel that this request may use
+    // instead of the raw buffer/fd (-1: not registered).
+    int _fixed_buffer = -1;
+    int _fixed_file = -1;
 
     explicit io_request(operation op, int fd, int flags, ::msghdr* msg)
         : _op(op)
@@ -207,6 +211,22 @@ class io_request {
         return _kernel_completion;
     }
 
+    void set_fixed_buffer(int index) {
+        _fixed_buffer = index;
+    }
+
+    int fixed_buffer() const {
+        return _fixed_buffer;
+    }
+
+    void set_fixed_file(int slot) {
+        _fixed_file = slot;
+    }
+
+    int fixed_file() const {
+        return _fixed_file;
+    }
+
     static io_request make_read(int fd, uint64_t pos, void* address, size_t size) {
         return io_request(operation::read, fd, pos, reinterpret_cast<char*>(address), size);
     }
@@ -34,6 +34,7 @@ class reactor;
 class pollable_fd;
 class pollable_fd_state;
 class socket_address;
+class file;
 
 namespace internal {
 
@@ -70,6 +71,8 @@ class pollable_fd_state {
     int events_requested = 0; // wanted by pollin/pollout promises
     int events_epoll = 0;     // installed in epoll
     int events_known = 0;     // returned from epoll
+    size_t zero_copy_threshold = 0; // packets at least this large are sent with MSG_ZEROCOPY, 0 disables
+    uint32_t zero_copy_seq = 0;     // number of MSG_ZEROCOPY sends so far, identifies their completions
 
     friend class reactor;
     friend class pollable_fd;
@@ -91,7 +94,11 @@ class pollable_fd_state {
     future<> connect(socket_address& sa);
     future<size_t> sendmsg(struct msghdr *msg);
     future<size_t> recvmsg(struct msghdr *msg);
+    future<size_t> sendmmsg(struct mmsghdr* msgvec, size_t vlen);
+    future<size_t> recvmmsg(struct mmsghdr* msgvec, size_t vlen);
     future<size_t> sendto(socket_address addr, const void* buf, size_t len);
+    future<uint64_t> sendfile(const file& in, uint64_t pos, uint64_t len);
+    future<> send_zero_copy(net::packet p);
 
 protected:
     explicit pollable_fd_state(file_desc fd, speculation speculate = speculation())
@@ -164,9 +171,32 @@ class pollable_fd {
     future<size_t> recvmsg(struct msghdr *msg) {
         return _s->recvmsg(msg);
     }
+    // Send and receive up to vlen messages at once, returning how many
+    // were transferred; each message's msg_len is set to its size.
+    future<size_t> sendmmsg(struct mmsghdr* msgvec, size_t vlen) {
+        return _s->sendmmsg(msgvec, vlen);
+    }
+    future<size_t> recvmmsg(struct mmsghdr* msgvec, size_t vlen) {
+        return _s->recvmmsg(msgvec, vlen);
+    }
     future<size_t> sendto(socket_address addr, const void* buf, size_t len) {
         return _s->sendto(addr, buf, len);
     }
+    // Sends len bytes of in, starting at pos, without copying them through
+    // user space; in must stay alive until the returned future resolves.
+    // Returns how many bytes were sent, which is less than len when the
+    // kernel cannot send the rest (in is not a kernel file, or an O_DIRECT
+    // one read at an unaligned offset); the caller then sends it itself.
+    future<uint64_t> sendfile(const file& in, uint64_t pos, uint64_t len) {
+        return _s->sendfile(in, pos, len);
+    }
+    // Sends p, letting the kernel read its buffers in place; they are
+    // released once the kernel reports it is done with them, which may be
+    // long after the returned future resolves. The socket must have
+    // SO_ZEROCOPY enabled.
+    future<> send_zero_copy(net::packet p);
+    size_t zero_copy_threshold() const { return _s->zero_copy_threshold; }
+    void set_zero_copy_threshold(size_t threshold) { _s->zero_copy_threshold = threshold; }
     file_desc& get_file_desc() const { return _s->fd; }
     void shutdown(int how);
     void close() { _s.reset(); }
@@ -29,6 +29,7 @@
 #include <seastar/core/internal/io_request.hh>
 #include <mutex>
 #include <array>
+#include <memory>
 
 namespace seastar {
 
@@ -120,6 +121,13 @@ class io_queue
         unsigned disk_req_write_to_read_multiplier = read_request_base_count;
         unsigned disk_bytes_write_to_read_multiplier = read_request_base_count;
         sstring mountpoint = "undefined";
+        // When non-zero, the in-flight capacity is adjusted to keep the
+        // latency_quantile of request latencies within this target.
+        std::chrono::microseconds latency_target = std::chrono::microseconds(0);
+        float latency_quantile = 0.99;
+        // When set, shared with the other queues of the same device, which
+        // can then use the capacity this queue leaves unused and vice versa.
+        std::shared_ptr<fair_group> group;
     };
 
     io_queue(config cfg);
@@ -145,6 +153,10 @@ class io_queue
 
     void notify_requests_finished(fair_queue_ticket& desc);
 
+    // Feeds the latency of a request dispatched at the given time, which has
+    // just completed, to the latency target controller
+    void notify_request_latency(fair_queue_ticket desc, std::chrono::steady_clock::time_point dispatched);
+
     // Inform the underlying queue about the fact that some of our requests finished
     void process_completions();
 
@@ -130,6 +130,34 @@ future<> output_stream<CharType>::write(net::packet p) {
     return make_ready_future<>();
 }
 
+template<typename CharType>
+future<> output_stream<CharType>::write(const file& f, uint64_t pos, uint64_t len) {
+    static_assert(std::is_same<CharType, char>::value, "files are written as char");
+    if (!len) {
+        return make_ready_future<>();
+    }
+    // Send whatever was written before, so the file data follows it.
+    auto buffered = make_ready_future<>();
+    if (_end) {
+        _buf.trim(_end);
+        _end = 0;
+        buffered = put(std::move(_buf));
+    } else if (_zc_bufs) {
+        buffered = zero_copy_put(std::move(_zc_bufs));
+    }
+    return buffered.then([this, &f, pos, len] {
+        // if flush is scheduled, disable it, so it will not try to write in parallel
+        _flush = false;
+        if (_flushing) {
+            // flush in progress, wait for it to end before continuing
+            return _in_batch.value().get_future().then([this, &f, pos, len] {
+                return _fd.put_file(f, pos, len);
+            });
+        }
+        return _fd.put_file(f, pos, len);
+    });
+}
+
 template<typename CharType>
 future<> output_stream<CharType>::write(temporary_buffer<CharType> p) {
     if (p.empty()) {
@@ -44,6 +44,8 @@ namespace seastar {
 
 namespace net { class packet; }
 
+class file;
+
 class data_source_impl {
 public:
     virtual ~data_source_impl() {}
@@ -84,6 +86,11 @@ class data_sink_impl {
     virtual future<> put(temporary_buffer<char> buf) {
         return put(net::packet(net::fragment{buf.get_write(), buf.size()}, buf.release()));
     }
+    /// Sends \c len bytes of \c f starting at \c pos. The caller keeps
+    /// \c f alive until the returned future resolves. The default
+    /// implementation reads the range and put()s it; sinks that can send
+    /// file data without copying it through user space override it.
+    virtual future<> put_file(const file& f, uint64_t pos, uint64_t len);
     virtual future<> flush() {
         return make_ready_future<>();
     }
@@ -109,6 +116,9 @@ class data_sink {
     future<> put(net::packet p) {
         return _dsi->put(std::move(p));
     }
+    future<> put_file(const file& f, uint64_t pos, uint64_t len) {
+        return _dsi->put_file(f, pos, len);
+    }
     future<> flush() {
         return _dsi->flush();
     }
@@ -316,6 +326,13 @@ class output_stream final {
     future<> write(net::packet p);
     future<> write(scattered_message<char_type> msg);
     future<> write(temporary_buffer<char_type>);
+    /// Writes \c len bytes of the file \c f starting at \c pos, after any
+    /// data written before. Over a posix socket the data is sent by the
+    /// kernel, without being copied through user space. \c f must stay
+    /// alive until the returned future resolves.
+    ///
+    /// \throws file::eof_error if the file ends before the range does
+    future<> write(const file& f, uint64_t pos, uint64_t len);
     future<> flush();
 
     /// Flushes the stream before closing it (and the underlying data sink) to
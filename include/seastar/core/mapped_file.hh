@@ -0,0 +1,79 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#pragma once
+
+/// \file
+
+#include <seastar/core/future.hh>
+#include <seastar/core/sstring.hh>
+#include <seastar/core/temporary_buffer.hh>
+
+namespace seastar {
+
+/// A read-only memory mapping of a whole file.
+///
+/// The file is mapped, and all of its pages faulted in, in the reactor's
+/// syscall thread pool, so that reading the mapping does not stall the
+/// reactor. This suits small, frequently read files which do not change,
+/// such as dictionaries or static web content. The kernel may still evict
+/// the pages of the mapping under memory pressure, after which reading them
+/// faults them in again.
+///
+/// Buffers obtained from a mapped_file are views of the mapping, which stays
+/// alive as long as any of them or the mapped_file itself does. Like any
+/// temporary_buffer, they may only be used on the shard that mapped the file.
+class mapped_file {
+    temporary_buffer<char> _data;
+private:
+    explicit mapped_file(temporary_buffer<char> data) noexcept : _data(std::move(data)) {}
+    friend future<mapped_file> map_file_read_only(sstring name) noexcept;
+public:
+    mapped_file() noexcept = default;
+
+    /// Returns the size of the file at the time it was mapped.
+    size_t size() const noexcept {
+        return _data.size();
+    }
+
+    /// Returns a view of the whole file.
+    temporary_buffer<char> get() noexcept {
+        return _data.share();
+    }
+
+    /// Returns a view of up to \c len bytes starting at \c pos; the view
+    /// is shorter, possibly empty, if it would extend past the end of the file.
+    temporary_buffer<char> read(uint64_t pos, size_t len) noexcept {
+        if (pos >= _data.size()) {
+            return temporary_buffer<char>();
+        }
+        return _data.share(pos, std::min<uint64_t>(len, _data.size() - pos));
+    }
+};
+
+/// Maps a file for reading.
+///
+/// \param name the name of the file
+/// \return a future for the mapping, which fails with \c compat::filesystem::filesystem_error
+///         if the file cannot be opened or mapped
+future<mapped_file> map_file_read_only(sstring name) noexcept;
+
+}
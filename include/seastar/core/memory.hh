@@ -26,6 +26,7 @@
 #include <new>
 #include <functional>
 #include <vector>
+#include <iosfwd>
 
 namespace seastar {
 
@@ -138,6 +139,12 @@ extern compat::polymorphic_allocator<char>* malloc_allocator;
 // Returns @true if any work was actually performed.
 bool drain_cross_cpu_freelist();
 
+// Call periodically to hand objects owned by other cpus, which were freed
+// on this one and are batched per owner, over to their owners.
+//
+// Returns @true if any work was actually performed.
+bool flush_cross_cpu_frees();
+
 
 // We don't want the memory code calling back into the rest of
 // the system, so allow the rest of the system to tell the memory
@@ -148,6 +155,15 @@ bool drain_cross_cpu_freelist();
 void set_reclaim_hook(
         std::function<void (std::function<void ()>)> hook);
 
+namespace internal {
+
+// Records that the calling thread's memory belongs to the given shard, so
+// that statistics broken down by shard can be reported by shard id rather
+// than by the allocator's own cpu numbering.
+void set_shard_id(unsigned shard);
+
+}
+
 /// \endcond
 
 class statistics;
@@ -164,11 +180,19 @@ class statistics {
     size_t _free_memory;
     uint64_t _reclaims;
     uint64_t _large_allocs;
+    uint64_t _cross_node_frees;
+    uint64_t _cross_cpu_drains;
+    uint64_t _cross_cpu_drained_objects;
+    uint64_t _last_cross_cpu_drain;
 private:
     statistics(uint64_t mallocs, uint64_t frees, uint64_t cross_cpu_frees,
-            uint64_t total_memory, uint64_t free_memory, uint64_t reclaims, uint64_t large_allocs)
+            uint64_t total_memory, uint64_t free_memory, uint64_t reclaims, uint64_t large_allocs,
+            uint64_t cross_node_frees, uint64_t cross_cpu_drains, uint64_t cross_cpu_drained_objects,
+            uint64_t last_cross_cpu_drain)
         : _mallocs(mallocs), _frees(frees), _cross_cpu_frees(cross_cpu_frees)
-        , _total_memory(total_memory), _free_memory(free_memory), _reclaims(reclaims), _large_allocs(large_allocs) {}
+        , _total_memory(total_memory), _free_memory(free_memory), _reclaims(reclaims), _large_allocs(large_allocs)
+        , _cross_node_frees(cross_node_frees), _cross_cpu_drains(cross_cpu_drains)
+        , _cross_cpu_drained_objects(cross_cpu_drained_objects), _last_cross_cpu_drain(last_cross_cpu_drain) {}
 public:
     /// Total number of memory allocations calls since the system was started.
     uint64_t mallocs() const { return _mallocs; }
@@ -189,9 +213,97 @@ class statistics {
     uint64_t reclaims() const { return _reclaims; }
     /// Number of allocations which violated the large allocation threshold
     uint64_t large_allocations() const { return _large_allocs; }
+    /// Total number of memory deallocations on this lcore of memory owned by
+    /// an lcore bound to a different NUMA node.
+    uint64_t cross_node_frees() const { return _cross_node_frees; }
+    /// Number of times objects freed on other lcores were returned to this
+    /// lcore's pools.
+    uint64_t cross_cpu_drains() const { return _cross_cpu_drains; }
+    /// Total number of objects freed on other lcores and returned to this
+    /// lcore's pools.
+    uint64_t cross_cpu_drained_objects() const { return _cross_cpu_drained_objects; }
+    /// Number of objects returned to this lcore's pools by the most recent drain.
+    uint64_t last_cross_cpu_drain() const { return _last_cross_cpu_drain; }
     friend statistics stats();
 };
 
+/// Number of deallocations performed on this lcore of memory owned by the
+/// given shard.
+uint64_t cross_shard_frees(unsigned shard);
+
+/// Statistics of one small-object size class on this lcore.
+struct size_class_statistics {
+    /// Size of the objects served by this size class, in bytes.
+    size_t object_size;
+    /// Number of spans the size class took from the page allocator.
+    uint64_t spans_allocated;
+    /// Number of spans the size class returned to the page allocator.
+    uint64_t spans_freed;
+    /// Memory currently held by the size class, in pages.
+    size_t pages_in_use;
+    /// Total number of objects allocated from the size class.
+    uint64_t allocs;
+    /// Total number of objects returned to the size class.
+    uint64_t frees;
+    /// Number of free objects cached by the size class, ready to be
+    /// allocated without touching its spans.
+    size_t free_list_length;
+    /// Total number of bytes requested by allocations served by the size
+    /// class. `allocs * object_size - requested_bytes` is the memory lost
+    /// to rounding requests up to the object size.
+    uint64_t requested_bytes;
+
+    /// Number of objects of the size class currently allocated.
+    uint64_t live_objects() const { return allocs - frees; }
+    /// Total number of bytes lost to rounding requests up to the object size.
+    uint64_t rounding_loss() const { return allocs * object_size - requested_bytes; }
+};
+
+/// Number of small-object size classes; zero when Seastar is compiled with
+/// the default allocator.
+unsigned size_classes();
+
+/// Statistics of the size class with the given index, which must be smaller
+/// than size_classes(). Size classes are ordered by increasing object size.
+size_class_statistics size_class_stats(unsigned idx);
+
+/// Result of a \ref compact() pass.
+struct compaction_result {
+    /// Number of small-object spans returned to the page allocator.
+    uint64_t spans_freed;
+    /// Free memory returned to the OS, in bytes.
+    size_t released_memory;
+};
+
+/// Consolidates this lcore's free memory.
+///
+/// Objects cached by the small-object pools are returned to their spans,
+/// so that spans without live objects go back to the page allocator and
+/// merge with their neighbours, and spans which are mostly empty are moved
+/// behind fuller ones so that new objects are taken from the latter first.
+/// Free spans covering whole 2MB huge pages are then returned to the OS,
+/// unless memory is backed by hugetlbfs, and stop counting towards the
+/// process' resident set until they are allocated again.
+///
+/// Cheap enough to run periodically; see the `--memory-compaction-period-ms`
+/// option.
+compaction_result compact();
+
+/// Fragmentation of this lcore's free memory.
+struct fragmentation_statistics {
+    /// Free memory in spans smaller than a huge page, in bytes. It can only
+    /// serve smaller allocations and cannot be returned to the OS.
+    size_t fragmented_free_memory;
+    /// Free memory currently returned to the OS, in bytes.
+    size_t released_memory;
+    /// Number of \ref compact() passes.
+    uint64_t compactions;
+    /// Number of small-object spans returned to the page allocator by \ref compact().
+    uint64_t compacted_spans;
+};
+
+fragmentation_statistics fragmentation_stats();
+
 struct memory_layout {
     uintptr_t start;
     uintptr_t end;
@@ -273,6 +385,35 @@ class scoped_large_allocation_warning_disable {
 /// [example flame graph](https://user-images.githubusercontent.com/1389273/72920437-f0cf8a80-3d51-11ea-92f0-f3dbeb698871.png)).
 void set_heap_profiling_enabled(bool);
 
+/// Sample allocations instead of recording all of them in the heap profiler.
+///
+/// With a non-zero \c interval the heap profiler of the calling shard
+/// records the allocation site of one allocation per \c interval bytes
+/// allocated, on average. The distance between two samples is drawn from
+/// an exponential distribution, so that periodic allocation patterns don't
+/// alias with the sampling and the probability that an allocation is
+/// sampled depends only on its size. Unsampled allocations cost a single
+/// subtraction, which keeps the overhead low enough to leave the profiler
+/// enabled in production. Zero, the default, records every allocation.
+///
+/// Allocation sites recorded before the interval is changed keep their
+/// counters, so the interval should be set before heap profiling is enabled.
+/// Like \ref set_heap_profiling_enabled(), this only affects the calling shard.
+void set_heap_profiling_sampling_interval(size_t interval);
+
+/// Returns the sampling interval of the calling shard's heap profiler,
+/// see \ref set_heap_profiling_sampling_interval().
+size_t get_heap_profiling_sampling_interval();
+
+/// Writes the heap profile of the calling shard to \c os.
+///
+/// The profile lists the live and the total allocations recorded at each
+/// allocation site, in the text format of gperftools' heap profiles, so it
+/// can be served as plain text over HTTP and be read directly by `pprof`,
+/// which also scales sampled counters back up to estimates of the real ones.
+/// Allocations done while writing the profile are not recorded.
+void dump_heap_profile(std::ostream& os);
+
 /// Enable heap profiling for the duration of the scope.
 ///
 /// For more information about heap profiling see
@@ -147,6 +147,7 @@ namespace internal {
 class reactor_stall_sampler;
 class cpu_stall_detector;
 class buffer_allocator;
+class dma_buffer_arena;
 
 template <typename Func> // signature: bool ()
 std::unique_ptr<pollfn> make_pollfn(Func&& func);
@@ -183,6 +184,7 @@ class poller
 class kernel_completion;
 class io_queue;
 class disk_config_params;
+class mapped_file;
 
 class reactor
 {
@@ -224,6 +226,7 @@ class reactor
     friend struct task_quota_aio_completion;
     friend class reactor_backend_epoll;
     friend class reactor_backend_aio;
+    friend class reactor_backend_uring;
     friend class reactor_backend_selector;
     friend class aio_storage_context;
 
@@ -240,17 +243,23 @@ class reactor
         uint64_t aio_writes = 0;
         uint64_t aio_write_bytes = 0;
         uint64_t aio_errors = 0;
+        // Requests the io_uring backend issued on a registered buffer or file
+        uint64_t aio_fixed_buffer_ops = 0;
+        uint64_t aio_fixed_file_ops = 0;
         uint64_t fstream_reads = 0;
         uint64_t fstream_read_bytes = 0;
         uint64_t fstream_reads_blocked = 0;
         uint64_t fstream_read_bytes_blocked = 0;
         uint64_t fstream_read_aheads_discarded = 0;
         uint64_t fstream_read_ahead_discarded_bytes = 0;
+        uint64_t fstream_read_ahead_memory = 0;
     };
 private:
     reactor_config _cfg;
     file_desc _notify_eventfd;
     file_desc _task_quota_timer;
+    // Must outlive the backend, which may have registered it with the kernel
+    std::unique_ptr<internal::dma_buffer_arena> _dma_buffer_arena;
 #ifdef HAVE_OSV
     reactor_backend_osv _backend;
     sched::thread _timer_thread;
@@ -297,10 +306,10 @@ class reactor
     std::unique_ptr<internal::cpu_stall_detector> _cpu_stall_detector;
 
     unsigned _max_task_backlog = 1000;
-    timer_set<timer<>, &timer<>::_link> _timers;
-    timer_set<timer<>, &timer<>::_link>::timer_list_t _expired_timers;
-    timer_set<timer<lowres_clock>, &timer<lowres_clock>::_link> _lowres_timers;
-    timer_set<timer<lowres_clock>, &timer<lowres_clock>::_link>::timer_list_t _expired_lowres_timers;
+    timer_wheel<timer<>, &timer<>::_link> _timers;
+    timer_wheel<timer<>, &timer<>::_link>::timer_list_t _expired_timers;
+    timer_wheel<timer<lowres_clock>, &timer<lowres_clock>::_link> _lowres_timers;
+    timer_wheel<timer<lowres_clock>, &timer<lowres_clock>::_link>::timer_list_t _expired_lowres_timers;
     timer_set<timer<manual_clock>, &timer<manual_clock>::_link> _manual_timers;
     timer_set<timer<manual_clock>, &timer<manual_clock>::_link>::timer_list_t _expired_manual_timers;
     io_stats _io_stats;
@@ -362,7 +371,14 @@ class reactor
     sched_clock::duration _total_sleep;
     sched_clock::time_point _start_time = sched_clock::now();
     std::chrono::nanoseconds _max_poll_time = calculate_poll_time();
+    std::chrono::milliseconds _memory_compaction_period{0};
     circular_buffer<output_stream<char>* > _flush_batching;
+    struct zero_copy_sends;
+    // Sockets with MSG_ZEROCOPY sends whose completion has not arrived yet
+    std::unordered_map<pollable_fd_state*, std::unique_ptr<zero_copy_sends>> _zero_copy_sends;
+    // Watches the error queues of those sockets, and _zero_copy_wakeup
+    compat::optional<pollable_fd> _zero_copy_epoll;
+    compat::optional<file_desc> _zero_copy_wakeup;
     std::atomic<bool> _sleeping alignas(seastar::cache_line_size){0};
     pthread_t _thread_id alignas(seastar::cache_line_size) = pthread_self();
     bool _strict_o_direct = true;
@@ -379,12 +395,15 @@ class reactor
     bool flush_pending_aio();
     bool reap_kernel_completions();
     bool flush_tcp_batches();
+    bool reap_zero_copy_completions();
     bool do_expire_lowres_timers();
     bool do_check_lowres_timers() const;
     void expire_manual_timers();
     void abort_on_error(int ret);
     void start_aio_eventfd_loop();
     void stop_aio_eventfd_loop();
+    void start_zero_copy_loop();
+    void stop_zero_copy_loop();
     template <typename T, typename E, typename EnableFunc>
     void complete_timers(T&, E&, EnableFunc&& enable_fn);
 
@@ -562,6 +581,15 @@ class reactor
             size_t len,
             internal::io_request req) noexcept;
 
+    /// Sets aside \c size bytes of this shard's memory, in \c chunk_size
+    /// pieces, for disk I/O buffers, and registers it with the kernel when
+    /// the reactor backend supports it (io_uring fixed buffers).
+    ///
+    /// Once set, file::dma_read_bulk() (and hence file input streams)
+    /// allocates its buffers from the arena while there is room, saving the
+    /// kernel from pinning user pages on each read. May be called once per shard.
+    void register_dma_buffer_arena(size_t size, size_t chunk_size = 128 * 1024);
+
     inline void handle_io_result(ssize_t res)
     {
         if (res < 0)
@@ -682,6 +710,8 @@ class reactor
     void replace_poller(pollfn* old, pollfn* neww);
     void register_metrics();
     future<> write_all_part(pollable_fd_state& fd, const void* buffer, size_t size, size_t completed);
+    future<uint64_t> sendfile(pollable_fd_state& fd, const file& in, uint64_t pos, uint64_t len);
+    future<> send_zero_copy(pollable_fd_state& fd, net::packet p);
 
     future<> fdatasync(int fd) noexcept;
 
@@ -703,6 +733,7 @@ class reactor
     friend struct pollable_fd_state_deleter;
     friend class posix_file_impl;
     friend class blockdev_file_impl;
+    friend future<mapped_file> map_file_read_only(sstring name) noexcept;
     friend class readable_eventfd;
     friend class timer<>;
     friend class timer<lowres_clock>;
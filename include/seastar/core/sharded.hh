@@ -289,6 +289,33 @@ class sharded {
         return invoke_on_others(smp_submit_to_options{}, std::forward<Func>(func));
     }
 
+    /// Invoke a callable on all instances of \c Service, sharing a single
+    /// copy of it between the shards.
+    ///
+    /// This is cheaper than invoke_on_all() for large shard counts, but \c func
+    /// is called concurrently from all shards through a const reference; see
+    /// smp::broadcast() for the requirements this places on it.
+    ///
+    /// \param options the options to forward to the \ref smp::submit_to()
+    ///         called behind the scenes.
+    /// \param func a callable with the signature `void (Service&) const`
+    ///             or `future<> (Service&) const`, to be called on each core
+    ///             with the local instance as an argument.
+    /// \return a `future<>` that becomes ready when all cores have
+    ///         processed the message.
+    template <typename Func>
+    future<> broadcast(smp_submit_to_options options, Func&& func);
+
+    /// Invoke a callable on all instances of \c Service, sharing a single
+    /// copy of it between the shards.
+    ///
+    /// Passes the default \ref smp_submit_to_options to the
+    /// \ref smp::submit_to() called behind the scenes.
+    template <typename Func>
+    future<> broadcast(Func&& func) {
+        return broadcast(smp_submit_to_options{}, std::forward<Func>(func));
+    }
+
     /// Invoke a method on all instances of `Service` and reduce the results using
     /// `Reducer`.
     ///
@@ -708,6 +735,18 @@ sharded<Service>::invoke_on_others(smp_submit_to_options options, Func&& func) {
     });
 }
 
+template <typename Service>
+template <typename Func>
+inline
+future<>
+sharded<Service>::broadcast(smp_submit_to_options options, Func&& func) {
+    static_assert(std::is_same<futurize_t<std::result_of_t<const std::decay_t<Func>&(Service&)>>, future<>>::value,
+                  "broadcast()'s func must return void or future<>");
+    return smp::broadcast(options, [this, func = std::forward<Func>(func)] {
+        return futurize_invoke(func, *get_local_service());
+    });
+}
+
 template <typename Service>
 const Service& sharded<Service>::local() const {
     assert(local_is_initialized());
@@ -161,6 +161,11 @@ class smp_message_queue
     static constexpr size_t prefetch_cnt = 2;
     struct work_item;
 
+    // Number of work item pointers that fill one cache line of the ring.
+    // Batch sizes are kept a multiple of this so that a publish hands over
+    // whole lines to the other side.
+    static constexpr size_t items_per_cache_line = cache_line_size / sizeof(work_item*);
+
     struct lf_queue_remote
     {
         reactor* remote;
@@ -179,6 +184,11 @@ class smp_message_queue
     lf_queue _pending;      // reactor 事件循环 smp::poll_queues 中, reactor 之间发送和接收异步任务
     lf_queue _completed;    // reactor 事件循环 smp::poll_queues 中, 异步任务执行结束之后会被添加到该 queue 中
 
+    // Requests and responses are published once this many have been
+    // queued locally (and on every poll regardless). Set up in start()
+    // from the topology distance between the two shards, read-only after.
+    size_t _batch_size = batch_size;
+
     struct alignas(seastar::cache_line_size) {
         size_t _sent = 0;
         size_t _compl = 0;
@@ -247,6 +257,57 @@ class smp_message_queue
         future_type get_future() { return _promise.get_future(); }
     };
 
+    // Shared by all destinations of smp::broadcast(). Lives on the
+    // originating shard and is only modified there; the destinations
+    // only invoke _func through a const reference.
+    template <typename Func>
+    struct broadcast_state {
+        const Func _func;
+        unsigned _pending;
+        std::exception_ptr _ex;
+        promise<> _promise;
+        broadcast_state(unsigned pending, Func&& func) : _func(std::move(func)), _pending(pending) {}
+        void complete_one(std::exception_ptr ex) noexcept {
+            if (ex && !_ex) {
+                _ex = std::move(ex);
+            }
+            if (--_pending == 0) {
+                if (_ex) {
+                    _promise.set_exception(std::move(_ex));
+                } else {
+                    _promise.set_value();
+                }
+                delete this;
+            }
+        }
+    };
+
+    template <typename Func>
+    struct broadcast_work_item : work_item {
+        smp_message_queue& _queue;
+        broadcast_state<Func>& _state;
+        std::exception_ptr _ex;
+        broadcast_work_item(smp_message_queue& queue, smp_service_group ssg, broadcast_state<Func>& state)
+                : work_item(ssg), _queue(queue), _state(state) {}
+        virtual void fail_with(std::exception_ptr ex) override {
+            _state.complete_one(std::move(ex));
+        }
+        virtual void run_and_dispose() noexcept override {
+            // _queue.respond() below forwards the completion back to the
+            // calling shard.
+            (void)futurize_invoke(_state._func).then_wrapped([this] (future<> f) {
+                if (f.failed()) {
+                    _ex = f.get_exception();
+                }
+                _queue.respond(this);
+            });
+        }
+        virtual void complete() override {
+            // FIXME: _ex was allocated on another cpu
+            _state.complete_one(std::move(_ex));
+        }
+    };
+
     union tx_side
     {
         tx_side() {}
@@ -273,13 +334,18 @@ class smp_message_queue
         submit_item(t, options.timeout, std::move(wi));         // 递交异步任务给其他的 reactor
         return fut;
     }
-    void start(unsigned cpuid);
+    void start(unsigned cpuid, size_t batch_size);
     template<size_t PrefetchCnt, typename Func>
     size_t process_queue(lf_queue& q, Func process);
     size_t process_incoming();
     size_t process_completions(shard_id t);
     void stop();
 private:
+    template <typename Func>
+    void submit_broadcast(shard_id t, smp_submit_to_options options, broadcast_state<Func>& state) {
+        memory::disable_failure_guard dfg;
+        submit_item(t, options.timeout, std::make_unique<broadcast_work_item<Func>>(*this, options.service_group, state));
+    }
     void work();
     void submit_item(shard_id t, smp_timeout_clock::time_point timeout, std::unique_ptr<work_item> wi);
     void respond(work_item* wi);
@@ -304,6 +370,11 @@ class smp {
     static std::unique_ptr<smp_message_queue*[], qs_deleter> _qs;       // reactor 之间相互递交任务的队列, 定义在 reactor.cc 中
     static std::thread::id _tmain;
     static bool _using_dpdk;
+    static std::vector<unsigned> _shard_to_numa_node;
+    static size_t _local_batch_size;
+    static size_t _remote_batch_size;
+
+    static size_t message_batch_size(shard_id from, shard_id to);
 
     template <typename Func>
     using returns_future = is_future<std::result_of_t<Func()>>;
@@ -452,6 +523,62 @@ class smp {
     static future<> invoke_on_others(unsigned cpu_id, Func func) {
         return invoke_on_others(cpu_id, smp_submit_to_options{}, std::move(func));
     }
+    /// Invokes func on all shards, sharing a single copy of it.
+    ///
+    /// Unlike invoke_on_all(), which gives each shard its own copy of \c func
+    /// and gathers one future per shard, broadcast() keeps one copy on the
+    /// calling shard, sends each destination a single message referring to it,
+    /// and counts completions. All shards call \c func concurrently through a
+    /// const reference, so it must be safe to use that way: it may not rely on
+    /// mutable captures, and must not copy objects with non-atomic reference
+    /// counts (such as lw_shared_ptr) owned by the calling shard.
+    ///
+    /// \param options the options to forward to the \ref smp::submit_to()
+    ///         called behind the scenes.
+    /// \param func the function to be invoked on each shard. May return void or
+    ///         future<>.
+    /// \returns a future that resolves when all invocations finish. If any of
+    ///         them failed, the future fails with one of their exceptions.
+    template<typename Func>
+    static future<> broadcast(smp_submit_to_options options, Func&& func) {
+        using func_type = std::decay_t<Func>;
+        static_assert(std::is_same<future<>, futurize_t<std::result_of_t<const func_type&()>>>::value, "bad Func signature");
+        auto state = new smp_message_queue::broadcast_state<func_type>(count, func_type(std::forward<Func>(func)));
+        auto fut = state->_promise.get_future();
+        for (unsigned id = 0; id < count; ++id) {
+            if (id == this_shard_id()) {
+                continue;
+            }
+            try {
+                _qs[id][this_shard_id()].submit_broadcast(id, options, *state);
+            } catch (...) {
+                state->complete_one(std::current_exception());
+            }
+        }
+        // The local invocation goes last so that it doesn't delay the
+        // messages to other shards.
+        try {
+            (void)futurize_invoke(state->_func).then_wrapped([state] (future<> f) {
+                state->complete_one(f.failed() ? f.get_exception() : std::exception_ptr());
+            });
+        } catch (...) {
+            state->complete_one(std::current_exception());
+        }
+        return fut;
+    }
+    /// Invokes func on all shards, sharing a single copy of it.
+    ///
+    /// \param func the function to be invoked on each shard. May return void or
+    ///         future<>. See broadcast(smp_submit_to_options, Func&&) for the
+    ///         requirements on it.
+    /// \returns a future that resolves when all invocations finish.
+    ///
+    /// Passes the default \ref smp_submit_to_options to the
+    /// \ref smp::submit_to() called behind the scenes.
+    template<typename Func>
+    static future<> broadcast(Func&& func) {
+        return broadcast(smp_submit_to_options{}, std::forward<Func>(func));
+    }
 private:
     static void start_all_queues();
     static void pin(unsigned cpu_id);
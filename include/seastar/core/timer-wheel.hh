@@ -0,0 +1,348 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <limits>
+#include <bitset>
+#include <array>
+#include <type_traits>
+#include <boost/intrusive/list.hpp>
+#include <seastar/core/bitset-iter.hh>
+
+namespace seastar {
+
+/**
+ * A hierarchical timing wheel for holding and expiring timers.
+ *
+ * Timestamps are split into groups of slot_bits bits; each group is one
+ * level of the wheel and each value of the group is one slot of that level.
+ * A timer is placed on the level holding the most significant bit in which
+ * its timeout differs from the last expiry point, so arming and cancelling
+ * are O(1) regardless of how many timers are active. Expiry splices whole
+ * slots into the expired list and only re-sorts the single slot which
+ * straddles the new expiry point, which cascades its timers to lower levels.
+ *
+ * Compared to timer_set, which keeps one list per power-of-two distance,
+ * a wheel keeps far fewer timers in the list that has to be walked on
+ * every expire(), which matters when hundreds of thousands of mostly
+ * cancelled timers are active.
+ *
+ * The interface is the same as timer_set's. The template type "Timer"
+ * should have a method named get_timeout() which returns
+ * Timer::time_point which denotes timer's expiration.
+ */
+template<typename Timer, boost::intrusive::list_member_hook<> Timer::*link>
+class timer_wheel {
+public:
+    using time_point = typename Timer::time_point;
+    using timer_list_t = boost::intrusive::list<Timer, boost::intrusive::member_hook<Timer, boost::intrusive::list_member_hook<>, link>>;
+private:
+    using duration = typename Timer::duration;
+    using timestamp_t = typename Timer::duration::rep;
+    using key_t = std::make_unsigned_t<timestamp_t>;
+
+    static constexpr timestamp_t max_timestamp = std::numeric_limits<timestamp_t>::max();
+    static constexpr int key_bits = std::numeric_limits<key_t>::digits;
+
+    static constexpr int slot_bits = 6;
+    static constexpr int n_slots = 1 << slot_bits;
+    static constexpr int n_levels = (key_bits + slot_bits - 1) / slot_bits;
+    static constexpr size_t max_scanned_slot_size = 16;
+
+    using level_t = std::array<timer_list_t, n_slots>;
+
+    std::array<level_t, n_levels> _levels;
+    std::array<std::bitset<n_slots>, n_levels> _non_empty_slots;
+    // Active timers with timeout <= _last.
+    timer_list_t _due;
+    timestamp_t _last;
+    timestamp_t _next;
+    size_t _size;
+private:
+    static timestamp_t get_timestamp(time_point _time_point)
+    {
+        return _time_point.time_since_epoch().count();
+    }
+
+    static timestamp_t get_timestamp(Timer& timer)
+    {
+        return get_timestamp(timer.get_timeout());
+    }
+
+    static int get_slot(timestamp_t timestamp, int level)
+    {
+        return (key_t(timestamp) >> (level * slot_bits)) & (n_slots - 1);
+    }
+
+    // Level holding the most significant bit in which the two
+    // timestamps differ. They must not be equal.
+    static int get_level(timestamp_t a, timestamp_t b)
+    {
+        auto msb = key_bits - 1 - bitsets::count_leading_zeros(key_t(a) ^ key_t(b));
+        return msb / slot_bits;
+    }
+
+    timer_list_t& get_list(timestamp_t timestamp, int& level, int& slot)
+    {
+        if (timestamp <= _last) {
+            level = -1;
+            return _due;
+        }
+        level = get_level(timestamp, _last);
+        slot = get_slot(timestamp, level);
+        return _levels[level][slot];
+    }
+
+    void place(Timer& timer, timestamp_t timestamp)
+    {
+        int level, slot;
+        auto& list = get_list(timestamp, level, slot);
+        list.push_back(timer);
+        if (level >= 0) {
+            _non_empty_slots[level][slot] = true;
+        }
+    }
+
+    void take_slot(timer_list_t& exp, int level, int slot)
+    {
+        exp.splice(exp.end(), _levels[level][slot]);
+        _non_empty_slots[level][slot] = false;
+    }
+
+    // Timers on a lower level always expire before timers on a higher
+    // level, and within a level a lower slot expires before a higher one,
+    // so only the first non-empty slot has to be looked at. Short slots are
+    // scanned for the exact timeout; for crowded ones the start of the slot
+    // is returned instead, which costs an early expire() that cascades the
+    // slot one level down rather than a walk over all of its timers.
+    timestamp_t find_next()
+    {
+        for (int level = 0; level < n_levels; ++level) {
+            if (_non_empty_slots[level].none()) {
+                continue;
+            }
+            auto slot = bitsets::get_first_set(_non_empty_slots[level]);
+            auto& list = _levels[level][slot];
+            if (level == 0) {
+                return get_timestamp(*list.begin());
+            }
+            if (list.size() > max_scanned_slot_size) {
+                auto shift = (level + 1) * slot_bits;
+                auto high = shift < key_bits ? (key_t(_last) >> shift) << shift : key_t(0);
+                return timestamp_t(high | (key_t(slot) << (level * slot_bits)));
+            }
+            auto next = max_timestamp;
+            for (auto& timer : list) {
+                next = std::min(next, get_timestamp(timer));
+            }
+            return next;
+        }
+        return max_timestamp;
+    }
+public:
+    timer_wheel()
+        : _last(0)
+        , _next(max_timestamp)
+        , _size(0)
+    {
+    }
+
+    ~timer_wheel() {
+        while (!_due.empty()) {
+            _due.begin()->cancel();
+        }
+        for (auto&& level : _levels) {
+            for (auto&& list : level) {
+                while (!list.empty()) {
+                    auto& timer = *list.begin();
+                    timer.cancel();
+                }
+            }
+        }
+    }
+
+    /**
+     * Adds timer to the active set.
+     *
+     * The value returned by timer.get_timeout() is used as timer's expiry. The result
+     * of timer.get_timeout() must not change while the timer is in the active set.
+     *
+     * Preconditions:
+     *  - this timer must not be currently in the active set or in the expired set.
+     *
+     * Postconditions:
+     *  - this timer will be added to the active set until it is expired
+     *    by a call to expire() or removed by a call to remove().
+     *
+     * Returns true if and only if this timer's timeout is less than get_next_timeout().
+     * When this function returns true the caller should reschedule expire() to be
+     * called at timer.get_timeout() to ensure timers are expired in a timely manner.
+     */
+    bool insert(Timer& timer)
+    {
+        auto timestamp = get_timestamp(timer);
+        place(timer, timestamp);
+        ++_size;
+
+        if (timestamp < _next) {
+            _next = timestamp;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Removes timer from the active set.
+     *
+     * Preconditions:
+     *  - timer must be currently in the active set. Note: it must not be in
+     *    the expired set.
+     *
+     * Postconditions:
+     *  - timer is no longer in the active set.
+     *  - this object will no longer hold any references to this timer.
+     */
+    void remove(Timer& timer)
+    {
+        int level, slot;
+        auto& list = get_list(get_timestamp(timer), level, slot);
+        list.erase(list.iterator_to(timer));
+        --_size;
+        if (level >= 0 && list.empty()) {
+            _non_empty_slots[level][slot] = false;
+        }
+    }
+
+    /**
+     * Expires active timers.
+     *
+     * The time points passed to this function must be monotonically increasing.
+     * Use get_next_timeout() to query for the next time point.
+     *
+     * Preconditions:
+     *  - the time_point passed to this function must not be lesser than
+     *    the previous one passed to this function.
+     *
+     * Postconditons:
+     *  - all timers from the active set with Timer::get_timeout() <= now are moved
+     *    to the expired set.
+     */
+    timer_list_t expire(time_point now)
+    {
+        timer_list_t exp;
+        auto timestamp = get_timestamp(now);
+
+        if (timestamp < _last) {
+            abort();
+        }
+
+        exp.splice(exp.end(), _due);
+
+        if (timestamp != _last) {
+            // Every timer agrees with _last above its own level, so all
+            // timers below the level at which _last and now differ have
+            // expired, and so have the slots of that level lying between
+            // the old and the new position. The slot now falls into holds
+            // both expired and pending timers and has to be redistributed.
+            auto top = get_level(timestamp, _last);
+            auto from = get_slot(_last, top);
+            auto to = get_slot(timestamp, top);
+
+            for (int level = 0; level < top; ++level) {
+                for (int slot : bitsets::for_each_set(_non_empty_slots[level])) {
+                    take_slot(exp, level, slot);
+                }
+            }
+            for (int slot : bitsets::for_each_set(_non_empty_slots[top], from + 1)) {
+                if (slot >= to) {
+                    break;
+                }
+                take_slot(exp, top, slot);
+            }
+
+            _last = timestamp;
+
+            timer_list_t cascade;
+            cascade.splice(cascade.end(), _levels[top][to]);
+            _non_empty_slots[top][to] = false;
+            while (!cascade.empty()) {
+                auto& timer = *cascade.begin();
+                cascade.pop_front();
+                if (timer.get_timeout() <= now) {
+                    exp.push_back(timer);
+                } else {
+                    place(timer, get_timestamp(timer));
+                }
+            }
+        }
+
+        _size -= exp.size();
+        _next = find_next();
+        return exp;
+    }
+
+    /**
+     * Returns a time point at which expire() should be called
+     * in order to ensure timers are expired in a timely manner.
+     *
+     * Returned values are monotonically increasing.
+     */
+    time_point get_next_timeout() const
+    {
+        return time_point(duration(std::max(_last, _next)));
+    }
+
+    /**
+     * Clears both active and expired timer sets.
+     */
+    void clear()
+    {
+        _due.clear();
+        for (int level = 0; level < n_levels; ++level) {
+            for (int slot : bitsets::for_each_set(_non_empty_slots[level])) {
+                _levels[level][slot].clear();
+            }
+            _non_empty_slots[level].reset();
+        }
+        _size = 0;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    /**
+     * Returns true if and only if there are no timers in the active set.
+     */
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    time_point now() {
+        return Timer::clock::now();
+    }
+};
+
+}
@@ -23,6 +23,8 @@
 
 #include <seastar/http/handlers.hh>
 #include <seastar/core/iostream.hh>
+#include <seastar/core/mapped_file.hh>
+#include <seastar/util/std-compat.hh>
 
 namespace seastar {
 
@@ -156,12 +158,30 @@ class file_handler : public file_interaction_handler {
                     force_path) {
     }
 
+    /**
+     * Serve the file from a read-only memory mapping, made on the first
+     * request, instead of reading it from the disk on every request.
+     * Suitable for small static files that do not change while the
+     * handler is in use.
+     * @param mapped whether to serve the file from a mapping
+     */
+    file_handler* set_memory_mapped(bool mapped = true) {
+        memory_mapped = mapped;
+        mapping = {};
+        return this;
+    }
+
     future<std::unique_ptr<reply>> handle(const sstring& path,
             std::unique_ptr<request> req, std::unique_ptr<reply> rep) override;
 
 private:
+    future<std::unique_ptr<reply>> read_mapped(std::unique_ptr<request> req,
+            std::unique_ptr<reply> rep);
+
     sstring file;
     bool force_path;
+    bool memory_mapped = false;
+    compat::optional<mapped_file> mapping;
 };
 
 }
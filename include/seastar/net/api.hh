@@ -23,6 +23,7 @@
 
 #include <memory>
 #include <vector>
+#include <chrono>
 #include <cstring>
 #include <seastar/core/future.hh>
 #include <seastar/net/byteorder.hh>
@@ -116,8 +117,20 @@ class udp_channel {
     socket_address local_address() const;
 
     future<udp_datagram> receive();
+    /// Receives up to \c max datagrams, waiting until at least one arrives.
+    ///
+    /// The posix stack receives the whole batch with a single system call.
+    future<std::vector<udp_datagram>> receive_batch(size_t max);
     future<> send(const socket_address& dst, const char* msg);
     future<> send(const socket_address& dst, packet p);
+    /// Sends each datagram to its destination, in order.
+    ///
+    /// The posix stack sends the whole batch with as few system calls as
+    /// possible, letting the kernel segment runs of equally sized datagrams
+    /// to the same destination (UDP GSO) where it supports that. If a
+    /// datagram cannot be sent, the returned future fails and the datagrams
+    /// after it are not sent.
+    future<> send_batch(std::vector<std::pair<socket_address, packet>> datagrams);
     bool is_closed() const;
     /// Causes a pending receive() to complete (possibly with an exception)
     void shutdown_input();
@@ -202,6 +215,35 @@ class connected_socket {
     void set_keepalive_parameters(const net::keepalive_params& p);
     /// Get TCP keepalive parameters
     net::keepalive_params get_keepalive_parameters() const;
+    /// Sends packets of at least \c threshold bytes with MSG_ZEROCOPY
+    ///
+    /// The kernel then transmits the packets' buffers in place instead of
+    /// copying them, which saves CPU on bulk transfers, and they are only
+    /// released once the kernel reports it is done with them. The buffers
+    /// must not be modified after they are written. Only posix TCP sockets
+    /// support this; elsewhere, and on kernels without SO_ZEROCOPY, it does
+    /// nothing. A threshold of 0 disables it.
+    void set_zero_copy_send(size_t threshold);
+
+    /// Selects the congestion control algorithm of the connection.
+    ///
+    /// Only the native stack supports this; elsewhere it does nothing.
+    void set_congestion_control(tcp_congestion_control cc);
+
+    /// Spreads the connection's output over the round trip at the rate its
+    /// congestion control estimates, instead of sending as much as the
+    /// window allows at once.
+    ///
+    /// Only the native stack supports this; elsewhere it does nothing.
+    void set_pacing(bool pacing);
+
+    /// Sets the minimum retransmission timeout of the connection, 1s by
+    /// default as RFC6298 recommends. Datacenter networks, whose round trips
+    /// take well under a millisecond, can go down to a few milliseconds;
+    /// the native stack's retransmission timer has a 10ms granularity.
+    ///
+    /// Only the native stack supports this; elsewhere it does nothing.
+    void set_rto_min(std::chrono::milliseconds rto_min);
 
     /// Disables output to the socket.
     ///
@@ -323,6 +365,12 @@ struct listen_options {
     transport proto = transport::TCP;
     int listen_backlog = 100;
     unsigned fixed_cpu = 0u;
+    /// Congestion control of the accepted connections, native stack only
+    tcp_congestion_control congestion_control = tcp_congestion_control::reno;
+    /// Pace the output of the accepted connections, native stack only
+    bool pacing = false;
+    /// Minimum retransmission timeout of the accepted connections, native stack only
+    std::chrono::milliseconds rto_min{1000};
     void set_fixed_cpu(unsigned cpu) {
         lba = server_socket::load_balancing_algorithm::fixed;
         fixed_cpu = cpu;
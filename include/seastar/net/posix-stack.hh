@@ -163,6 +163,7 @@ class posix_data_sink_impl : public data_sink_impl
     using data_sink_impl::put;
     future<> put(packet p) override;
     future<> put(temporary_buffer<char> buf) override;
+    future<> put_file(const file& f, uint64_t pos, uint64_t len) override;
     future<> close() override;
 };
 
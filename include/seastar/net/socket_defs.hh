@@ -104,6 +104,14 @@ enum class transport {
     SCTP = IPPROTO_SCTP
 };
 
+/// Congestion control algorithm of a TCP connection. Only the native stack
+/// honours it; posix sockets use the kernel's setting.
+enum class tcp_congestion_control {
+    reno,   ///< Slow start and congestion avoidance per RFC5681
+    cubic,  ///< CUBIC per RFC8312
+    bbr,    ///< Model based: follows the measured bottleneck bandwidth and round-trip time
+};
+
 struct ipv4_addr {
     uint32_t ip;
     uint16_t port;
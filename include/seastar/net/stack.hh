@@ -44,6 +44,10 @@ class connected_socket_impl {
     virtual bool get_keepalive() const = 0;
     virtual void set_keepalive_parameters(const keepalive_params&) = 0;
     virtual keepalive_params get_keepalive_parameters() const = 0;
+    virtual void set_zero_copy_send(size_t threshold) {}
+    virtual void set_congestion_control(tcp_congestion_control cc) {}
+    virtual void set_pacing(bool pacing) {}
+    virtual void set_rto_min(std::chrono::milliseconds rto_min) {}
 };
 
 class socket_impl {
@@ -71,6 +75,9 @@ class udp_channel_impl {
     virtual future<udp_datagram> receive() = 0;
     virtual future<> send(const socket_address& dst, const char* msg) = 0;
     virtual future<> send(const socket_address& dst, packet p) = 0;
+    // The defaults receive and send one datagram at a time
+    virtual future<std::vector<udp_datagram>> receive_batch(size_t max);
+    virtual future<> send_batch(std::vector<std::pair<socket_address, packet>> datagrams);
     virtual void shutdown_input() = 0;
     virtual void shutdown_output() = 0;
     virtual bool is_closed() const = 0;
@@ -0,0 +1,77 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#pragma once
+
+#include <seastar/core/lowres_clock.hh>
+#include <seastar/net/socket_defs.hh>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+
+namespace seastar {
+
+namespace net {
+
+// What the connection tells its congestion controller about an event
+struct tcp_congestion_event {
+    lowres_clock::time_point now;
+    uint16_t mss;
+    // Bytes sent but not acknowledged yet. On a loss, the flight size the
+    // slow start threshold is derived from.
+    uint32_t in_flight;
+    // Bytes acknowledged by this ACK
+    uint32_t acked_bytes;
+    // Bytes delivered to the peer since the connection started, including
+    // the SACKed ones
+    uint64_t delivered;
+    // Latest and smoothed round-trip time, zero before the first sample
+    std::chrono::milliseconds rtt;
+    std::chrono::milliseconds srtt;
+};
+
+// Decides how much data a native TCP connection may have in flight.
+//
+// The connection owns the congestion window and the slow start threshold,
+// and runs fast retransmit and fast recovery (RFC5681, RFC6582) itself. The
+// controller grows the window as data is acknowledged, and chooses the slow
+// start threshold when a loss is detected.
+class tcp_congestion_controller {
+public:
+    virtual ~tcp_congestion_controller() {}
+    // New data was acknowledged
+    virtual void on_ack(uint32_t& cwnd, uint32_t ssthresh, const tcp_congestion_event& ev) = 0;
+    // A segment was lost, as detected by fast retransmit or, if timeout is
+    // set, by the retransmission timer. Returns the new slow start threshold.
+    virtual uint32_t on_loss(uint32_t cwnd, const tcp_congestion_event& ev, bool timeout) = 0;
+    // Rate at which a paced connection sends, in bytes per second, or 0 to
+    // send as fast as the window allows. By default the window is spread
+    // over the smoothed RTT, at twice that rate in slow start and 1.2 times
+    // in congestion avoidance, so that the window is still used up while it
+    // grows.
+    virtual uint64_t pacing_rate(uint32_t cwnd, uint32_t ssthresh, const tcp_congestion_event& ev) const;
+};
+
+std::unique_ptr<tcp_congestion_controller> make_tcp_congestion_controller(tcp_congestion_control cc);
+
+}
+
+}
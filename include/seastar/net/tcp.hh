@@ -24,6 +24,7 @@
 #include <seastar/core/shared_ptr.hh>
 #include <seastar/core/queue.hh>
 #include <seastar/core/semaphore.hh>
+#include <seastar/core/future-util.hh>
 #include <seastar/core/byteorder.hh>
 #include <seastar/core/metrics.hh>
 #include <seastar/net/net.hh>
@@ -31,12 +32,15 @@
 #include <seastar/net/ip.hh>
 #include <seastar/net/const.hh>
 #include <seastar/net/packet-util.hh>
+#include <seastar/net/tcp-congestion.hh>
 #include <seastar/util/std-compat.hh>
 #include <unordered_map>
 #include <map>
 #include <functional>
 #include <deque>
+#include <vector>
 #include <chrono>
+#include <limits>
 #include <random>
 #include <stdexcept>
 #include <system_error>
@@ -51,6 +55,7 @@ using namespace std::chrono_literals;
 namespace net {
 
 struct tcp_hdr;
+class tcp_tester;
 
 inline auto tcp_error(int err) {
     return std::system_error(err, std::system_category());
@@ -95,7 +100,7 @@ void tcp_debug(const char* fmt, Args&&... args) {
 
 struct tcp_option {
     // The kind and len field are fixed and defined in TCP protocol
-    enum class option_kind: uint8_t { mss = 2, win_scale = 3, sack = 4, timestamps = 8,  nop = 1, eol = 0 };
+    enum class option_kind: uint8_t { mss = 2, win_scale = 3, sack = 4, sack_blocks = 5, timestamps = 8,  nop = 1, eol = 0 };
     enum class option_len:  uint8_t { mss = 4, win_scale = 3, sack = 2, timestamps = 10, nop = 1, eol = 1 };
     static void write(char* p, option_kind kind, option_len len) {
         p[0] = static_cast<uint8_t>(kind);
@@ -131,6 +136,7 @@ struct tcp_option {
             p[2] = shift;
         }
     };
+    // SACK permitted, only sent on SYN segments
     struct sack {
         static constexpr option_kind kind = option_kind::sack;
         static constexpr option_len len = option_len::sack;
@@ -141,6 +147,36 @@ struct tcp_option {
             tcp_option::write(p, kind, len);
         }
     };
+    // The blocks of out-of-order data held by the receiver, per RFC 2018
+    struct sack_blocks {
+        static constexpr option_kind kind = option_kind::sack_blocks;
+        // Four blocks fill the option space of a segment carrying no other
+        // options, three are left next to timestamps
+        static constexpr uint8_t max_blocks = 4;
+        uint8_t nr = 0;
+        uint32_t left[max_blocks];
+        uint32_t right[max_blocks];
+        uint8_t size() const {
+            return nr ? 2 + 8 * nr : 0;
+        }
+        static tcp_option::sack_blocks read(const char* p) {
+            tcp_option::sack_blocks x;
+            uint8_t nr = (uint8_t(p[1]) - 2) / 8;
+            x.nr = nr < max_blocks ? nr : max_blocks;
+            for (uint8_t i = 0; i < x.nr; i++) {
+                x.left[i] = read_be<uint32_t>(p + 2 + 8 * i);
+                x.right[i] = read_be<uint32_t>(p + 6 + 8 * i);
+            }
+            return x;
+        }
+        void write(char* p) const {
+            tcp_option::write(p, kind, option_len(size()));
+            for (uint8_t i = 0; i < nr; i++) {
+                write_be<uint32_t>(p + 2 + 8 * i, left[i]);
+                write_be<uint32_t>(p + 6 + 8 * i, right[i]);
+            }
+        }
+    };
     struct timestamps {
         static constexpr option_kind kind = option_kind::timestamps;
         static constexpr option_len len = option_len::timestamps;
@@ -175,8 +211,18 @@ struct tcp_option {
     static const uint8_t align = 4;
 
     void parse(uint8_t* beg, uint8_t* end);
+    // Extracts the SACK blocks from the options of a non-SYN segment
+    static sack_blocks parse_sack_blocks(uint8_t* beg, uint8_t* end);
+    // Extracts the timestamps from the options of a non-SYN segment, returns
+    // false if there are none
+    static bool parse_timestamps(uint8_t* beg, uint8_t* end, timestamps& ts);
     uint8_t fill(void* h, const tcp_hdr* th, uint8_t option_size);
     uint8_t get_size(bool syn_on, bool ack_on);
+    // RFC7323: timestamps are offered on our SYN and, once both sides sent
+    // them on theirs, carried by every segment
+    bool timestamps_on(bool syn_on, bool ack_on) const {
+        return _timestamps_received || (syn_on && !ack_on);
+    }
 
     // For option negotiattion
     bool _mss_received = false;
@@ -189,6 +235,11 @@ struct tcp_option {
     uint16_t _local_mss;
     uint8_t _remote_win_scale = 0;
     uint8_t _local_win_scale = 0;
+    // SACK blocks to send with the next segment
+    sack_blocks _local_sack;
+    // Timestamp of the next segment and the one it echoes (TS.Recent)
+    uint32_t _local_ts_val = 0;
+    uint32_t _ts_recent = 0;
 };
 inline char*& operator+=(char*& x, tcp_option::option_len len) { x += uint8_t(len); return x; }
 inline const char*& operator+=(const char*& x, tcp_option::option_len len) { x += uint8_t(len); return x; }
@@ -325,6 +376,10 @@ class tcp {
             uint16_t data_len;
             unsigned nr_transmits;
             clock_type::time_point tx_time;
+            tcp_seq seq;
+            // SACK scoreboard
+            bool sacked = false;
+            bool lost = false;
         };
         struct send {
             tcp_seq unacknowledged;
@@ -354,6 +409,10 @@ class tcp {
             std::chrono::milliseconds srtt;
             bool first_rto_sample = true;
             clock_type::time_point syn_tx_time;
+            // Latest round-trip time sample
+            std::chrono::milliseconds last_rtt{0};
+            // Bytes delivered to the remote, cumulatively ACKed or SACKed
+            uint64_t delivered = 0;
             // Congestion window
             uint32_t cwnd;
             // Slow start threshold
@@ -365,6 +424,21 @@ class tcp {
             uint32_t limited_transfer = 0;
             uint32_t partial_ack = 0;
             tcp_seq recover;
+            // Highest sequence number retransmitted in the current recovery
+            tcp_seq high_rxt;
+            // Bytes SACKed by the receiver and segments deemed lost but not yet
+            // retransmitted, both still in data
+            uint32_t sacked_bytes = 0;
+            uint32_t nr_lost = 0;
+            // RACK: the most recently sent segment known to be delivered
+            clock_type::time_point rack_tx_time;
+            tcp_seq rack_end;
+            std::chrono::milliseconds rack_rtt{0};
+            std::chrono::milliseconds min_rtt = std::chrono::milliseconds::max();
+            // Bytes a paced connection may send now, and when they were last
+            // refilled
+            double pacing_credit = 0;
+            steady_clock_type::time_point pacing_stamp;
             bool window_probe = false;
             uint8_t zero_window_probing_out = 0;
         } _snd;
@@ -379,23 +453,35 @@ class tcp {
             // The total size of data stored in std::deque<packet> data
             size_t data_size = 0;
             tcp_packet_merger out_of_order;
+            // Start of the most recently received out-of-order segment
+            tcp_seq last_out_of_order;
+            // Acknowledgment number of the last segment we sent
+            tcp_seq last_ack_sent;
             compat::optional<promise<>> _data_received_promise;
             // The maximun memory buffer size allowed for receiving
             // Currently, it is the same as default receive window size when window scaling is enabled
             size_t max_receive_buf_size = 3737600;
         } _rcv;
         tcp_option _option;
+        std::unique_ptr<tcp_congestion_controller> _cc;
+        bool _pacing = false;
         timer<lowres_clock> _delayed_ack;
+        // An ACK waits for the tasks woken up by the current poll to run
+        bool _ack_scheduled = false;
         // Retransmission timeout
         std::chrono::milliseconds _rto{1000};
         std::chrono::milliseconds _persist_time_out{1000};
-        static constexpr std::chrono::milliseconds _rto_min{1000};
+        std::chrono::milliseconds _rto_min{1000};
         static constexpr std::chrono::milliseconds _rto_max{60000};
         // Clock granularity
         static constexpr std::chrono::milliseconds _rto_clk_granularity{1};
         static constexpr uint16_t _max_nr_retransmit{5};
         timer<lowres_clock> _retransmit;
         timer<lowres_clock> _persist;
+        // Fires when a segment outstanding past the RACK reordering window is lost
+        timer<lowres_clock> _rack_reorder;
+        // Fires when a paced connection has earned enough credit to send a segment
+        timer<> _pacing_timer;
         uint16_t _nr_full_seg_received = 0;
         struct isn_secret {
             // 512 bits secretkey for ISN generating
@@ -428,12 +514,21 @@ class tcp {
         void input_handle_listen_state(tcp_hdr* th, packet p);
         void input_handle_syn_sent_state(tcp_hdr* th, packet p);
         void input_handle_other_state(tcp_hdr* th, packet p);
-        void output_one(bool data_retransmit = false);
+        void output_one(unacked_segment* retransmit_seg = nullptr);
         future<> wait_for_data();
         void abort_reader();
         future<> wait_for_all_data_acked();
         future<> wait_send_available();
         future<> send(packet p);
+        void set_congestion_control(tcp_congestion_control cc) {
+            _cc = make_tcp_congestion_controller(cc);
+        }
+        void set_pacing(bool pacing) {
+            _pacing = pacing;
+        }
+        void set_rto_min(std::chrono::milliseconds rto_min) {
+            _rto_min = std::min(std::max(rto_min, _rto_clk_granularity), _rto_max);
+        }
         void connect();
         packet read();
         void close();
@@ -442,6 +537,7 @@ class tcp {
             _tcp._tcbs.erase(id);
         }
         compat::optional<typename InetTraits::l4packet> get_packet();
+        void flush_ack();
         void output() {
             if (!_poll_active) {
                 _poll_active = true;
@@ -475,11 +571,27 @@ class tcp {
         void insert_out_of_order(tcp_seq seq, packet p);
         void trim_receive_data_after_window();
         bool should_send_ack(uint16_t seg_len);
+        void schedule_ack();
         void clear_delayed_ack();
-        packet get_transmit_packet();
-        void retransmit_one() {
-            bool data_retransmit = true;
-            output_one(data_retransmit);
+        packet get_transmit_packet(uint8_t options_size);
+        void fill_sack_blocks();
+        void retransmit_one(unacked_segment& seg) {
+            if (seg.lost) {
+                seg.lost = false;
+                _snd.nr_lost--;
+            }
+            auto end = seg.seq + seg.p.len();
+            if (end > _snd.high_rxt) {
+                _snd.high_rxt = end;
+            }
+            seg.tx_time = clock_type::now();
+            output_one(&seg);
+        }
+        void mark_lost(unacked_segment& seg) {
+            if (!seg.lost && !seg.sacked) {
+                seg.lost = true;
+                _snd.nr_lost++;
+            }
         }
         void start_retransmit_timer() {
             auto now = clock_type::now();
@@ -505,9 +617,26 @@ class tcp {
         };
         void persist();
         void retransmit();
-        void fast_retransmit();
-        void update_rto(clock_type::time_point tx_time);
+        void enter_fast_recovery();
+        void fast_retransmit(uint32_t budget = 0);
+        uint32_t retransmit_lost(uint32_t budget);
+        uint32_t process_sack(const tcp_option::sack_blocks& sack);
+        void rack_delivered(const unacked_segment& seg);
+        void detect_losses();
+        void rack_timeout();
+        void update_rto(std::chrono::milliseconds R);
+        void update_rto(clock_type::time_point tx_time) {
+            update_rto(std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - tx_time));
+        }
+        // The clock of the timestamps option, ticking every millisecond
+        static uint32_t ts_clock() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(steady_clock_type::now().time_since_epoch()).count();
+        }
         void update_cwnd(uint32_t acked_bytes);
+        tcp_congestion_event congestion_event(uint32_t in_flight, uint32_t acked_bytes = 0) {
+            return tcp_congestion_event{clock_type::now(), _snd.mss, in_flight, acked_bytes,
+                    _snd.delivered, _snd.last_rtt, _snd.srtt};
+        }
         void cleanup();
         uint32_t can_send() {
             if (_snd.window_probe) {
@@ -530,6 +659,9 @@ class tcp {
 
             // Can not send more than congestion window allows
             x = std::min(_snd.cwnd, x);
+
+            // Can not send faster than the pacing rate allows
+            x = std::min(pacing_allowance(), x);
             if (_snd.dupacks == 1 || _snd.dupacks == 2) {
                 // RFC5681 Step 3.1
                 // Send cwnd + 2 * smss per RFC3042
@@ -544,6 +676,7 @@ class tcp {
             }
             return x;
         }
+        uint32_t pacing_allowance();
         uint32_t flight_size() {
             uint32_t size = 0;
             std::for_each(_snd.data.begin(), _snd.data.end(), [&] (unacked_segment& seg) { size += seg.p.len(); });
@@ -620,6 +753,8 @@ class tcp {
             _snd.unacknowledged = _snd.initial;
             _snd.next = _snd.initial + 1;
             _snd.recover = _snd.initial;
+            _snd.high_rxt = _snd.initial;
+            _snd.rack_end = _snd.initial;
         }
         void do_local_fin_acked() {
             _snd.unacknowledged += 1;
@@ -650,6 +785,7 @@ class tcp {
         bool segment_acceptable(tcp_seq seg_seq, unsigned seg_len);
         void init_from_options(tcp_hdr* th, uint8_t* opt_start, uint8_t* opt_end);
         friend class connection;
+        friend class tcp_tester;
     };
     inet_type& _inet;
     std::unordered_map<connid, lw_shared_ptr<tcb>, connid_hash> _tcbs;
@@ -658,6 +794,8 @@ class tcp {
     std::default_random_engine _e;
     std::uniform_int_distribution<uint16_t> _port_dist{41952, 65535};
     circular_buffer<std::pair<lw_shared_ptr<tcb>, ethernet_address>> _poll_tcbs;
+    // Connections with an ACK scheduled, see tcb::schedule_ack()
+    std::vector<lw_shared_ptr<tcb>> _ack_tcbs;
     // queue for packets that do not belong to any tcb
     circular_buffer<ipv4_traits::l4packet> _packetq;
     semaphore _queue_space = {212992};
@@ -701,15 +839,28 @@ class tcp {
         uint16_t foreign_port() {
             return _tcb->_foreign_port;
         }
+        void set_congestion_control(tcp_congestion_control cc) {
+            _tcb->set_congestion_control(cc);
+        }
+        void set_pacing(bool pacing) {
+            _tcb->set_pacing(pacing);
+        }
+        void set_rto_min(std::chrono::milliseconds rto_min) {
+            _tcb->set_rto_min(rto_min);
+        }
         void shutdown_connect();
         void close_read();
         void close_write();
+        friend class tcp_tester;
     };
     class listener {
         tcp& _tcp;
         uint16_t _port;
         queue<connection> _q;
         size_t _pending = 0;
+        tcp_congestion_control _congestion_control = tcp_congestion_control::reno;
+        bool _pacing = false;
+        std::chrono::milliseconds _rto_min{1000};
     private:
         listener(tcp& t, uint16_t port, size_t queue_length)
             : _tcp(t), _port(port), _q(queue_length) {
@@ -717,7 +868,9 @@ class tcp {
         }
     public:
         listener(listener&& x)
-            : _tcp(x._tcp), _port(x._port), _q(std::move(x._q)) {
+            : _tcp(x._tcp), _port(x._port), _q(std::move(x._q)), _congestion_control(x._congestion_control)
+            , _pacing(x._pacing)
+            , _rto_min(x._rto_min) {
             _tcp._listening[_port] = this;
             x._port = 0;
         }
@@ -744,6 +897,18 @@ class tcp {
         uint16_t port() const {
             return _port;
         }
+        // Congestion control of the connections accepted from now on
+        void set_congestion_control(tcp_congestion_control cc) {
+            _congestion_control = cc;
+        }
+        // Pacing of the connections accepted from now on
+        void set_pacing(bool pacing) {
+            _pacing = pacing;
+        }
+        // Minimum retransmission timeout of the connections accepted from now on
+        void set_rto_min(std::chrono::milliseconds rto_min) {
+            _rto_min = rto_min;
+        }
         friend class tcp;
     };
 public:
@@ -762,11 +927,41 @@ class tcp {
         }
     }
 private:
+    void schedule_ack(lw_shared_ptr<tcb> tcbp);
     void send_packet_without_tcb(ipaddr from, ipaddr to, packet p);
     void respond_with_reset(tcp_hdr* rth, ipaddr local_ip, ipaddr foreign_ip);
     friend class listener;
 };
 
+class tcp_tester {
+public:
+    template <typename Connection>
+    static auto& snd(Connection& c) {
+        return c._tcb->_snd;
+    }
+    template <typename Connection>
+    static auto& rcv(Connection& c) {
+        return c._tcb->_rcv;
+    }
+    // Whether an ACK waits for the tasks woken up by the current poll
+    template <typename Connection>
+    static bool ack_scheduled(Connection& c) {
+        return c._tcb->_ack_scheduled;
+    }
+    template <typename Connection>
+    static tcp_option& option(Connection& c) {
+        return c._tcb->_option;
+    }
+    template <typename Connection>
+    static std::chrono::milliseconds rto(Connection& c) {
+        return c._tcb->_rto;
+    }
+    template <typename Connection>
+    static std::chrono::milliseconds rto_min(Connection& c) {
+        return c._tcb->_rto_min;
+    }
+};
+
 template <typename InetTraits>
 tcp<InetTraits>::tcp(inet_type& inet)
     : _inet(inet)
@@ -811,6 +1006,19 @@ future<> tcp<InetTraits>::poll_tcb(ipaddr to, lw_shared_ptr<tcb> tcb) {
     });
 }
 
+template <typename InetTraits>
+void tcp<InetTraits>::schedule_ack(lw_shared_ptr<tcb> tcbp) {
+    if (_ack_tcbs.empty()) {
+        // Queued behind the tasks the received segments woke up
+        (void)later().then([this] {
+            for (auto& tcbp : std::exchange(_ack_tcbs, {})) {
+                tcbp->flush_ack();
+            }
+        });
+    }
+    _ack_tcbs.push_back(std::move(tcbp));
+}
+
 template <typename InetTraits>
 auto tcp<InetTraits>::listen(uint16_t port, size_t queue_length) -> listener {
     return listener(*this, port, queue_length);
@@ -904,6 +1112,9 @@ void tcp<InetTraits>::received(packet p, ipaddr from, ipaddr to) {
                 // check the security
                 // NOTE: Ignored for now
                 tcbp = make_lw_shared<tcb>(*this, id);
+                tcbp->set_congestion_control(listener->second->_congestion_control);
+                tcbp->set_pacing(listener->second->_pacing);
+                tcbp->set_rto_min(listener->second->_rto_min);
                 _tcbs.insert({id, tcbp});
                 // TODO: we need to remove the tcb and decrease the pending if
                 // it stays SYN_RECEIVED state forever.
@@ -957,9 +1168,12 @@ tcp<InetTraits>::tcb::tcb(tcp& t, connid id)
     , _foreign_ip(id.foreign_ip)
     , _local_port(id.local_port)
     , _foreign_port(id.foreign_port)
+    , _cc(make_tcp_congestion_controller(tcp_congestion_control::reno))
     , _delayed_ack([this] { _nr_full_seg_received = 0; output(); })
     , _retransmit([this] { retransmit(); })
-    , _persist([this] { persist(); }) {
+    , _persist([this] { persist(); })
+    , _rack_reorder([this] { rack_timeout(); })
+    , _pacing_timer([this] { if (can_send() > 0) { output(); } }) {
 }
 
 template <typename InetTraits>
@@ -1017,11 +1231,22 @@ uint32_t tcp<InetTraits>::tcb::data_segment_acked(tcp_seq seg_ack) {
     // Full ACK of segment
     while (!_snd.data.empty()
             && (_snd.unacknowledged + _snd.data.front().p.len() <= seg_ack)) {
-        auto acked_bytes = _snd.data.front().p.len();
+        auto& acked_seg = _snd.data.front();
+        auto acked_bytes = acked_seg.p.len();
         _snd.unacknowledged += acked_bytes;
-        // Ignore retransmitted segments when setting the RTO
-        if (_snd.data.front().nr_transmits == 0) {
-            update_rto(_snd.data.front().tx_time);
+        // Ignore retransmitted segments when setting the RTO, the echoed
+        // timestamps give a sample for every ACK otherwise
+        if (acked_seg.nr_transmits == 0 && !_option._timestamps_received) {
+            update_rto(acked_seg.tx_time);
+        }
+        if (acked_seg.sacked) {
+            _snd.sacked_bytes -= acked_bytes;
+        } else {
+            _snd.delivered += acked_bytes;
+            rack_delivered(acked_seg);
+        }
+        if (acked_seg.lost) {
+            _snd.nr_lost--;
         }
         update_cwnd(acked_bytes);
         total_acked_bytes += acked_bytes;
@@ -1035,6 +1260,12 @@ uint32_t tcp<InetTraits>::tcb::data_segment_acked(tcp_seq seg_ack) {
         if (!_snd.data.empty()) {
             auto& unacked_seg = _snd.data.front();
             unacked_seg.p.trim_front(acked_bytes);
+            unacked_seg.seq = seg_ack;
+            if (unacked_seg.sacked) {
+                _snd.sacked_bytes -= acked_bytes;
+            } else {
+                _snd.delivered += acked_bytes;
+            }
         }
         _snd.unacknowledged = seg_ack;
         update_cwnd(acked_bytes);
@@ -1201,9 +1432,23 @@ void tcp<InetTraits>::tcb::input_handle_syn_sent_state(tcp_hdr* th, packet p) {
 
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
+    tcp_option::sack_blocks sack;
+    tcp_option::timestamps ts{};
+    bool ts_received = false;
+    auto opt_len = th->data_offset * 4 - tcp_hdr::len;
+    if ((_option._sack_received || _option._timestamps_received) && opt_len) {
+        auto opt_start = reinterpret_cast<uint8_t*>(p.get_header(0, th->data_offset * 4)) + tcp_hdr::len;
+        if (_option._sack_received) {
+            sack = tcp_option::parse_sack_blocks(opt_start, opt_start + opt_len);
+        }
+        if (_option._timestamps_received) {
+            ts_received = tcp_option::parse_timestamps(opt_start, opt_start + opt_len, ts);
+        }
+    }
     p.trim_front(th->data_offset * 4);
     bool do_output = false;
     bool do_output_data = false;
+    bool do_ack = false;
     tcp_seq seg_seq = th->seq;
     auto seg_ack = th->ack;
     auto seg_len = p.len();
@@ -1214,6 +1459,12 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
         return output();
     }
 
+    // RFC7323 4.3: echo the timestamp of the earliest segment the next ACK
+    // acknowledges
+    if (ts_received && seg_seq <= _rcv.last_ack_sent && int32_t(ts.t1 - _option._ts_recent) >= 0) {
+        _option._ts_recent = ts.t1;
+    }
+
     // In the following it is assumed that the segment is the idealized
     // segment that begins at RCV.NXT and does not exceed the window.
     if (seg_seq < _rcv.next) {
@@ -1322,8 +1573,16 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
             auto packets_out = _snd.next - _snd.unacknowledged - _snd.zero_window_probing_out;
             // If SND.UNA < SEG.ACK =< SND.NXT then, set SND.UNA <- SEG.ACK.
             if (_snd.unacknowledged < seg_ack && seg_ack <= _snd.next) {
+                // RFC7323 4.2: take an RTT sample from every ACK of new data
+                if (ts_received && ts.t2) {
+                    auto ts_rtt = int32_t(ts_clock() - ts.t2);
+                    if (ts_rtt >= 0) {
+                        update_rto(std::chrono::milliseconds(ts_rtt));
+                    }
+                }
                 // Remote ACKed data we sent
                 auto acked_bytes = data_segment_acked(seg_ack);
+                auto sacked_bytes = process_sack(sack);
 
                 // If SND.UNA < SEG.ACK =< SND.NXT, the send window should be updated.
                 if (_snd.wl1 < seg_seq || (_snd.wl1 == seg_seq && _snd.wl2 <= seg_ack)) {
@@ -1357,11 +1616,12 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
                         set_retransmit_timer();
                     } else {
                         tcp_debug("ack: partial_ack\n");
-                        // Retransmit the first unacknowledged segment
-                        fast_retransmit();
+                        // Retransmit the first unacknowledged segment, and with
+                        // SACK as many of the other holes as were just delivered
+                        fast_retransmit(acked_bytes + sacked_bytes);
                         // Deflate the congestion window by the amount of new data
                         // acknowledged by the Cumulative Acknowledgment field
-                        _snd.cwnd -= acked_bytes;
+                        _snd.cwnd -= std::min(_snd.cwnd, acked_bytes);
                         // If the partial ACK acknowledges at least one SMSS of new
                         // data, then add back SMSS bytes to the congestion window
                         if (acked_bytes >= smss) {
@@ -1385,6 +1645,11 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
                     // SND.UNA.
                     exit_fast_recovery();
                     set_retransmit_timer();
+                    if (_snd.nr_lost) {
+                        // Repair the holes left by a retransmission timeout. As
+                        // in slow start, each delivered byte releases two.
+                        retransmit_lost(2 * (acked_bytes + sacked_bytes));
+                    }
                 }
             } else if ((packets_out > 0) && !_snd.data.empty() && seg_len == 0 &&
                 th->f_fin == 0 && th->f_syn == 0 &&
@@ -1399,6 +1664,12 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
                 // Here, We follow RFC5681.
                 _snd.dupacks++;
                 uint32_t smss = _snd.mss;
+                auto sacked_bytes = process_sack(sack);
+                // With SACK the first hole can be known to be lost before
+                // the third duplicate ACK arrives (RFC6675 Section 5)
+                if (_snd.dupacks < 3 && _snd.data.front().lost) {
+                    _snd.dupacks = 3;
+                }
                 // 3 duplicated ACKs trigger a fast retransmit
                 if (_snd.dupacks == 1 || _snd.dupacks == 2) {
                     // RFC5681 Step 3.1
@@ -1407,16 +1678,17 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
                 } else if (_snd.dupacks == 3) {
                     // RFC6582 Step 3.2
                     if (seg_ack - 1 > _snd.recover) {
-                        _snd.recover = _snd.next - 1;
-                        // RFC5681 Step 3.2
-                        _snd.ssthresh = std::max((flight_size() - _snd.limited_transfer) / 2, 2 * smss);
-                        fast_retransmit();
+                        enter_fast_recovery();
                     } else {
                         // Do not enter fast retransmit and do not reset ssthresh
                     }
                     // RFC5681 Step 3.3
                     _snd.cwnd = _snd.ssthresh + 3 * smss;
                 } else if (_snd.dupacks > 3) {
+                    // Retransmit the holes found lost, as much as was just SACKed
+                    if (_snd.nr_lost) {
+                        retransmit_lost(sacked_bytes);
+                    }
                     // RFC5681 Step 3.4
                     _snd.cwnd += smss;
                     // RFC5681 Step 3.5
@@ -1504,7 +1776,7 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
                 // sequence space.
                 do_output = true;
             } else {
-                do_output = should_send_ack(seg_len);
+                do_ack = should_send_ack(seg_len);
             }
         }
     } else if (in_state(CLOSE_WAIT | CLOSING | LAST_ACK | TIME_WAIT)) {
@@ -1529,6 +1801,7 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
             // and <FIN> in a single packet, so canncel the previous ACK.
             clear_delayed_ack();
             do_output = false;
+            do_ack = false;
             // Send ACK for the FIN!
             output();
 
@@ -1555,11 +1828,13 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
         // Since we will do output, we can canncel scheduled delayed ACK.
         clear_delayed_ack();
         output();
+    } else if (do_ack) {
+        schedule_ack();
     }
 }
 
 template <typename InetTraits>
-packet tcp<InetTraits>::tcb::get_transmit_packet() {
+packet tcp<InetTraits>::tcb::get_transmit_packet(uint8_t options_size) {
     // easy case: empty queue
     if (_snd.unsent.empty()) {
         return packet();
@@ -1573,7 +1848,15 @@ packet tcp<InetTraits>::tcb::get_transmit_packet() {
     } else {
         len = std::min(uint16_t(_tcp.hw_features().mtu - net::tcp_hdr_len_min - InetTraits::ip_hdr_len_min), _snd.mss);
     }
+    // Leave room for the options
+    len -= options_size;
     can_send = std::min(can_send, len);
+    // Make a super-segment the NIC splits into full segments only, and leave
+    // the runt to the end of the data rather than the end of each burst
+    uint32_t seg_size = _snd.mss - options_size;
+    if (can_send > seg_size && can_send < _snd.unsent_len) {
+        can_send -= can_send % seg_size;
+    }
     // easy case: one small packet
     if (_snd.unsent.size() == 1 && _snd.unsent.front().len() <= can_send) {
         auto p = std::move(_snd.unsent.front());
@@ -1608,18 +1891,32 @@ packet tcp<InetTraits>::tcb::get_transmit_packet() {
 }
 
 template <typename InetTraits>
-void tcp<InetTraits>::tcb::output_one(bool data_retransmit) {
+void tcp<InetTraits>::tcb::output_one(unacked_segment* retransmit_seg) {
     if (in_state(CLOSED)) {
         return;
     }
 
-    packet p = data_retransmit ? _snd.data.front().p.share() : get_transmit_packet();
-    packet clone = p.share();  // early clone to prevent share() from calling packet::unuse_internal_data() on header.
-    uint16_t len = p.len();
+    bool data_retransmit = retransmit_seg;
     bool syn_on = syn_needs_on();
     bool ack_on = ack_needs_on();
-
+    if (_option._sack_received && ack_on && !syn_on) {
+        fill_sack_blocks();
+    } else {
+        _option._local_sack.nr = 0;
+    }
+    _option._local_ts_val = ts_clock();
     auto options_size = _option.get_size(syn_on, ack_on);
+
+    packet p = data_retransmit ? retransmit_seg->p.share() : get_transmit_packet(options_size);
+    packet clone = p.share();  // early clone to prevent share() from calling packet::unuse_internal_data() on header.
+    uint16_t len = p.len();
+    if (data_retransmit) {
+        // The segment was sized for the options it was first sent with
+        while (_option._local_sack.nr && len + options_size > _snd.mss) {
+            _option._local_sack.nr--;
+            options_size = _option.get_size(syn_on, ack_on);
+        }
+    }
     auto th = p.prepend_uninitialized_header(tcp_hdr::len + options_size);
     auto h = tcp_hdr{};
 
@@ -1636,13 +1933,17 @@ void tcp<InetTraits>::tcb::output_one(bool data_retransmit) {
 
     tcp_seq seq;
     if (data_retransmit) {
-        seq = _snd.unacknowledged;
+        seq = retransmit_seg->seq;
     } else {
         seq = syn_on ? _snd.initial : _snd.next;
         _snd.next += len;
+        if (_pacing) {
+            _snd.pacing_credit -= len;
+        }
     }
     h.seq = seq;
     h.ack = _rcv.next;
+    _rcv.last_ack_sent = _rcv.next;
     h.data_offset = (tcp_hdr::len + options_size) / 4;
     h.window = _rcv.window >> _rcv.window_scale;
     h.checksum = 0;
@@ -1673,8 +1974,8 @@ void tcp<InetTraits>::tcb::output_one(bool data_retransmit) {
         // segment length set to 0. All the rest is the same as for a TCP Tx
         // CSUM offload case.
         //
-        if (_tcp.hw_features().tx_tso && len > _snd.mss) {
-            oi.tso_seg_size = _snd.mss;
+        if (_tcp.hw_features().tx_tso && len > _snd.mss - options_size) {
+            oi.tso_seg_size = _snd.mss - options_size;
         } else {
             pseudo_hdr_seg_len = tcp_hdr::len + options_size + len;
         }
@@ -1704,7 +2005,7 @@ void tcp<InetTraits>::tcb::output_one(bool data_retransmit) {
         if (len) {
             unsigned nr_transmits = 0;
             _snd.data.emplace_back(unacked_segment{std::move(clone),
-                                   len, nr_transmits, now});
+                                   len, nr_transmits, now, seq});
         }
         if (!_retransmit.armed()) {
             start_retransmit_timer(now);
@@ -1858,9 +2159,30 @@ bool tcp<InetTraits>::tcb::should_send_ack(uint16_t seg_len) {
     return false;
 }
 
+// Sends the ACK once the tasks woken up by the current poll ran rather than
+// right away, so that the replies they send carry it, and all the segments
+// the connection received in the meantime share it.
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::schedule_ack() {
+    if (!_ack_scheduled) {
+        _ack_scheduled = true;
+        _tcp.schedule_ack(this->shared_from_this());
+    }
+}
+
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::flush_ack() {
+    // Any segment sent in the meantime carried the ACK
+    if (_ack_scheduled && !in_state(CLOSED)) {
+        _ack_scheduled = false;
+        output();
+    }
+}
+
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::clear_delayed_ack() {
     _delayed_ack.cancel();
+    _ack_scheduled = false;
 }
 
 template <typename InetTraits>
@@ -1903,9 +2225,41 @@ bool tcp<InetTraits>::tcb::merge_out_of_order() {
 
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::insert_out_of_order(tcp_seq seg, packet p) {
+    _rcv.last_out_of_order = seg;
     _rcv.out_of_order.merge(seg, std::move(p));
 }
 
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::fill_sack_blocks() {
+    auto& sack = _option._local_sack;
+    auto& map = _rcv.out_of_order.map;
+    sack.nr = 0;
+    auto add = [&sack] (tcp_seq beg, const packet& p) {
+        sack.left[sack.nr] = beg.raw;
+        sack.right[sack.nr] = (beg + p.len()).raw;
+        sack.nr++;
+    };
+    // Adjacent out-of-order segments are merged, so each one is a block.
+    // RFC2018: the first block reports the most recently received segment.
+    auto recent = map.upper_bound(_rcv.last_out_of_order);
+    if (recent != map.begin()) {
+        --recent;
+        if (_rcv.last_out_of_order < recent->first + recent->second.len()) {
+            add(recent->first, recent->second);
+        } else {
+            recent = map.end();
+        }
+    } else {
+        recent = map.end();
+    }
+    uint8_t max_blocks = _option._timestamps_received ? sack.max_blocks - 1 : sack.max_blocks;
+    for (auto it = map.begin(); it != map.end() && sack.nr < max_blocks; ++it) {
+        if (it != recent) {
+            add(it->first, it->second);
+        }
+    }
+}
+
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::trim_receive_data_after_window() {
     abort();
@@ -1963,12 +2317,14 @@ void tcp<InetTraits>::tcb::retransmit() {
 
     // If there are unacked data, retransmit the earliest segment
     auto& unacked_seg = _snd.data.front();
+    _snd.high_rxt = _snd.unacknowledged;
 
     // According to RFC5681
     // Update ssthresh only for the first retransmit
     uint32_t smss = _snd.mss;
     if (unacked_seg.nr_transmits == 0) {
-        _snd.ssthresh = std::max(flight_size() / 2, 2 * smss);
+        bool timeout = true;
+        _snd.ssthresh = _cc->on_loss(_snd.cwnd, congestion_event(flight_size()), timeout);
     }
     // RFC6582 Step 4
     _snd.recover = _snd.next - 1;
@@ -1984,25 +2340,185 @@ void tcp<InetTraits>::tcb::retransmit() {
         do_reset();
         return;
     }
-    retransmit_one();
+    if (_option._sack_received) {
+        // Everything outstanding which was not SACKed is lost. The receiver
+        // may renege on SACKed data though, so once the first segment timed
+        // out twice the scoreboard is no longer trusted.
+        for (auto& seg : _snd.data) {
+            if (seg.sacked && unacked_seg.nr_transmits > 1) {
+                seg.sacked = false;
+                _snd.sacked_bytes -= seg.p.len();
+            }
+            mark_lost(seg);
+        }
+        _rack_reorder.cancel();
+    }
+    retransmit_one(unacked_seg);
 
     output_update_rto();
 }
 
 template <typename InetTraits>
-void tcp<InetTraits>::tcb::fast_retransmit() {
+void tcp<InetTraits>::tcb::enter_fast_recovery() {
+    _snd.recover = _snd.next - 1;
+    _snd.high_rxt = _snd.unacknowledged;
+    // RFC5681 Step 3.2
+    bool timeout = false;
+    _snd.ssthresh = _cc->on_loss(_snd.cwnd, congestion_event(flight_size() - _snd.limited_transfer), timeout);
+    fast_retransmit();
+}
+
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::fast_retransmit(uint32_t budget) {
     if (!_snd.data.empty()) {
         auto& unacked_seg = _snd.data.front();
-        unacked_seg.nr_transmits++;
-        retransmit_one();
+        if (_option._sack_received) {
+            // The first hole is lost unless it was already retransmitted in
+            // this recovery; RACK tells when a retransmission is lost again.
+            if (unacked_seg.seq >= _snd.high_rxt) {
+                mark_lost(unacked_seg);
+            }
+            retransmit_lost(budget);
+        } else {
+            unacked_seg.nr_transmits++;
+            retransmit_one(unacked_seg);
+        }
+        output();
+    }
+}
+
+// Retransmits the segments deemed lost, oldest first, until budget bytes
+// were sent. At least one segment is sent if any is lost.
+template <typename InetTraits>
+uint32_t tcp<InetTraits>::tcb::retransmit_lost(uint32_t budget) {
+    uint32_t sent = 0;
+    for (auto& seg : _snd.data) {
+        if (!_snd.nr_lost || (sent && sent >= budget)) {
+            break;
+        }
+        if (seg.lost) {
+            sent += seg.p.len();
+            seg.nr_transmits++;
+            retransmit_one(seg);
+        }
+    }
+    if (sent) {
         output();
     }
+    return sent;
+}
+
+// Updates the scoreboard from the SACK blocks of an ACK and returns the
+// number of newly SACKed bytes.
+template <typename InetTraits>
+uint32_t tcp<InetTraits>::tcb::process_sack(const tcp_option::sack_blocks& sack) {
+    uint32_t sacked_bytes = 0;
+    for (uint8_t i = 0; i < sack.nr; i++) {
+        auto left = make_seq(sack.left[i]);
+        auto right = make_seq(sack.right[i]);
+        // Ignore D-SACK and bogus blocks
+        if (right <= left || left < _snd.unacknowledged || right > _snd.next) {
+            continue;
+        }
+        for (auto& seg : _snd.data) {
+            if (seg.seq >= right) {
+                break;
+            }
+            auto len = seg.p.len();
+            if (!seg.sacked && left <= seg.seq && seg.seq + len <= right) {
+                if (seg.lost) {
+                    seg.lost = false;
+                    _snd.nr_lost--;
+                }
+                seg.sacked = true;
+                _snd.sacked_bytes += len;
+                _snd.delivered += len;
+                sacked_bytes += len;
+                rack_delivered(seg);
+            }
+        }
+    }
+    if (_snd.sacked_bytes) {
+        detect_losses();
+    }
+    return sacked_bytes;
+}
+
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::rack_delivered(const unacked_segment& seg) {
+    auto rtt = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - seg.tx_time);
+    // A retransmitted segment delivered faster than any RTT seen so far
+    // was likely delivered by its original transmission (RFC8985 Step 2)
+    if (seg.nr_transmits && rtt < _snd.min_rtt) {
+        return;
+    }
+    auto end = seg.seq + seg.p.len();
+    if (seg.tx_time > _snd.rack_tx_time || (seg.tx_time == _snd.rack_tx_time && end > _snd.rack_end)) {
+        _snd.rack_tx_time = seg.tx_time;
+        _snd.rack_end = end;
+        _snd.rack_rtt = rtt;
+    }
+}
+
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::detect_losses() {
+    // RFC6675: a segment never retransmitted in this recovery is lost once
+    // more than (DupThresh - 1) * SMSS bytes above it were SACKed
+    uint32_t sacked_above = 0;
+    for (auto it = _snd.data.rbegin(); it != _snd.data.rend(); ++it) {
+        if (it->sacked) {
+            sacked_above += it->p.len();
+        } else if (sacked_above > 2 * uint32_t(_snd.mss) && (it->nr_transmits == 0 || it->seq >= _snd.high_rxt)) {
+            mark_lost(*it);
+        }
+    }
+
+    // RFC8985: a segment is lost if one sent after it was delivered and it
+    // has been outstanding for longer than the RTT plus a reordering window
+    auto now = clock_type::now();
+    auto reo_wnd = _snd.first_rto_sample ? std::chrono::milliseconds(0) : _snd.min_rtt / 4;
+    auto timeout = clock_type::time_point::max();
+    for (auto& seg : _snd.data) {
+        if (seg.sacked || seg.lost) {
+            continue;
+        }
+        auto end = seg.seq + seg.p.len();
+        if (seg.tx_time > _snd.rack_tx_time || (seg.tx_time == _snd.rack_tx_time && end >= _snd.rack_end)) {
+            continue;
+        }
+        auto deadline = seg.tx_time + _snd.rack_rtt + reo_wnd;
+        if (deadline <= now) {
+            mark_lost(seg);
+        } else {
+            timeout = std::min(timeout, deadline);
+        }
+    }
+    if (timeout != clock_type::time_point::max()) {
+        _rack_reorder.rearm(timeout);
+    } else {
+        _rack_reorder.cancel();
+    }
+}
+
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::rack_timeout() {
+    detect_losses();
+    if (!_snd.nr_lost) {
+        return;
+    }
+    if (_snd.dupacks < 3 && _snd.unacknowledged - 1 > _snd.recover) {
+        // Loss detected before the third duplicate ACK arrived
+        _snd.dupacks = 3;
+        enter_fast_recovery();
+        _snd.cwnd = _snd.ssthresh + 3 * _snd.mss;
+    } else {
+        retransmit_lost(_snd.mss);
+    }
 }
 
 template <typename InetTraits>
-void tcp<InetTraits>::tcb::update_rto(clock_type::time_point tx_time) {
+void tcp<InetTraits>::tcb::update_rto(std::chrono::milliseconds R) {
     // Update RTO according to RFC6298
-    auto R = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - tx_time);
     if (_snd.first_rto_sample) {
         _snd.first_rto_sample = false;
         // RTTVAR <- R/2
@@ -2017,31 +2533,57 @@ void tcp<InetTraits>::tcb::update_rto(clock_type::time_point tx_time) {
         _snd.rttvar = _snd.rttvar * 3 / 4 + delta / 4;
         _snd.srtt = _snd.srtt * 7 / 8 +  R / 8;
     }
+    _snd.min_rtt = std::min(_snd.min_rtt, R);
+    _snd.last_rtt = std::max(R, _rto_clk_granularity);
     // RTO <- SRTT + max(G, K * RTTVAR)
     _rto =  _snd.srtt + std::max(_rto_clk_granularity, 4 * _snd.rttvar);
 
-    // Make sure 1 sec << _rto << 60 sec
+    // Make sure _rto_min << _rto << 60 sec
     _rto = std::max(_rto, _rto_min);
     _rto = std::min(_rto, _rto_max);
 }
 
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::update_cwnd(uint32_t acked_bytes) {
-    uint32_t smss = _snd.mss;
-    if (_snd.cwnd < _snd.ssthresh) {
-        // In slow start phase
-        _snd.cwnd += std::min(acked_bytes, smss);
-    } else {
-        // In congestion avoidance phase
-        uint32_t round_up = 1;
-        _snd.cwnd += std::max(round_up, smss * smss / _snd.cwnd);
-    }
+    auto in_flight = uint32_t(_snd.next - _snd.unacknowledged);
+    _cc->on_ack(_snd.cwnd, _snd.ssthresh, congestion_event(in_flight, acked_bytes));
+}
+
+template <typename InetTraits>
+uint32_t tcp<InetTraits>::tcb::pacing_allowance() {
+    if (!_pacing) {
+        return std::numeric_limits<uint32_t>::max();
+    }
+    auto rate = _cc->pacing_rate(_snd.cwnd, _snd.ssthresh, congestion_event(_snd.next - _snd.unacknowledged));
+    if (!rate) {
+        return std::numeric_limits<uint32_t>::max();
+    }
+    // Earn credit at the pacing rate, but no more than a millisecond's worth
+    // (and at least two segments, so TSO still pays off) is sent back to back
+    auto now = steady_clock_type::now();
+    auto elapsed = std::chrono::duration<double>(now - _snd.pacing_stamp).count();
+    _snd.pacing_stamp = now;
+    auto quantum = std::min(std::max(2.0 * _snd.mss, rate / 1000.0), 65536.0);
+    _snd.pacing_credit = std::min(_snd.pacing_credit + rate * elapsed, quantum);
+    auto wanted = std::min(uint32_t(_snd.mss), _snd.unsent_len);
+    if (_snd.pacing_credit < wanted) {
+        if (!_pacing_timer.armed()) {
+            auto wait = std::chrono::duration<double>((wanted - _snd.pacing_credit) / rate);
+            _pacing_timer.arm(std::chrono::duration_cast<steady_clock_type::duration>(wait));
+        }
+        return 0;
+    }
+    return _snd.pacing_credit;
 }
 
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::cleanup() {
     _snd.unsent.clear();
     _snd.data.clear();
+    _snd.sacked_bytes = 0;
+    _snd.nr_lost = 0;
+    _rack_reorder.cancel();
+    _pacing_timer.cancel();
     _rcv.out_of_order.map.clear();
     _rcv.data_size = 0;
     _rcv.data.clear();
@@ -2118,9 +2660,6 @@ void tcp<InetTraits>::connection::shutdown_connect() {
 template <typename InetTraits>
 constexpr uint16_t tcp<InetTraits>::tcb::_max_nr_retransmit;
 
-template <typename InetTraits>
-constexpr std::chrono::milliseconds tcp<InetTraits>::tcb::_rto_min;
-
 template <typename InetTraits>
 constexpr std::chrono::milliseconds tcp<InetTraits>::tcb::_rto_max;
 
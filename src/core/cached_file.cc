@@ -0,0 +1,348 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#include <seastar/core/cached_file.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/do_with.hh>
+#include <seastar/core/metrics.hh>
+#include <boost/range/irange.hpp>
+#include <string.h>
+
+namespace seastar {
+
+block_cache::block_cache(config cfg)
+    : _cfg(std::move(cfg))
+    , _reclaimer([this] (memory::reclaimer::request r) {
+        return evict(r.bytes_to_reclaim) ? memory::reclaiming_result::reclaimed_something
+                                         : memory::reclaiming_result::reclaimed_nothing;
+    }, memory::reclaimer_scope::async)
+{
+    if (!_cfg.block_size) {
+        throw std::invalid_argument("block cache block size must not be zero");
+    }
+    namespace sm = seastar::metrics;
+    auto cache_label = sm::label("cache");
+    std::vector<sm::label_instance> labels{cache_label(_cfg.name)};
+    _metrics.add_group("block_cache", {
+            sm::make_derive("hits", _stats.hits, sm::description("Total number of blocks read from the cache"), labels),
+            sm::make_derive("misses", _stats.misses, sm::description("Total number of blocks read from the disk because they were not cached"), labels),
+            sm::make_derive("evictions", _stats.evictions, sm::description("Total number of blocks evicted to make room or to release memory"), labels),
+            sm::make_derive("invalidations", _stats.invalidations, sm::description("Total number of blocks dropped because their file was modified or closed"), labels),
+            sm::make_current_bytes("bytes", _stats.bytes, sm::description("Memory held by cached blocks"), labels),
+    });
+}
+
+block_cache::~block_cache() {
+    clear();
+}
+
+temporary_buffer<uint8_t>* block_cache::find(uint64_t file_id, uint64_t index) {
+    auto it = _blocks.find(key{file_id, index});
+    if (it == _blocks.end()) {
+        return nullptr;
+    }
+    auto& b = it->second;
+    b.lru_link.unlink();
+    _lru.push_back(b);
+    return &b.data;
+}
+
+void block_cache::insert(uint64_t file_id, uint64_t index, temporary_buffer<uint8_t> data, file_list& owner) {
+    auto size = data.size();
+    if (size > _cfg.capacity) {
+        return;
+    }
+    key k{file_id, index};
+    erase(k);
+    evict(_stats.bytes + size > _cfg.capacity ? _stats.bytes + size - _cfg.capacity : 0);
+    auto& b = _blocks.emplace(std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple()).first->second;
+    b.k = k;
+    b.data = std::move(data);
+    _lru.push_back(b);
+    owner.push_back(b);
+    _stats.bytes += size;
+}
+
+void block_cache::erase(const key& k) {
+    auto it = _blocks.find(k);
+    if (it != _blocks.end()) {
+        _stats.bytes -= it->second.data.size();
+        _blocks.erase(it);
+    }
+}
+
+// Looks the blocks of the range up when there are fewer of them than
+// cached blocks, and walks the blocks of the file otherwise.
+void block_cache::invalidate(uint64_t file_id, file_list& blocks, uint64_t from, uint64_t to) {
+    if (to - from <= _blocks.size()) {
+        for (auto index = from; index < to; ++index) {
+            key k{file_id, index};
+            if (_blocks.count(k)) {
+                ++_stats.invalidations;
+                erase(k);
+            }
+        }
+        return;
+    }
+    for (auto it = blocks.begin(); it != blocks.end();) {
+        auto& b = *it++;
+        if (b.k.index >= from && b.k.index < to) {
+            ++_stats.invalidations;
+            erase(b.k);
+        }
+    }
+}
+
+size_t block_cache::evict(size_t bytes) {
+    size_t evicted = 0;
+    while (evicted < bytes && !_lru.empty()) {
+        auto& b = _lru.front();
+        evicted += b.data.size();
+        ++_stats.evictions;
+        erase(b.k);
+    }
+    return evicted;
+}
+
+void block_cache::set_capacity(size_t capacity) {
+    _cfg.capacity = capacity;
+    evict(_stats.bytes > capacity ? _stats.bytes - capacity : 0);
+}
+
+void block_cache::clear() {
+    _lru.clear();
+    _blocks.clear();
+    _stats.bytes = 0;
+}
+
+class cached_file_impl : public file_impl {
+    file _file;
+    block_cache& _cache;
+    uint64_t _id;
+    block_cache::file_list _blocks;
+    // Bumped when a modification starts and when it completes; blocks whose
+    // read overlapped a modification are not cached, as they may be stale.
+    uint64_t _generation = 0;
+    // Only the last block of the file may be short, see invalidate()
+    compat::optional<uint64_t> _short_block;
+private:
+    static constexpr uint64_t all_blocks = std::numeric_limits<uint64_t>::max();
+
+    uint64_t block_size() const {
+        return _cache.block_size();
+    }
+
+    // The last block of the file may be short. Any modification may extend
+    // the file, so it drops the short block along with the modified ones.
+    void invalidate(uint64_t pos, uint64_t len) {
+        ++_generation;
+        auto from = pos / block_size();
+        auto to = len == all_blocks ? all_blocks : (pos + len + block_size() - 1) / block_size();
+        _cache.invalidate(_id, _blocks, from, to);
+        if (_short_block) {
+            _cache.invalidate(_id, _blocks, *_short_block, *_short_block + 1);
+            _short_block = compat::nullopt;
+        }
+    }
+
+    template <typename Func>
+    auto modify(uint64_t pos, uint64_t len, Func&& func) {
+        invalidate(pos, len);
+        return futurize_invoke(std::forward<Func>(func)).finally([this, pos, len] {
+            invalidate(pos, len);
+        });
+    }
+
+    future<temporary_buffer<uint8_t>> get_block(uint64_t index, const io_priority_class& pc) {
+        if (auto data = _cache.find(_id, index)) {
+            ++_cache._stats.hits;
+            return make_ready_future<temporary_buffer<uint8_t>>(data->share());
+        }
+        ++_cache._stats.misses;
+        auto generation = _generation;
+        auto buf = temporary_buffer<uint8_t>::aligned(_memory_dma_alignment, block_size());
+        auto p = buf.get_write();
+        return _file.dma_read(index * block_size(), p, block_size(), pc).then(
+                [this, index, generation, buf = std::move(buf)] (size_t size) mutable {
+            buf.trim(size);
+            if (generation == _generation && size) {
+                if (size < block_size()) {
+                    if (_short_block && *_short_block != index) {
+                        _cache.invalidate(_id, _blocks, *_short_block, *_short_block + 1);
+                    }
+                    _short_block = index;
+                } else if (_short_block == index) {
+                    _short_block = compat::nullopt;
+                }
+                _cache.insert(_id, index, buf.share(), _blocks);
+            }
+            return std::move(buf);
+        });
+    }
+
+    // Returns the blocks covering [pos, pos + len), which may end early at end of file.
+    future<std::vector<temporary_buffer<uint8_t>>> get_blocks(uint64_t pos, size_t len, const io_priority_class& pc) {
+        auto first = pos / block_size();
+        auto last = (pos + len - 1) / block_size();
+        return do_with(std::vector<temporary_buffer<uint8_t>>(last - first + 1), [this, first, last, &pc] (auto& blocks) {
+            return parallel_for_each(boost::irange(first, last + 1), [this, first, &blocks, &pc] (uint64_t index) {
+                return get_block(index, pc).then([&blocks, slot = index - first] (temporary_buffer<uint8_t> data) {
+                    blocks[slot] = std::move(data);
+                });
+            }).then([&blocks] {
+                return std::move(blocks);
+            });
+        });
+    }
+
+    // Copies [pos, pos + len) out of the blocks returned by get_blocks(),
+    // returning the number of bytes copied.
+    size_t copy_out(uint64_t pos, std::vector<temporary_buffer<uint8_t>>& blocks, char* dst, size_t len) {
+        size_t copied = 0;
+        auto offset = pos % block_size();
+        for (auto&& b : blocks) {
+            if (offset >= b.size() || copied == len) {
+                break;
+            }
+            auto n = std::min(b.size() - offset, len - copied);
+            ::memcpy(dst + copied, b.get() + offset, n);
+            copied += n;
+            if (b.size() < block_size()) {
+                break;
+            }
+            offset = 0;
+        }
+        return copied;
+    }
+public:
+    cached_file_impl(file f, block_cache& cache)
+        : _file(std::move(f))
+        , _cache(cache)
+        , _id(cache._next_file_id++)
+    {
+        _memory_dma_alignment = _file.memory_dma_alignment();
+        _disk_read_dma_alignment = _file.disk_read_dma_alignment();
+        _disk_write_dma_alignment = _file.disk_write_dma_alignment();
+        if (block_size() % _disk_read_dma_alignment) {
+            throw std::invalid_argument("block cache block size is not a multiple of the file's read alignment");
+        }
+    }
+
+    ~cached_file_impl() {
+        _cache.invalidate(_id, _blocks, 0, all_blocks);
+    }
+
+    virtual future<size_t> write_dma(uint64_t pos, const void* buffer, size_t len, const io_priority_class& pc) override {
+        return modify(pos, len, [=] {
+            return _file.dma_write(pos, static_cast<const char*>(buffer), len, pc);
+        });
+    }
+    virtual future<size_t> write_dma(uint64_t pos, std::vector<iovec> iov, const io_priority_class& pc) override {
+        size_t len = 0;
+        for (auto&& v : iov) {
+            len += v.iov_len;
+        }
+        return modify(pos, len, [this, pos, iov = std::move(iov), &pc] () mutable {
+            return _file.dma_write(pos, std::move(iov), pc);
+        });
+    }
+    virtual future<size_t> read_dma(uint64_t pos, void* buffer, size_t len, const io_priority_class& pc) override {
+        if (!len) {
+            return make_ready_future<size_t>(0);
+        }
+        return get_blocks(pos, len, pc).then([this, pos, buffer, len] (std::vector<temporary_buffer<uint8_t>> blocks) {
+            return copy_out(pos, blocks, static_cast<char*>(buffer), len);
+        });
+    }
+    virtual future<size_t> read_dma(uint64_t pos, std::vector<iovec> iov, const io_priority_class& pc) override {
+        size_t len = 0;
+        for (auto&& v : iov) {
+            len += v.iov_len;
+        }
+        if (!len) {
+            return make_ready_future<size_t>(0);
+        }
+        return get_blocks(pos, len, pc).then([this, pos, iov = std::move(iov)] (std::vector<temporary_buffer<uint8_t>> blocks) {
+            size_t total = 0;
+            for (auto&& v : iov) {
+                auto n = copy_out(pos + total, blocks, static_cast<char*>(v.iov_base), v.iov_len);
+                total += n;
+                if (n < v.iov_len) {
+                    break;
+                }
+            }
+            return total;
+        });
+    }
+    virtual future<temporary_buffer<uint8_t>> dma_read_bulk(uint64_t offset, size_t range_size, const io_priority_class& pc) override {
+        if (!range_size) {
+            return make_ready_future<temporary_buffer<uint8_t>>();
+        }
+        return get_blocks(offset, range_size, pc).then([this, offset, range_size] (std::vector<temporary_buffer<uint8_t>> blocks) {
+            // Ranges within a single block are shared with the cache rather than copied
+            auto in_block = offset % block_size();
+            if (blocks.size() == 1) {
+                auto& b = blocks.front();
+                return in_block < b.size() ? b.share(in_block, std::min(range_size, b.size() - in_block)) : temporary_buffer<uint8_t>();
+            }
+            auto buf = temporary_buffer<uint8_t>::aligned(_memory_dma_alignment, range_size);
+            buf.trim(copy_out(offset, blocks, reinterpret_cast<char*>(buf.get_write()), range_size));
+            return buf;
+        });
+    }
+    virtual future<> flush(void) override {
+        return _file.flush();
+    }
+    virtual future<struct stat> stat(void) override {
+        return _file.stat();
+    }
+    virtual future<> truncate(uint64_t length) override {
+        return modify(length, all_blocks, [this, length] {
+            return _file.truncate(length);
+        });
+    }
+    virtual future<> discard(uint64_t offset, uint64_t length) override {
+        return modify(offset, length, [this, offset, length] {
+            return _file.discard(offset, length);
+        });
+    }
+    virtual future<> allocate(uint64_t position, uint64_t length) override {
+        return modify(position, length, [this, position, length] {
+            return _file.allocate(position, length);
+        });
+    }
+    virtual future<uint64_t> size(void) override {
+        return _file.size();
+    }
+    virtual future<> close() override {
+        _cache.invalidate(_id, _blocks, 0, all_blocks);
+        return _file.close();
+    }
+    virtual subscription<directory_entry> list_directory(std::function<future<> (directory_entry de)> next) override {
+        return _file.list_directory(std::move(next));
+    }
+};
+
+file make_cached_file(file f, block_cache& cache) {
+    return file(make_shared<cached_file_impl>(std::move(f), cache));
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#include "core/dma_buffer_arena.hh"
+#include <seastar/core/align.hh>
+#include <seastar/core/smp.hh>
+#include <seastar/core/reactor.hh>
+
+namespace seastar {
+
+namespace internal {
+
+dma_buffer_arena::dma_buffer_arena(size_t size, size_t chunk_size)
+    : _size(align_down(size, chunk_size))
+    , _chunk_size(chunk_size)
+    , _owner(this_shard_id())
+{
+    if (!_size) {
+        throw std::invalid_argument("dma buffer arena must hold at least one chunk");
+    }
+    // Chunks are page aligned, which satisfies any O_DIRECT memory alignment
+    auto area = static_cast<char*>(::aligned_alloc(4096, _size));
+    if (!area) {
+        throw std::bad_alloc();
+    }
+    _area.reset(area);
+    auto nr_chunks = _size / _chunk_size;
+    _free_chunks.reserve(nr_chunks);
+    for (unsigned i = nr_chunks; i-- > 0;) {
+        _free_chunks.push_back(i);
+    }
+}
+
+void dma_buffer_arena::free_chunk(unsigned idx) noexcept {
+    _free_chunks.push_back(idx);
+}
+
+temporary_buffer<uint8_t> dma_buffer_arena::allocate(size_t size, size_t alignment) noexcept {
+    if (size > _chunk_size || alignment > 4096 || _free_chunks.empty()) {
+        return temporary_buffer<uint8_t>();
+    }
+    auto idx = _free_chunks.back();
+    _free_chunks.pop_back();
+    auto p = reinterpret_cast<uint8_t*>(_area.get() + idx * _chunk_size);
+    try {
+        return temporary_buffer<uint8_t>(p, size, make_deleter([this, idx] {
+            if (this_shard_id() == _owner) {
+                free_chunk(idx);
+            } else {
+                // FIXME: future is discarded
+                (void)smp::submit_to(_owner, [this, idx] {
+                    free_chunk(idx);
+                });
+            }
+        }));
+    } catch (...) {
+        free_chunk(idx);
+        return temporary_buffer<uint8_t>();
+    }
+}
+
+}
+
+}
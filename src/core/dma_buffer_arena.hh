@@ -0,0 +1,88 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#pragma once
+
+#include <seastar/core/temporary_buffer.hh>
+#include <memory>
+#include <vector>
+
+namespace seastar {
+
+namespace internal {
+
+// A per-shard region of DMA-aligned memory, carved into fixed-size chunks,
+// that the reactor backend may register with the kernel once (io_uring
+// fixed buffers) so that disk I/O into it does not pin user pages again on
+// every request.
+//
+// Chunks must be released on the shard that owns the arena; buffers freed
+// elsewhere are sent back to it.
+class dma_buffer_arena {
+    struct free_deleter {
+        void operator()(char* p) const { ::free(p); }
+    };
+    std::unique_ptr<char[], free_deleter> _area;
+    size_t _size;
+    size_t _chunk_size;
+    unsigned _owner;
+    std::vector<unsigned> _free_chunks;
+    // Index of the arena among the buffers registered with the kernel,
+    // or -1 if the backend could not register it.
+    int _buf_index = -1;
+private:
+    void free_chunk(unsigned idx) noexcept;
+public:
+    dma_buffer_arena(size_t size, size_t chunk_size);
+    dma_buffer_arena(const dma_buffer_arena&) = delete;
+    void operator=(const dma_buffer_arena&) = delete;
+
+    char* base() const {
+        return _area.get();
+    }
+    size_t size() const {
+        return _size;
+    }
+    size_t chunk_size() const {
+        return _chunk_size;
+    }
+    size_t free_chunks() const {
+        return _free_chunks.size();
+    }
+    void set_buffer_index(int idx) {
+        _buf_index = idx;
+    }
+    // Registered buffer index covering [p, p + len), or -1.
+    int buffer_index(const void* p, size_t len) const {
+        auto c = reinterpret_cast<const char*>(p);
+        if (_buf_index < 0 || c < _area.get() || c + len > _area.get() + _size) {
+            return -1;
+        }
+        return _buf_index;
+    }
+    // Returns an empty buffer if the request does not fit in a chunk or the
+    // arena is exhausted; the caller then allocates from the general heap.
+    temporary_buffer<uint8_t> allocate(size_t size, size_t alignment) noexcept;
+};
+
+}
+
+}
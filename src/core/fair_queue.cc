@@ -23,6 +23,7 @@
 #include <seastar/core/future.hh>
 #include <seastar/core/shared_ptr.hh>
 #include <seastar/core/circular_buffer.hh>
+#include <seastar/core/bitops.hh>
 #include <seastar/util/noncopyable_function.hh>
 #include <queue>
 #include <chrono>
@@ -77,12 +78,60 @@ std::ostream& operator<<(std::ostream& os, fair_queue_ticket t) {
     return os << t._weight << ":" << t._size;
 }
 
+uint64_t fair_group::pack(int64_t weight, int64_t size) noexcept {
+    return (uint64_t(uint32_t(int32_t(weight))) << 32) | uint32_t(int32_t(size));
+}
+
+int32_t fair_group::weight(uint64_t packed) noexcept {
+    return int32_t(uint32_t(packed >> 32));
+}
+
+int32_t fair_group::size(uint64_t packed) noexcept {
+    return int32_t(uint32_t(packed));
+}
+
+fair_group::fair_group(fair_queue_ticket capacity) {
+    // Leave room for the queues to overdraw the pool by as much again.
+    constexpr uint32_t max_capacity = std::numeric_limits<int32_t>::max() / 2;
+    _available.store(pack(std::min(capacity._weight, max_capacity), std::min(capacity._size, max_capacity)), std::memory_order_relaxed);
+}
+
+bool fair_group::grab(fair_queue_ticket desc, bool force) noexcept {
+    auto cur = _available.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+        if (!force && (weight(cur) <= 0 || size(cur) <= 0)) {
+            return false;
+        }
+        next = pack(int64_t(weight(cur)) - desc._weight, int64_t(size(cur)) - desc._size);
+    } while (!_available.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+    return true;
+}
+
+void fair_group::release(fair_queue_ticket desc) noexcept {
+    auto cur = _available.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+        next = pack(int64_t(weight(cur)) + desc._weight, int64_t(size(cur)) + desc._size);
+    } while (!_available.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+}
+
+fair_queue_ticket fair_group::available() const noexcept {
+    auto cur = _available.load(std::memory_order_relaxed);
+    return fair_queue_ticket(std::max(weight(cur), 0), std::max(size(cur), 0));
+}
+
 fair_queue::fair_queue(config cfg)
     : _config(std::move(cfg))
     , _maximum_capacity(_config.max_req_count, _config.max_bytes_count)
     , _current_capacity(_config.max_req_count, _config.max_bytes_count)
+    , _group(_config.group)
     , _base(std::chrono::steady_clock::now())
-{}
+{
+    if (_config.latency_target.count()) {
+        _latency.min_samples = std::ceil(1 / std::max(1 - _config.latency_quantile, std::numeric_limits<float>::epsilon()));
+    }
+}
 
 void fair_queue::push_priority_class(priority_class_ptr pc) {
     if (!pc->_queued) {
@@ -114,7 +163,9 @@ void fair_queue::normalize_stats() {
 }
 
 bool fair_queue::can_dispatch() const {
-    return _resources_queued && (_resources_executing < _current_capacity);
+    // With a group, the pool may allow more than the capacity; that is
+    // decided per request in dispatch_requests().
+    return _resources_queued && (_group || _resources_executing < _current_capacity);
 }
 
 priority_class_ptr fair_queue::register_priority_class(uint32_t shares) {
@@ -144,6 +195,10 @@ fair_queue_ticket fair_queue::resources_currently_executing() const {
     return _resources_executing;
 }
 
+fair_queue_ticket fair_queue::current_capacity() const {
+    return _current_capacity;
+}
+
 void fair_queue::queue(priority_class_ptr pc, fair_queue_ticket desc, noncopyable_function<void()> func) {
     // We need to return a future in this function on which the caller can wait.
     // Since we don't know which queue we will use to execute the next request - if ours or
@@ -156,6 +211,65 @@ void fair_queue::queue(priority_class_ptr pc, fair_queue_ticket desc, noncopyabl
 
 void fair_queue::notify_requests_finished(fair_queue_ticket desc) {
     _resources_executing -= desc;
+    if (_group) {
+        _group->release(desc);
+    }
+}
+
+void fair_queue::notify_request_latency(fair_queue_ticket desc, latency_clock::duration latency) {
+    if (!_config.latency_target.count()) {
+        return;
+    }
+    auto& l = _latency;
+    auto size_class = desc._size ? std::min(log2floor(desc._size), nr_latency_size_classes - 1) : 0;
+    l.baseline[size_class] = std::min(l.baseline[size_class], latency);
+    auto baseline = std::min(l.baseline[size_class], l.prev_baseline[size_class]);
+    if (latency - baseline > _config.latency_target) {
+        l.late++;
+    }
+    l.samples++;
+    l.completed += desc;
+    if (l.samples >= l.min_samples) {
+        auto now = latency_clock::now();
+        if (now - l.window_start >= _config.latency_window) {
+            l.window_start = now;
+            adjust_capacity();
+        }
+    }
+}
+
+void fair_queue::adjust_capacity() {
+    auto& l = _latency;
+    auto avg = fair_queue_ticket(l.completed._weight / l.samples, l.completed._size / l.samples);
+    if (l.late > l.samples * (1 - _config.latency_quantile)) {
+        // The device is overcommitted. Back off from what was actually in
+        // flight rather than from the capacity, which may have been far from
+        // being used up, but always allow for at least an average request.
+        auto back_off = [] (uint32_t capacity, uint32_t peak, uint32_t floor) {
+            return std::max({std::min(capacity, peak) / 4 * 3, floor, 1u});
+        };
+        _current_capacity = fair_queue_ticket(back_off(_current_capacity._weight, l.peak_executing._weight, avg._weight),
+                back_off(_current_capacity._size, l.peak_executing._size, avg._size));
+    } else if (l.throttled) {
+        // Requests waited for capacity and the device kept up, probe for more.
+        auto grow = [] (uint32_t capacity, uint32_t step) {
+            uint64_t next = uint64_t(capacity) + std::max(step, capacity / 16);
+            return uint32_t(std::min<uint64_t>(next, std::numeric_limits<uint32_t>::max()));
+        };
+        _current_capacity = fair_queue_ticket(grow(_current_capacity._weight, avg._weight),
+                grow(_current_capacity._size, avg._size));
+    }
+
+    l.samples = 0;
+    l.late = 0;
+    l.completed = {};
+    l.peak_executing = _resources_executing;
+    l.throttled = false;
+    if (++l.windows == latency_baseline_windows) {
+        l.windows = 0;
+        l.prev_baseline = l.baseline;
+        l.baseline.fill(latency_clock::duration::max());
+    }
 }
 
 void fair_queue::dispatch_requests()
@@ -168,6 +282,11 @@ void fair_queue::dispatch_requests()
             h = pop_priority_class();
         } while (h->_queue.empty());
 
+        if (_group && !_group->grab(h->_queue.front().desc, _resources_executing < _current_capacity)) {
+            push_priority_class(h);
+            break;
+        }
+
         auto req = std::move(h->_queue.front());
         h->_queue.pop_front();
         _resources_executing += req.desc;;
@@ -198,6 +317,12 @@ void fair_queue::dispatch_requests()
 
         req.func();     // priority_class::request::func
     }
+
+    if (_config.latency_target.count()) {
+        _latency.peak_executing._weight = std::max(_latency.peak_executing._weight, _resources_executing._weight);
+        _latency.peak_executing._size = std::max(_latency.peak_executing._size, _resources_executing._size);
+        _latency.throttled |= bool(_resources_queued);
+    }
 }
 
 void fair_queue::update_shares(priority_class_ptr pc, uint32_t new_shares)
@@ -61,6 +61,8 @@ class posix_file_impl : public file_impl {
     dev_t _device_id;
     io_queue* _io_queue;
     open_flags _open_flags;
+    // Slot of _fd among the files registered with the kernel, or -1
+    int _fixed_fd = -1;
 public:
     int _fd;
     posix_file_impl(int fd, open_flags, file_open_options options, dev_t device_id);
@@ -86,6 +88,7 @@ class posix_file_impl : public file_impl {
     }
 private:
     void query_dma_alignment();
+    void unregister_fd() noexcept;
 
     /**
      * Try to read from the given position where the previous short read has
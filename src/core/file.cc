@@ -35,7 +35,9 @@
 #include <seastar/core/file.hh>
 #include <seastar/core/report_exception.hh>
 #include <seastar/core/linux-aio.hh>
+#include "core/dma_buffer_arena.hh"
 #include "core/file-impl.hh"
+#include "core/reactor_backend.hh"
 #include "core/syscall_result.hh"
 #include "core/thread_pool.hh"
 #include "core/uname.hh"
@@ -76,9 +78,13 @@ posix_file_impl::posix_file_impl(int fd, open_flags f, file_open_options options
         , _fd(fd)
 {
     query_dma_alignment();
+    if (options.register_fd) {
+        _fixed_fd = engine()._backend->register_file(_fd);
+    }
 }
 
 posix_file_impl::~posix_file_impl() {
+    unregister_fd();
     if (_refcount && _refcount->fetch_add(-1, std::memory_order_relaxed) != 1) {
         return;
     }
@@ -89,6 +95,14 @@ posix_file_impl::~posix_file_impl() {
     }
 }
 
+void
+posix_file_impl::unregister_fd() noexcept {
+    if (_fixed_fd != -1) {
+        engine()._backend->unregister_file(_fixed_fd);
+        _fixed_fd = -1;
+    }
+}
+
 void
 posix_file_impl::query_dma_alignment() {
     dioattr da;
@@ -193,6 +207,7 @@ posix_file_impl::close() noexcept {
         seastar_logger.warn("double close() detected, contact support");
         return make_ready_future<>();
     }
+    unregister_fd();
     auto fd = _fd;
     _fd = -1;  // Prevent a concurrent close (which is illegal) from closing another file's fd
     if (_refcount && _refcount->fetch_add(-1, std::memory_order_relaxed) != 1) {
@@ -320,6 +335,7 @@ posix_file_impl::list_directory(std::function<future<> (directory_entry de)> nex
 future<size_t>
 posix_file_impl::write_dma(uint64_t pos, const void* buffer, size_t len, const io_priority_class& io_priority_class) noexcept {
     auto req = internal::io_request::make_write(_fd, pos, buffer, len);
+    req.set_fixed_file(_fixed_fd);
     return engine().submit_io_write(_io_queue, io_priority_class, len, std::move(req));
 }
 
@@ -327,12 +343,14 @@ future<size_t>
 posix_file_impl::write_dma(uint64_t pos, std::vector<iovec> iov, const io_priority_class& io_priority_class) noexcept {
     auto len = internal::sanitize_iovecs(iov, _disk_write_dma_alignment);
     auto req = internal::io_request::make_writev(_fd, pos, iov);
+    req.set_fixed_file(_fixed_fd);
     return engine().submit_io_write(_io_queue, io_priority_class, len, std::move(req)).finally([iov = std::move(iov)] () {});
 }
 
 future<size_t>
 posix_file_impl::read_dma(uint64_t pos, void* buffer, size_t len, const io_priority_class& io_priority_class) noexcept {
     auto req = internal::io_request::make_read(_fd, pos, buffer, len);
+    req.set_fixed_file(_fixed_fd);
     return engine().submit_io_read(_io_queue, io_priority_class, len, std::move(req));
 }
 
@@ -340,6 +358,7 @@ future<size_t>
 posix_file_impl::read_dma(uint64_t pos, std::vector<iovec> iov, const io_priority_class& io_priority_class) noexcept {
     auto len = internal::sanitize_iovecs(iov, _disk_read_dma_alignment);
     auto req = internal::io_request::make_readv(_fd, pos, iov);
+    req.set_fixed_file(_fixed_fd);
     return engine().submit_io_read(_io_queue, io_priority_class, len, std::move(req)).finally([iov = std::move(iov)] () {});
 }
 
@@ -352,10 +371,18 @@ posix_file_impl::dma_read_bulk(uint64_t offset, size_t range_size, const io_prio
     offset -= front;
     range_size += front;
 
-    auto rstate = make_lw_shared<file::read_state<uint8_t>>(offset, front,
-                                                       range_size,
-                                                       _memory_dma_alignment,
-                                                       _disk_read_dma_alignment);
+    lw_shared_ptr<file::read_state<uint8_t>> rstate;
+    auto& arena = engine()._dma_buffer_arena;
+    auto buf = arena ? arena->allocate(align_up(range_size, size_t(_disk_read_dma_alignment)), _memory_dma_alignment)
+                     : tmp_buf_type();
+    if (buf) {
+        rstate = make_lw_shared<file::read_state<uint8_t>>(offset, front, range_size, std::move(buf));
+    } else {
+        rstate = make_lw_shared<file::read_state<uint8_t>>(offset, front,
+                                                           range_size,
+                                                           _memory_dma_alignment,
+                                                           _disk_read_dma_alignment);
+    }
 
     //
     // First, try to read directly into the buffer. Most of the reads will
@@ -29,14 +29,22 @@
 
 namespace seastar {
 
+static thread_local uint64_t read_ahead_memory_limit = 64 * 1024 * 1024;
+
+void set_file_input_stream_read_ahead_memory_limit(size_t limit) {
+    read_ahead_memory_limit = limit;
+}
+
 class file_data_source_impl : public data_source_impl {
     struct issued_read {
         uint64_t _pos;
         uint64_t _size;
         future<temporary_buffer<char>> _ready;
+        // Bytes accounted in fstream_read_ahead_memory for this read
+        uint64_t _memory;
 
-        issued_read(uint64_t pos, uint64_t size, future<temporary_buffer<char>> f)
-            : _pos(pos), _size(size), _ready(std::move(f)) { }
+        issued_read(uint64_t pos, uint64_t size, future<temporary_buffer<char>> f, uint64_t memory = 0)
+            : _pos(pos), _size(size), _ready(std::move(f)), _memory(memory) { }
     };
 
     reactor& _reactor = engine();
@@ -51,8 +59,25 @@ class file_data_source_impl : public data_source_impl {
     compat::optional<promise<>> _done;
     size_t _current_buffer_size;
     bool _in_slow_start = false;
+    // Bytes consumed since the buffer size was last changed, used by
+    // adaptive read-ahead to detect sequential scans.
+    uint64_t _sequential_bytes = 0;
     using unused_ratio_target = std::ratio<25, 100>;
 private:
+    bool read_ahead_memory_allows(uint64_t bytes) const {
+        return _reactor._io_stats.fstream_read_ahead_memory + bytes <= read_ahead_memory_limit;
+    }
+
+    void charge_memory(issued_read& r, uint64_t bytes) {
+        r._memory = bytes;
+        _reactor._io_stats.fstream_read_ahead_memory += bytes;
+    }
+
+    void release_memory(issued_read& r) {
+        _reactor._io_stats.fstream_read_ahead_memory -= r._memory;
+        r._memory = 0;
+    }
+
     size_t minimal_buffer_size() const {
         return std::min(std::max(_options.buffer_size / 4, size_t(8192)), _options.buffer_size);
     }
@@ -61,7 +86,11 @@ class file_data_source_impl : public data_source_impl {
         // Read-ahead can be increased up to user-specified limit if the
         // consumer has to wait for a buffer and we are not in a slow start
         // phase.
-        if (_current_read_ahead < _options.read_ahead && !_in_slow_start) {
+        auto max_read_ahead = _options.adaptive_read_ahead ? _options.max_read_ahead : _options.read_ahead;
+        if (_current_read_ahead < max_read_ahead && !_in_slow_start) {
+            if (_options.adaptive_read_ahead && !read_ahead_memory_allows(_current_buffer_size)) {
+                return;
+            }
             _current_read_ahead++;
             if (_options.dynamic_adjustments) {
                 auto& h = *_options.dynamic_adjustments;
@@ -70,6 +99,9 @@ class file_data_source_impl : public data_source_impl {
         }
     }
     unsigned get_initial_read_ahead() const {
+        if (_options.adaptive_read_ahead) {
+            return _options.read_ahead;
+        }
         return _options.dynamic_adjustments
                ? std::min(_options.dynamic_adjustments->read_ahead, _options.read_ahead)
                : !!_options.read_ahead;
@@ -142,6 +174,27 @@ class file_data_source_impl : public data_source_impl {
         _current_read_ahead = std::min(_current_read_ahead, 1u);
         _current_buffer_size = new_size;
     }
+    // Once a scan has consumed, without skipping, all the data the stream
+    // keeps in flight, double the buffer size.
+    void adapt_to_sequential(uint64_t consumed) {
+        _sequential_bytes += consumed;
+        if (_current_buffer_size >= _options.max_buffer_size
+                || _sequential_bytes < _current_buffer_size * (_current_read_ahead + 1)) {
+            return;
+        }
+        auto new_size = std::min(_current_buffer_size * 2, _options.max_buffer_size);
+        if (!read_ahead_memory_allows((new_size - _current_buffer_size) * (_current_read_ahead + 1))) {
+            return;
+        }
+        _current_buffer_size = new_size;
+        _sequential_bytes = 0;
+    }
+    void adapt_to_random() {
+        _current_buffer_size = _options.buffer_size;
+        _current_read_ahead = _options.read_ahead;
+        _sequential_bytes = 0;
+    }
+
     void update_history_unused(uint64_t bytes) {
         if (!_options.dynamic_adjustments) {
             return;
@@ -162,10 +215,20 @@ class file_data_source_impl : public data_source_impl {
     file_data_source_impl(file f, uint64_t offset, uint64_t len, file_input_stream_options options)
             : _file(std::move(f)), _options(options), _pos(offset), _remain(len), _current_read_ahead(get_initial_read_ahead())
             , _current_buffer_size(_options.buffer_size) {
+        if (_options.adaptive_read_ahead) {
+            _options.dynamic_adjustments = {};
+            _options.max_buffer_size = std::max(_options.max_buffer_size, _options.buffer_size);
+            _options.max_read_ahead = std::max(_options.max_read_ahead, _options.read_ahead);
+        }
         // prevent wraparounds
         set_new_buffer_size(after_skip::no);
         _remain = std::min(std::numeric_limits<uint64_t>::max() - _pos, _remain);
     }
+    virtual ~file_data_source_impl() {
+        for (auto&& r : _read_buffers) {
+            release_memory(r);
+        }
+    }
     virtual future<temporary_buffer<char>> get() override {
         if (!_read_buffers.empty() && !_read_buffers.front()._ready.available()) {
             try_increase_read_ahead();
@@ -173,6 +236,10 @@ class file_data_source_impl : public data_source_impl {
         issue_read_aheads(1);
         auto ret = std::move(_read_buffers.front());
         _read_buffers.pop_front();
+        release_memory(ret);
+        if (_options.adaptive_read_ahead) {
+            adapt_to_sequential(ret._size);
+        }
         update_history_consumed(ret._size);
         _reactor._io_stats.fstream_reads += 1;
         _reactor._io_stats.fstream_read_bytes += ret._size;
@@ -184,9 +251,11 @@ class file_data_source_impl : public data_source_impl {
     }
     virtual future<temporary_buffer<char>> skip(uint64_t n) override {
         uint64_t dropped = 0;
+        bool jumped = false;
         while (n) {
             if (_read_buffers.empty()) {
                 assert(n <= _remain);
+                jumped = true;
                 _pos += n;
                 _remain -= n;
                 break;
@@ -202,6 +271,7 @@ class file_data_source_impl : public data_source_impl {
                 break;
             } else {
                 ignore_read_future(std::move(front._ready));
+                release_memory(front);
                 n -= front._size;
                 dropped += front._size;
                 _reactor._io_stats.fstream_read_aheads_discarded += 1;
@@ -210,6 +280,9 @@ class file_data_source_impl : public data_source_impl {
             }
         }
         update_history_unused(dropped);
+        if (_options.adaptive_read_ahead && (dropped || jumped)) {
+            adapt_to_random();
+        }
         return make_ready_future<temporary_buffer<char>>();
     }
     virtual future<> close() override {
@@ -224,6 +297,7 @@ class file_data_source_impl : public data_source_impl {
                 _reactor._io_stats.fstream_read_ahead_discarded_bytes += c._size;
                 dropped += c._size;
                 ignore_read_future(std::move(c._ready));
+                release_memory(c);
             }
             update_history_unused(dropped);
             return std::move(_dropped_reads);
@@ -237,6 +311,9 @@ class file_data_source_impl : public data_source_impl {
         auto ra = _current_read_ahead + additional;
         _read_buffers.reserve(ra); // prevent push_back() failure
         while (_read_buffers.size() < ra) {
+            // The read the consumer waits for is always issued; in adaptive
+            // mode, read-aheads beyond it must fit in the memory limit.
+            auto read_ahead = _read_buffers.size() >= additional;
             if (!_remain) {
                 if (_read_buffers.size() >= additional) {
                     return;
@@ -244,13 +321,16 @@ class file_data_source_impl : public data_source_impl {
                 _read_buffers.emplace_back(_pos, 0, make_ready_future<temporary_buffer<char>>());
                 continue;
             }
-            ++_reads_in_progress;
             // if _pos is not dma-aligned, we'll get a short read.  Account for that.
             // Also avoid reading beyond _remain.
             uint64_t align = _file.disk_read_dma_alignment();
             auto start = align_down(_pos, align);
             auto end = std::min(align_up(start + _current_buffer_size, align), _pos + _remain);
             auto len = end - start;
+            if (_options.adaptive_read_ahead && read_ahead && !read_ahead_memory_allows(len)) {
+                return;
+            }
+            ++_reads_in_progress;
             auto actual_size = std::min(end - _pos, _remain);
             _read_buffers.emplace_back(_pos, actual_size, futurize_invoke([&] {
                     return _file.dma_read_bulk<char>(start, len, _options.io_priority_class);
@@ -279,6 +359,7 @@ class file_data_source_impl : public data_source_impl {
                     return make_ready_future<temporary_buffer<char>>(std::move(tmp));
                 }
             }));
+            charge_memory(_read_buffers.back(), len);
             _remain -= end - _pos;
             _pos = end;
         };
@@ -316,6 +397,10 @@ class file_data_sink_impl : public data_sink_impl {
     semaphore _write_behind_sem = { _options.write_behind };
     future<> _background_writes_done = make_ready_future<>();
     bool _failed = false;
+    // Adjacent buffers waiting for a write-behind slot, starting at _pending_pos
+    std::vector<temporary_buffer<char>> _pending;
+    uint64_t _pending_pos = 0;
+    size_t _pending_size = 0;
 public:
     file_data_sink_impl(file f, file_output_stream_options options)
             : _file(std::move(f)), _options(options) {
@@ -332,6 +417,9 @@ class file_data_sink_impl : public data_sink_impl {
         if (!_options.write_behind) {
             return do_put(pos, std::move(buf));
         }
+        if (_options.max_coalesced_write) {
+            return put_coalesced(pos, std::move(buf));
+        }
         // Write behind strategy:
         //
         // 1. Issue N writes in parallel, using a semaphore to limit to N
@@ -347,23 +435,129 @@ class file_data_sink_impl : public data_sink_impl {
             auto this_write_done = do_put(pos, std::move(buf)).finally([this] {
                 _write_behind_sem.signal();
             });
-            _background_writes_done = when_all(std::move(_background_writes_done), std::move(this_write_done))
-                    .then([this] (std::tuple<future<>, future<>> possible_errors) {
-                // merge the two errors, preferring the first
-                auto& e1 = std::get<0>(possible_errors);
-                auto& e2 = std::get<1>(possible_errors);
-                if (e1.failed()) {
-                    e2.ignore_ready_future();
-                    return std::move(e1);
+            add_background_write(std::move(this_write_done));
+            return make_ready_future<>();
+        });
+    }
+private:
+    void add_background_write(future<> this_write_done) {
+        _background_writes_done = when_all(std::move(_background_writes_done), std::move(this_write_done))
+                .then([this] (std::tuple<future<>, future<>> possible_errors) {
+            // merge the two errors, preferring the first
+            auto& e1 = std::get<0>(possible_errors);
+            auto& e2 = std::get<1>(possible_errors);
+            if (e1.failed()) {
+                e2.ignore_ready_future();
+                return std::move(e1);
+            } else {
+                if (e2.failed()) {
+                    _failed = true;
+                }
+                return std::move(e2);
+            }
+        });
+    }
+
+    // Coalescing write behind strategy:
+    //
+    // 1. Append the buffer to the pending ones, which are adjacent to it
+    // 2. If a write-behind slot is free, write all pending buffers at once
+    // 3. Otherwise leave them for the next write to complete, which writes
+    //    them out using its slot instead of releasing it
+    // 4. Only wait for a slot when the pending buffers are full
+    future<> put_coalesced(uint64_t pos, temporary_buffer<char> buf) {
+        if (_failed) {
+            return std::exchange(_background_writes_done, make_ready_future<>());
+        }
+        if (!_pending.empty() && (_pending_size + buf.size() > _options.max_coalesced_write || _pending.size() >= IOV_MAX)) {
+            return _write_behind_sem.wait().then([this, pos, buf = std::move(buf)] () mutable {
+                // A completing write may have taken the pending buffers meanwhile
+                if (_pending.empty()) {
+                    _write_behind_sem.signal();
                 } else {
-                    if (e2.failed()) {
-                        _failed = true;
-                    }
-                    return std::move(e2);
+                    write_pending();
                 }
+                return put_coalesced(pos, std::move(buf));
             });
+        }
+        if (_pending.empty()) {
+            _pending_pos = pos;
+        }
+        _pending_size += buf.size();
+        _pending.push_back(std::move(buf));
+        if (_write_behind_sem.try_wait()) {
+            write_pending();
+        }
+        return make_ready_future<>();
+    }
+
+    // Writes out the pending buffers, using a write-behind slot the caller holds.
+    void write_pending() {
+        auto bufs = std::exchange(_pending, {});
+        _pending_size = 0;
+        if (_failed) {
+            _write_behind_sem.signal();
+            return;
+        }
+        add_background_write(do_put(_pending_pos, std::move(bufs)).finally([this] {
+            if (!_pending.empty()) {
+                write_pending();
+            } else {
+                _write_behind_sem.signal();
+            }
+        }));
+    }
+
+    future<> do_put(uint64_t pos, std::vector<temporary_buffer<char>> bufs) noexcept {
+        if (bufs.size() == 1) {
+            return do_put(pos, std::move(bufs.front()));
+        }
+      try {
+        assert(!(pos & (_file.disk_write_dma_alignment() - 1)));
+        bool truncate = false;
+        auto& last = bufs.back();
+        if ((last.size() & (_file.disk_write_dma_alignment() - 1)) != 0) {
+            // Only the last buffer can be unaligned, see do_put() below.
+            auto tmp = allocate_buffer(align_up(last.size(), _file.disk_write_dma_alignment()));
+            ::memcpy(tmp.get_write(), last.get(), last.size());
+            ::memset(tmp.get_write() + last.size(), 0, tmp.size() - last.size());
+            last = std::move(tmp);
+            truncate = true;
+        }
+        std::vector<iovec> iov;
+        iov.reserve(bufs.size());
+        size_t total = 0;
+        for (auto&& b : bufs) {
+            iov.push_back(iovec{b.get_write(), b.size()});
+            total += b.size();
+        }
+        return _file.dma_write(pos, std::move(iov), _options.io_priority_class).then(
+                [this, pos, bufs = std::move(bufs), truncate, total] (size_t size) mutable {
+            // short write handling
+            if (size < total) {
+                auto written = size;
+                auto it = bufs.begin();
+                while (written >= it->size()) {
+                    written -= it->size();
+                    ++it;
+                }
+                it->trim_front(written);
+                bufs.erase(bufs.begin(), it);
+                return do_put(pos + size, std::move(bufs)).then([this, truncate] {
+                    if (truncate) {
+                        return _file.truncate(_pos);
+                    }
+                    return make_ready_future<>();
+                });
+            }
+            if (truncate) {
+                return _file.truncate(_pos);
+            }
             return make_ready_future<>();
         });
+      } catch (...) {
+          return make_exception_future<>(std::current_exception());
+      }
     }
 public:
     future<> do_put(uint64_t pos, temporary_buffer<char> buf) noexcept {
@@ -410,6 +604,16 @@ class file_data_sink_impl : public data_sink_impl {
       }
     }
     future<> wait() noexcept {
+        if (!_pending.empty()) {
+            return _write_behind_sem.wait().then([this] {
+                if (_pending.empty()) {
+                    _write_behind_sem.signal();
+                } else {
+                    write_pending();
+                }
+                return wait();
+            });
+        }
         // restore to pristine state; for flush() + close() sequence
         // (we allow either flush, or close, or both)
         return _write_behind_sem.wait(_options.write_behind).then([this] {
@@ -445,6 +649,23 @@ output_stream<char> make_file_output_stream(file f, file_output_stream_options o
     return output_stream<char>(make_file_data_sink(std::move(f), options), options.buffer_size, true);
 }
 
+future<> data_sink_impl::put_file(const file& f, uint64_t pos, uint64_t len) {
+    static constexpr uint64_t chunk_size = 128 * 1024;
+    return do_with(file(f), pos, len, [this] (file& f, uint64_t& pos, uint64_t& len) {
+        return do_until([&len] { return !len; }, [this, &f, &pos, &len] {
+            return f.dma_read_bulk<char>(pos, std::min(len, chunk_size)).then([this, &pos, &len] (temporary_buffer<char> buf) {
+                if (buf.empty()) {
+                    return make_exception_future<>(file::eof_error());
+                }
+                buf.trim(std::min<uint64_t>(buf.size(), len));
+                pos += buf.size();
+                len -= buf.size();
+                return put(std::move(buf));
+            });
+        });
+    });
+}
+
 /*
  * template initialization, definition in iostream-impl.hh
  */
@@ -43,6 +43,7 @@ class io_desc_read_write final : public kernel_completion {
     io_queue* _ioq_ptr;
     fair_queue_ticket _fq_ticket;
     promise<size_t> _pr;
+    std::chrono::steady_clock::time_point _dispatched;
 private:
     void notify_requests_finished() {
         _ioq_ptr->notify_requests_finished(_fq_ticket);
@@ -57,6 +58,10 @@ class io_desc_read_write final : public kernel_completion {
         return _fq_ticket;
     }
 
+    void set_dispatched(std::chrono::steady_clock::time_point now) {
+        _dispatched = now;
+    }
+
     void set_exception(std::exception_ptr eptr) {
         notify_requests_finished();
         _pr.set_exception(eptr);
@@ -66,6 +71,7 @@ class io_desc_read_write final : public kernel_completion {
     virtual void complete_with(ssize_t ret) override {
         try {
             engine().handle_io_result(ret);
+            _ioq_ptr->notify_request_latency(_fq_ticket, _dispatched);
             notify_requests_finished();
             _pr.set_value(ret);
             delete this;
@@ -85,6 +91,13 @@ io_queue::notify_requests_finished(fair_queue_ticket& desc) {
     _completed_accumulator += desc;
 }
 
+void
+io_queue::notify_request_latency(fair_queue_ticket desc, std::chrono::steady_clock::time_point dispatched) {
+    if (_config.latency_target.count()) {
+        _fq.notify_request_latency(desc, std::chrono::steady_clock::now() - dispatched);
+    }
+}
+
 void
 io_queue::process_completions() {
     _fq.notify_requests_finished(std::exchange(_completed_accumulator, {}));
@@ -94,6 +107,9 @@ fair_queue::config io_queue::make_fair_queue_config(config iocfg) {
     fair_queue::config cfg;
     cfg.max_req_count = iocfg.max_req_count;
     cfg.max_bytes_count = iocfg.max_bytes_count;
+    cfg.latency_target = iocfg.latency_target;
+    cfg.latency_quantile = iocfg.latency_quantile;
+    cfg.group = iocfg.group.get();
     return cfg;
 }
 
@@ -255,28 +271,38 @@ io_queue::queue_request(const io_priority_class& pc, size_t len, internal::io_re
         auto& pclass = find_or_create_class(pc, owner);
         pclass.nr_queued++;
         unsigned weight;
-        size_t size;
+        uint64_t size;
         if (req.is_write()) {
             weight = _config.disk_req_write_to_read_multiplier;
-            size = _config.disk_bytes_write_to_read_multiplier * len;
+            size = uint64_t(_config.disk_bytes_write_to_read_multiplier) * len;
         } else if (req.is_read()) {
             weight = io_queue::read_request_base_count;
-            size = io_queue::read_request_base_count * len;
+            size = uint64_t(io_queue::read_request_base_count) * len;
         } else {
             throw std::runtime_error(fmt::format("Unrecognized request passing through I/O queue {}", req.opname()));
         }
+        // Scaled sizes of very large requests don't fit the ticket; they
+        // saturate, which still makes them occupy the whole queue.
+        size = std::min<uint64_t>(size, std::numeric_limits<uint32_t>::max());
         auto desc = std::make_unique<io_desc_read_write>(this, weight, size);
         auto fq_ticket = desc->fq_ticket();
         auto fut = desc->get_future();
         // 注意: _fq 中保存着这里的 lambda 表达式, 并不是异步 req, 等到执行该 lambda 的时候才会把异步 req 保存到 _pending_io 中
-        _fq.queue(pclass.ptr, std::move(fq_ticket), [&pclass, start, req = std::move(req), desc = desc.release(), len, this] () mutable noexcept {
+        _fq.queue(pclass.ptr, std::move(fq_ticket), [&pclass, start, req = std::move(req), desc = desc.release(), len, owner, this] () mutable noexcept {
             _queued_requests--;
             _requests_executing++;
+            if (owner != this_shard_id()) {
+                // Registered buffers and files belong to the issuing shard's ring
+                req.set_fixed_buffer(-1);
+                req.set_fixed_file(-1);
+            }
             try {
                 pclass.nr_queued--;
                 pclass.ops++;
                 pclass.bytes += len;
-                pclass.queue_time = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start);
+                auto now = std::chrono::steady_clock::now();
+                pclass.queue_time = std::chrono::duration_cast<std::chrono::duration<double>>(now - start);
+                desc->set_dispatched(now);
                 engine().submit_io(desc, std::move(req));       // 将异步 req 保存到 _pendind_io 中, kernel_submit_work_pollfn 中会将 _pending_io 中的异步任务递交给内核
             } catch (...) {
                 desc->set_exception(std::current_exception());
@@ -0,0 +1,82 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#include <seastar/core/mapped_file.hh>
+#include <seastar/core/reactor.hh>
+#include <seastar/core/do_with.hh>
+#include "core/syscall_result.hh"
+#include "core/thread_pool.hh"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace seastar {
+
+namespace {
+
+struct mapping {
+    const char* op;
+    void* addr;
+    size_t size;
+};
+
+}
+
+future<mapped_file> map_file_read_only(sstring name) noexcept {
+  return do_with(std::move(name), [] (sstring& name) {
+    // Opening, mapping and faulting the pages in may all block on the disk.
+    return engine()._thread_pool->submit<syscall_result_extra<mapping>>([&name] {
+        int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return wrap_syscall(-1, mapping{"open failed", nullptr, 0});
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == -1) {
+            auto ret = wrap_syscall(-1, mapping{"fstat failed", nullptr, 0});
+            ::close(fd);
+            return ret;
+        }
+        size_t size = st.st_size;
+        if (!size) {
+            ::close(fd);
+            return wrap_syscall(0, mapping{nullptr, nullptr, 0});
+        }
+        auto addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        auto ret = wrap_syscall(addr == MAP_FAILED ? -1 : 0, mapping{"mmap failed", addr, size});
+        // The mapping holds its own reference to the file
+        ::close(fd);
+        return ret;
+    }).then([&name] (syscall_result_extra<mapping> sr) {
+        sr.throw_fs_exception_if_error(sr.extra.op, name);
+        auto m = sr.extra;
+        if (!m.size) {
+            return mapped_file();
+        }
+        auto p = static_cast<char*>(m.addr);
+        return mapped_file(temporary_buffer<char>(p, m.size, make_deleter([m] {
+            ::munmap(m.addr, m.size);
+        })));
+    });
+  });
+}
+
+}
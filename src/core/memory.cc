@@ -61,6 +61,8 @@
 #include <seastar/core/aligned_buffer.hh>
 #include <unordered_set>
 #include <iostream>
+#include <fstream>
+#include <random>
 
 namespace seastar {
 
@@ -128,6 +130,8 @@ namespace seastar {
 struct allocation_site {
     mutable size_t count = 0; // number of live objects allocated at backtrace.
     mutable size_t size = 0; // amount of bytes in live objects allocated at backtrace.
+    mutable size_t total_count = 0; // number of objects ever allocated at backtrace.
+    mutable size_t total_size = 0; // amount of bytes ever allocated at backtrace.
     mutable const allocation_site* next = nullptr;
     saved_backtrace backtrace;
 
@@ -162,7 +166,7 @@ namespace memory {
 seastar::logger seastar_memory_logger("seastar_memory");
 
 [[gnu::unused]]
-static allocation_site_ptr get_allocation_site();
+static allocation_site_ptr get_allocation_site(size_t size);
 
 static void on_allocation_failure(size_t size);
 
@@ -179,9 +183,20 @@ static std::atomic<bool> live_cpus[max_cpus];
 static thread_local uint64_t g_allocs;
 static thread_local uint64_t g_frees;
 static thread_local uint64_t g_cross_cpu_frees;
+static thread_local uint64_t g_cross_node_frees;
+static thread_local uint64_t g_cross_cpu_frees_to[max_cpus];
+static thread_local uint64_t g_cross_cpu_drains;
+static thread_local uint64_t g_cross_cpu_drained_objects;
+static thread_local uint64_t g_last_cross_cpu_drain;
+static thread_local uint64_t g_compactions;
+static thread_local uint64_t g_compacted_spans;
 static thread_local uint64_t g_reclaims;
 static thread_local uint64_t g_large_allocs;
 
+// Shard id + 1 of each cpu_pages instance, 0 if not known. Written once by
+// the owning thread at startup, read when reporting statistics.
+static unsigned cpu_shard_ids[max_cpus];
+
 using compat::optional;
 
 using allocate_system_memory_fn
@@ -242,7 +257,8 @@ struct free_object {
 };
 
 struct page {
-    bool free;
+    bool free : 1;
+    bool released : 1; // free span returned to the OS, valid for head only
     uint8_t offset_in_span;
     uint16_t nr_small_alloc;
     uint32_t span_size; // in pages, if we're the head or the tail
@@ -284,6 +300,23 @@ class page_list {
         span.link._prev = 0;
         _front = idx;
     }
+    template <typename Func>
+    void for_each(page* ary, Func&& func) {
+        for (auto idx = _front; idx; idx = ary[idx].link._next) {
+            func(ary[idx]);
+        }
+    }
+    void push_back(page* ary, page& span) {
+        auto idx = &span - ary;
+        if (_back) {
+            ary[_back].link._next = idx;
+        } else {
+            _front = idx;
+        }
+        span.link._prev = _back;
+        span.link._next = 0;
+        _back = idx;
+    }
     void pop_front(page* ary) {
         if (ary[_front].link._next) {
             ary[ary[_front].link._next].link._prev = 0;
@@ -308,20 +341,33 @@ class small_pool {
     unsigned _max_free;
     unsigned _pages_in_use = 0;
     page_list _span_list;
+    uint64_t _spans_allocated = 0;
+    uint64_t _spans_freed = 0;
+    uint64_t _allocs = 0;
+    uint64_t _frees = 0;
+    uint64_t _requested_bytes = 0;
     static constexpr unsigned idx_frac_bits = 2;
 public:
     explicit small_pool(unsigned object_size) noexcept;
     ~small_pool();
-    void* allocate();
+    void* allocate(unsigned size);
     void deallocate(void* object);
     unsigned object_size() const { return _object_size; }
+    unsigned pages_in_use() const { return _pages_in_use; }
+    uint64_t spans_allocated() const { return _spans_allocated; }
+    uint64_t spans_freed() const { return _spans_freed; }
+    uint64_t allocs() const { return _allocs; }
+    uint64_t frees() const { return _frees; }
+    uint64_t requested_bytes() const { return _requested_bytes; }
+    size_t free_count() const { return _free_count; }
     bool objects_page_aligned() const { return is_page_aligned(_object_size); }
     static constexpr unsigned size_to_idx(unsigned size);
     static constexpr unsigned idx_to_size(unsigned idx);
     allocation_site_ptr& alloc_site_holder(void* ptr);
+    unsigned compact();
 private:
     void add_more_objects();
-    void trim_free_list();
+    void trim_free_list(size_t goal);
     friend void on_allocation_failure(size_t);
 };
 
@@ -392,6 +438,16 @@ struct cross_cpu_free_item {
     cross_cpu_free_item* next;
 };
 
+// Objects freed on this cpu but owned by another one, waiting to be handed
+// over to the owner's xcpu_freelist as a single chain.
+struct cross_cpu_free_batch {
+    cross_cpu_free_item* head = nullptr;
+    cross_cpu_free_item* tail = nullptr;
+    unsigned count = 0;
+    // Listed in cpu_pages::pending_xcpu_batches
+    bool queued = false;
+};
+
 struct cpu_pages {
     uint32_t min_free_pages = 20000000 / page_size;
     char* memory;
@@ -401,12 +457,25 @@ struct cpu_pages {
     uint32_t current_min_free_pages = 0;
     size_t large_allocation_warning_threshold = std::numeric_limits<size_t>::max();
     unsigned cpu_id = -1U;
+    unsigned numa_node = 0;
     std::function<void (std::function<void ()>)> reclaim_hook;
     std::vector<reclaimer*> reclaimers;
     static constexpr unsigned nr_span_lists = 32;
     page_list free_spans[nr_span_lists];  // contains aligned spans with span_size == 2^idx
+    // Free spans of at least a huge page can be returned to the OS by compact().
+    static constexpr uint32_t huge_page_pages = huge_page_size / page_size;
+    uint32_t nr_free_huge_span_pages = 0;
+    uint32_t nr_released_pages = 0;
+    bool release_free_memory = true; // false if memory is not backed by anonymous pages
     small_pool_array small_pools;
     alignas(seastar::cache_line_size) std::atomic<cross_cpu_free_item*> xcpu_freelist;
+    // Only reactor threads batch their cross cpu frees, since only they
+    // are guaranteed to flush them regularly.
+    static constexpr unsigned cross_cpu_free_batch_size = 32;
+    bool batch_cross_cpu_frees = false;
+    unsigned nr_pending_xcpu_batches = 0;
+    std::array<unsigned, max_cpus> pending_xcpu_batches;
+    std::array<cross_cpu_free_batch, max_cpus> xcpu_batches;
     static std::atomic<unsigned> cpu_id_gen;
     static cpu_pages* all_cpus[max_cpus];
     union asu {
@@ -418,6 +487,11 @@ struct cpu_pages {
     } asu;
     allocation_site_ptr alloc_site_list_head = nullptr; // For easy traversal of asu.alloc_sites from scylla-gdb.py
     bool collect_backtrace = false;
+    // Sample one allocation per heapprof_sampling_interval bytes on average;
+    // record every allocation if zero.
+    size_t heapprof_sampling_interval = 0;
+    size_t heapprof_bytes_until_sample = 0;
+    std::minstd_rand heapprof_rng;
     char* mem() { return memory; }
 
     void link(page_list& list, page* span);
@@ -443,7 +517,12 @@ struct cpu_pages {
     bool try_cross_cpu_free(void* ptr);
     void shrink(void* ptr, size_t new_size);
     void free_cross_cpu(unsigned cpu_id, void* ptr);
+    void push_cross_cpu(unsigned cpu_id, cross_cpu_free_item* head, cross_cpu_free_item* tail);
+    void flush_cross_cpu_batch(unsigned cpu_id);
+    bool flush_cross_cpu_frees();
     bool drain_cross_cpu_freelist();
+    compaction_result compact();
+    size_t release_free_spans();
     size_t object_size(void* ptr);
     page* to_page(void* p) {
         return &pages[(reinterpret_cast<char*>(p) - mem()) / page_size];
@@ -525,11 +604,20 @@ unsigned index_of(unsigned pages) {
 void
 cpu_pages::unlink(page_list& list, page* span) {
     list.erase(pages, *span);
+    if (span->span_size >= huge_page_pages) {
+        nr_free_huge_span_pages -= span->span_size;
+    }
+    if (span->released) {
+        nr_released_pages -= span->span_size;
+    }
 }
 
 void
 cpu_pages::link(page_list& list, page* span) {
     list.push_front(pages, *span);
+    if (span->span_size >= huge_page_pages) {
+        nr_free_huge_span_pages += span->span_size;
+    }
 }
 
 void cpu_pages::free_span_no_merge(uint32_t span_start, uint32_t nr_pages) {
@@ -538,6 +626,7 @@ void cpu_pages::free_span_no_merge(uint32_t span_start, uint32_t nr_pages) {
     auto span = &pages[span_start];
     auto span_end = &pages[span_start + nr_pages - 1];
     span->free = span_end->free = true;
+    span->released = false;
     span->span_size = span_end->span_size = nr_pages;
     auto idx = index_of(nr_pages);
     link(free_spans[idx], span);
@@ -640,22 +729,30 @@ cpu_pages::allocate_large_and_trim(unsigned n_pages) {
     }
     auto span_size = span->span_size;
     auto span_idx = span - pages;
+    bool released = span->released;
     nr_free_pages -= span->span_size;
     while (span_size >= n_pages * 2) {
         span_size /= 2;
         auto other_span_idx = span_idx + span_size;
         free_span_no_merge(other_span_idx, span_size);
+        if (released) {
+            // Still not backed by memory, no need to release it again.
+            pages[other_span_idx].released = true;
+            nr_released_pages += span_size;
+        }
     }
     auto span_end = &pages[span_idx + span_size - 1];
     span->free = span_end->free = false;
     span->span_size = span_end->span_size = span_size;
     span->pool = nullptr;
 #ifdef SEASTAR_HEAPPROF
-    auto alloc_site = get_allocation_site();
+    auto alloc_site = get_allocation_site(span->span_size * page_size);
     span->alloc_site = alloc_site;
     if (alloc_site) {
         ++alloc_site->count;
         alloc_site->size += span->span_size * page_size;
+        ++alloc_site->total_count;
+        alloc_site->total_size += span->span_size * page_size;
     }
 #endif
     maybe_reclaim();
@@ -718,11 +815,28 @@ saved_backtrace get_backtrace() noexcept {
     return current_backtrace();
 }
 
+// Distance in bytes to the next sampled allocation. Drawing it from an
+// exponential distribution makes sampling a Poisson process over the bytes
+// allocated: an allocation of size s is sampled with probability
+// 1 - exp(-s / interval) regardless of what was allocated before it.
 static
-allocation_site_ptr get_allocation_site() {
+size_t next_heapprof_sample_distance() {
+    std::exponential_distribution<double> dist(1.0 / cpu_mem.heapprof_sampling_interval);
+    return std::max<size_t>(1, dist(cpu_mem.heapprof_rng));
+}
+
+static
+allocation_site_ptr get_allocation_site(size_t size) {
     if (!cpu_mem.is_initialized() || !cpu_mem.collect_backtrace) {
         return nullptr;
     }
+    if (cpu_mem.heapprof_sampling_interval) {
+        if (size < cpu_mem.heapprof_bytes_until_sample) {
+            cpu_mem.heapprof_bytes_until_sample -= size;
+            return nullptr;
+        }
+        cpu_mem.heapprof_bytes_until_sample = next_heapprof_sample_distance();
+    }
     disable_backtrace_temporarily dbt;
     allocation_site new_alloc_site;
     new_alloc_site.backtrace = get_backtrace();
@@ -737,6 +851,60 @@ allocation_site_ptr get_allocation_site() {
 
 #ifdef SEASTAR_HEAPPROF
 
+void set_heap_profiling_sampling_interval(size_t interval) {
+    cpu_mem.heapprof_sampling_interval = interval;
+    if (interval) {
+        cpu_mem.heapprof_rng.seed(std::chrono::steady_clock::now().time_since_epoch().count());
+        cpu_mem.heapprof_bytes_until_sample = next_heapprof_sample_distance();
+    }
+}
+
+size_t get_heap_profiling_sampling_interval() {
+    return cpu_mem.heapprof_sampling_interval;
+}
+
+void dump_heap_profile(std::ostream& os) {
+    disable_backtrace_temporarily dbt;
+    size_t count = 0, size = 0, total_count = 0, total_size = 0;
+    for (auto site = cpu_mem.alloc_site_list_head; site; site = site->next) {
+        count += site->count;
+        size += site->size;
+        total_count += site->total_count;
+        total_size += site->total_size;
+    }
+    // pprof treats a sampling interval of 0 as an unsampled profile.
+    os << format("heap profile: {}: {} [{}: {}] @ heap_v2/{}\n",
+            count, size, total_count, total_size, cpu_mem.heapprof_sampling_interval);
+    for (auto site = cpu_mem.alloc_site_list_head; site; site = site->next) {
+        os << format("{}: {} [{}: {}] @", site->count, site->size, site->total_count, site->total_size);
+        for (auto& f : site->backtrace.frames()) {
+            // Frames hold the call instruction, pprof expects return addresses.
+            os << format(" 0x{:x}", f.so->begin + f.addr + 1);
+        }
+        os << "\n";
+    }
+    os << "\nMAPPED_LIBRARIES:\n";
+    std::ifstream maps("/proc/self/maps");
+    os << maps.rdbuf();
+}
+
+#else
+
+void set_heap_profiling_sampling_interval(size_t interval) {
+    set_heap_profiling_enabled(true); // let it print the warning
+}
+
+size_t get_heap_profiling_sampling_interval() {
+    return 0;
+}
+
+void dump_heap_profile(std::ostream& os) {
+}
+
+#endif
+
+#ifdef SEASTAR_HEAPPROF
+
 allocation_site_ptr&
 small_pool::alloc_site_holder(void* ptr) {
     if (objects_page_aligned()) {
@@ -753,15 +921,17 @@ cpu_pages::allocate_small(unsigned size) {
     auto idx = small_pool::size_to_idx(size);
     auto& pool = small_pools[idx];
     assert(size <= pool.object_size());
-    auto ptr = pool.allocate();
+    auto ptr = pool.allocate(size);
 #ifdef SEASTAR_HEAPPROF
     if (!ptr) {
         return nullptr;
     }
-    allocation_site_ptr alloc_site = get_allocation_site();
+    allocation_site_ptr alloc_site = get_allocation_site(pool.object_size());
     if (alloc_site) {
         ++alloc_site->count;
         alloc_site->size += pool.object_size();
+        ++alloc_site->total_count;
+        alloc_site->total_size += pool.object_size();
     }
     new (&pool.alloc_site_holder(ptr)) allocation_site_ptr{alloc_site};
 #endif
@@ -797,19 +967,65 @@ size_t cpu_pages::object_size(void* ptr) {
     }
 }
 
-void cpu_pages::free_cross_cpu(unsigned cpu_id, void* ptr) {
+void cpu_pages::push_cross_cpu(unsigned cpu_id, cross_cpu_free_item* head, cross_cpu_free_item* tail) {
     if (!live_cpus[cpu_id].load(std::memory_order_relaxed)) {
         // Thread was destroyed; leak object
         // should only happen for boost unit-tests.
         return;
     }
-    auto p = reinterpret_cast<cross_cpu_free_item*>(ptr);
     auto& list = all_cpus[cpu_id]->xcpu_freelist;
     auto old = list.load(std::memory_order_relaxed);
     do {
-        p->next = old;
-    } while (!list.compare_exchange_weak(old, p, std::memory_order_release, std::memory_order_relaxed));
+        tail->next = old;
+    } while (!list.compare_exchange_weak(old, head, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void cpu_pages::flush_cross_cpu_batch(unsigned cpu_id) {
+    auto& batch = xcpu_batches[cpu_id];
+    push_cross_cpu(cpu_id, batch.head, batch.tail);
+    batch.head = batch.tail = nullptr;
+    batch.count = 0;
+}
+
+bool cpu_pages::flush_cross_cpu_frees() {
+    if (!nr_pending_xcpu_batches) {
+        return false;
+    }
+    for (unsigned i = 0; i < nr_pending_xcpu_batches; ++i) {
+        auto cpu = pending_xcpu_batches[i];
+        if (xcpu_batches[cpu].count) {
+            flush_cross_cpu_batch(cpu);
+        }
+        xcpu_batches[cpu].queued = false;
+    }
+    nr_pending_xcpu_batches = 0;
+    return true;
+}
+
+void cpu_pages::free_cross_cpu(unsigned cpu_id, void* ptr) {
+    auto p = reinterpret_cast<cross_cpu_free_item*>(ptr);
+    if (!batch_cross_cpu_frees) {
+        push_cross_cpu(cpu_id, p, p);
+    } else {
+        auto& batch = xcpu_batches[cpu_id];
+        p->next = batch.head;
+        batch.head = p;
+        if (!batch.count++) {
+            batch.tail = p;
+        }
+        if (!batch.queued) {
+            batch.queued = true;
+            pending_xcpu_batches[nr_pending_xcpu_batches++] = cpu_id;
+        }
+        if (batch.count >= cross_cpu_free_batch_size) {
+            flush_cross_cpu_batch(cpu_id);
+        }
+    }
     ++g_cross_cpu_frees;
+    ++g_cross_cpu_frees_to[cpu_id];
+    if (all_cpus[cpu_id]->numa_node != numa_node) {
+        ++g_cross_node_frees;
+    }
 }
 
 bool cpu_pages::drain_cross_cpu_freelist() {
@@ -817,15 +1033,59 @@ bool cpu_pages::drain_cross_cpu_freelist() {
         return false;
     }
     auto p = xcpu_freelist.exchange(nullptr, std::memory_order_acquire);
+    uint64_t nr = 0;
     while (p) {
         auto n = p->next;
         ++g_frees;
         free(p);
         p = n;
+        ++nr;
     }
+    ++g_cross_cpu_drains;
+    g_cross_cpu_drained_objects += nr;
+    g_last_cross_cpu_drain = nr;
     return true;
 }
 
+compaction_result cpu_pages::compact() {
+    drain_cross_cpu_freelist();
+    compaction_result ret{};
+    for (unsigned i = 0; i < small_pool_array::nr_small_pools; ++i) {
+        ret.spans_freed += small_pools[i].compact();
+    }
+    ret.released_memory = release_free_spans() * page_size;
+    ++g_compactions;
+    g_compacted_spans += ret.spans_freed;
+    return ret;
+}
+
+// Spans are aligned to their size, so every free span of at least
+// huge_page_pages pages covers whole huge pages.
+size_t cpu_pages::release_free_spans() {
+    if (!release_free_memory) {
+        return 0;
+    }
+    size_t released = 0;
+    for (auto idx = index_of(huge_page_pages); idx < nr_span_lists && release_free_memory; ++idx) {
+        free_spans[idx].for_each(pages, [&] (page& span) {
+            if (span.released || !release_free_memory) {
+                return;
+            }
+            auto r = ::madvise(mem() + (&span - pages) * page_size, span.span_size * page_size, MADV_DONTNEED);
+            if (r == -1) {
+                // Most likely locked memory; don't try again.
+                seastar_memory_logger.warn("Failed to release free memory: {}", strerror(errno));
+                release_free_memory = false;
+                return;
+            }
+            span.released = true;
+            nr_released_pages += span.span_size;
+            released += span.span_size;
+        });
+    }
+    return released;
+}
+
 void cpu_pages::free(void* ptr) {
     page* span = to_page(ptr);
     if (span->pool) {
@@ -904,6 +1164,7 @@ void cpu_pages::shrink(void* ptr, size_t new_size) {
 }
 
 cpu_pages::~cpu_pages() {
+    flush_cross_cpu_frees();
     live_cpus[cpu_id].store(false, std::memory_order_relaxed);
 }
 
@@ -1109,14 +1370,14 @@ small_pool::small_pool(unsigned object_size) noexcept
 
 small_pool::~small_pool() {
     _min_free = _max_free = 0;
-    trim_free_list();
+    trim_free_list(0);
 }
 
 // Should not throw in case of running out of memory to avoid infinite recursion,
 // becaue throwing std::bad_alloc requires allocation. __cxa_allocate_exception
 // falls back to the emergency pool in case malloc() returns nullptr.
 void*
-small_pool::allocate() {
+small_pool::allocate(unsigned size) {
     if (!_free) {
         add_more_objects();
     }
@@ -1126,6 +1387,8 @@ small_pool::allocate() {
     auto* obj = _free;
     _free = _free->next;
     --_free_count;
+    ++_allocs;
+    _requested_bytes += size;
     return obj;
 }
 
@@ -1135,8 +1398,9 @@ small_pool::deallocate(void* object) {
     o->next = _free;
     _free = o;
     ++_free_count;
+    ++_frees;
     if (_free_count >= _max_free) {
-        trim_free_list();
+        trim_free_list((_min_free + _max_free) / 2);
     }
 }
 
@@ -1169,6 +1433,7 @@ small_pool::add_more_objects() {
         auto span = cpu_mem.to_page(data);
         span_size = span->span_size;
         _pages_in_use += span_size;
+        ++_spans_allocated;
         for (unsigned i = 0; i < span_size; ++i) {
             span[i].offset_in_span = i;
             span[i].pool = this;
@@ -1186,8 +1451,7 @@ small_pool::add_more_objects() {
 }
 
 void
-small_pool::trim_free_list() {
-    auto goal = (_min_free + _max_free) / 2;
+small_pool::trim_free_list(size_t goal) {
     while (_free && _free_count > goal) {
         auto obj = _free;
         _free = _free->next;
@@ -1202,12 +1466,42 @@ small_pool::trim_free_list() {
         span->freelist = obj;
         if (--span->nr_small_alloc == 0) {
             _pages_in_use -= span->span_size;
+            ++_spans_freed;
             _span_list.erase(cpu_mem.pages, *span);
             cpu_mem.free_span(span - cpu_mem.pages, span->span_size);
         }
     }
 }
 
+// Returns all cached free objects to their spans, releasing the spans left
+// without live objects, and moves spans which are more than half empty to
+// the back of the span list so that add_more_objects() refills from the
+// fullest spans first and the sparse ones get a chance to drain.
+unsigned
+small_pool::compact() {
+    auto spans_freed = _spans_freed;
+    trim_free_list(0);
+    page_list sparse;
+    page_list dense;
+    while (!_span_list.empty()) {
+        page& span = _span_list.front(cpu_mem.pages);
+        _span_list.pop_front(cpu_mem.pages);
+        auto nr_objects = span.span_size * page_size / _object_size;
+        if (span.nr_small_alloc * 2 < nr_objects) {
+            sparse.push_back(cpu_mem.pages, span);
+        } else {
+            dense.push_back(cpu_mem.pages, span);
+        }
+    }
+    while (!sparse.empty()) {
+        page& span = sparse.front(cpu_mem.pages);
+        sparse.pop_front(cpu_mem.pages);
+        dense.push_back(cpu_mem.pages, span);
+    }
+    _span_list = dense;
+    return _spans_freed - spans_freed;
+}
+
 void
 abort_on_underflow(size_t size) {
     if (std::make_signed_t<size_t>(size) < 0) {
@@ -1382,8 +1676,15 @@ void configure(std::vector<resource::memory> m, bool mbind,
             return allocate_hugetlbfs_memory(*fdp, where, how_much);
         };
         cpu_mem.replace_memory_backing(sys_alloc);
+        // Dropping pages of a shared mapping does not return them to the OS.
+        cpu_mem.release_free_memory = false;
     }
     cpu_mem.resize(total, sys_alloc);       // 计算实际需要的虚拟内存大小，并通过调用 allocate_anonymous_memory 修改虚拟内存的读写状态
+    // For statistics, a shard belongs to the node backing most of its memory.
+    auto largest = std::max_element(m.begin(), m.end(), [] (const resource::memory& a, const resource::memory& b) {
+        return a.bytes < b.bytes;
+    });
+    cpu_mem.numa_node = largest != m.end() ? largest->nodeid : 0;
     size_t pos = 0;
     for (auto&& x : m) {
 #ifdef SEASTAR_HAVE_NUMA
@@ -1418,13 +1719,64 @@ void configure(std::vector<resource::memory> m, bool mbind,
 
 statistics stats() {
     return statistics{g_allocs, g_frees, g_cross_cpu_frees,
-        cpu_mem.nr_pages * page_size, cpu_mem.nr_free_pages * page_size, g_reclaims, g_large_allocs};
+        cpu_mem.nr_pages * page_size, cpu_mem.nr_free_pages * page_size, g_reclaims, g_large_allocs,
+        g_cross_node_frees, g_cross_cpu_drains, g_cross_cpu_drained_objects, g_last_cross_cpu_drain};
+}
+
+uint64_t cross_shard_frees(unsigned shard) {
+    uint64_t res = 0;
+    for (unsigned cpu = 0; cpu < max_cpus; ++cpu) {
+        if (cpu_shard_ids[cpu] == shard + 1) {
+            res += g_cross_cpu_frees_to[cpu];
+        }
+    }
+    return res;
+}
+
+unsigned size_classes() {
+    return small_pool_array::nr_small_pools;
+}
+
+size_class_statistics size_class_stats(unsigned idx) {
+    auto& pool = cpu_mem.small_pools[idx];
+    return size_class_statistics{pool.object_size(), pool.spans_allocated(), pool.spans_freed(), pool.pages_in_use(),
+        pool.allocs(), pool.frees(), pool.free_count(), pool.requested_bytes()};
+}
+
+compaction_result compact() {
+    return cpu_mem.compact();
+}
+
+fragmentation_statistics fragmentation_stats() {
+    return fragmentation_statistics{
+        size_t(cpu_mem.nr_free_pages - cpu_mem.nr_free_huge_span_pages) * page_size,
+        size_t(cpu_mem.nr_released_pages) * page_size,
+        g_compactions,
+        g_compacted_spans,
+    };
+}
+
+namespace internal {
+
+void set_shard_id(unsigned shard) {
+    if (cpu_mem.cpu_id < max_cpus) {
+        cpu_shard_ids[cpu_mem.cpu_id] = shard + 1;
+    }
+    // A shard's reactor polls flush_cross_cpu_frees(), so its frees
+    // can be batched from now on.
+    cpu_mem.batch_cross_cpu_frees = true;
+}
+
 }
 
 bool drain_cross_cpu_freelist() {
     return cpu_mem.drain_cross_cpu_freelist();
 }
 
+bool flush_cross_cpu_frees() {
+    return cpu_mem.flush_cross_cpu_frees();
+}
+
 memory_layout get_memory_layout() {
     return cpu_mem.memory_layout();
 }
@@ -1469,9 +1821,9 @@ void on_allocation_failure(size_t size) {
         seastar_memory_logger.debug("objsz spansz usedobj   memory       wst%");
         for (unsigned i = 0; i < cpu_mem.small_pools.nr_small_pools; i++) {
             auto& sp = cpu_mem.small_pools[i];
-            auto use_count = sp._pages_in_use * page_size / sp.object_size() - sp._free_count;
+            auto use_count = sp._allocs - sp._frees;
             auto memory = sp._pages_in_use * page_size;
-            auto wasted_percent = memory ? sp._free_count * sp.object_size() * 100.0 / memory : 0;
+            auto wasted_percent = memory ? (memory - use_count * sp.object_size()) * 100.0 / memory : 0;
             seastar_memory_logger.debug("{} {} {} {} {}", sp.object_size(), sp._span_sizes.preferred * page_size, use_count, memory, wasted_percent);
         }
         seastar_memory_logger.debug("Page spans:");
@@ -1895,6 +2247,17 @@ scoped_heap_profiling::scoped_heap_profiling() noexcept {
 scoped_heap_profiling::~scoped_heap_profiling() {
 }
 
+void set_heap_profiling_sampling_interval(size_t interval) {
+    set_heap_profiling_enabled(true); // let it print the warning
+}
+
+size_t get_heap_profiling_sampling_interval() {
+    return 0;
+}
+
+void dump_heap_profile(std::ostream& os) {
+}
+
 void enable_abort_on_allocation_failure() {
     seastar_logger.warn("Seastar compiled with default allocator, will not abort on bad_alloc");
 }
@@ -1915,13 +2278,44 @@ void configure(std::vector<resource::memory> m, bool mbind, compat::optional<std
 }
 
 statistics stats() {
-    return statistics{0, 0, 0, 1 << 30, 1 << 30, 0, 0};
+    return statistics{0, 0, 0, 1 << 30, 1 << 30, 0, 0, 0, 0, 0, 0};
+}
+
+uint64_t cross_shard_frees(unsigned shard) {
+    return 0;
+}
+
+unsigned size_classes() {
+    return 0;
+}
+
+size_class_statistics size_class_stats(unsigned idx) {
+    throw std::runtime_error("size_class_stats() not supported");
+}
+
+compaction_result compact() {
+    return compaction_result{0, 0};
+}
+
+fragmentation_statistics fragmentation_stats() {
+    return fragmentation_statistics{0, 0, 0, 0};
+}
+
+namespace internal {
+
+void set_shard_id(unsigned shard) {
+}
+
 }
 
 bool drain_cross_cpu_freelist() {
     return false;
 }
 
+bool flush_cross_cpu_frees() {
+    return false;
+}
+
 memory_layout get_memory_layout() {
     throw std::runtime_error("get_memory_layout() not supported");
 }
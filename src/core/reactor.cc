@@ -28,6 +28,7 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/inotify.h>
+#include <sys/sendfile.h>
 #include <seastar/core/task.hh>
 #include <seastar/core/reactor.hh>
 #include <seastar/core/memory.hh>
@@ -52,6 +53,7 @@
 #include <seastar/core/internal/buffer_allocator.hh>
 #include <seastar/core/scheduling_specific.hh>
 #include <seastar/util/log.hh>
+#include "core/dma_buffer_arena.hh"
 #include "core/file-impl.hh"
 #include "core/reactor_backend.hh"
 #include "core/syscall_result.hh"
@@ -107,6 +109,7 @@
 #include <sys/mman.h>
 #include <sys/utsname.h>
 #include <linux/falloc.h>
+#include <linux/errqueue.h>
 #include <linux/magic.h>
 #include <seastar/util/backtrace.hh>
 #include <seastar/util/spinlock.hh>
@@ -381,6 +384,191 @@ reactor::write_all(pollable_fd_state& fd, const void* buffer, size_t len) {
     return write_all_part(fd, buffer, len, 0);
 }
 
+future<uint64_t>
+reactor::sendfile(pollable_fd_state& fd, const file& in, uint64_t pos, uint64_t len) {
+    auto pf = dynamic_cast<posix_file_impl*>(in._file_impl.get());
+    if (!pf) {
+        // Not a kernel file (e.g. one wrapped by a cache)
+        return make_ready_future<uint64_t>(0);
+    }
+    // Linux transfers at most this much in one call
+    static constexpr uint64_t max_sendfile_size = 0x7ffff000;
+    return do_with(pos, len, false, [this, &fd, in_fd = pf->_fd, total = len] (uint64_t& pos, uint64_t& len, bool& unsupported) {
+        return do_until([&len, &unsupported] { return !len || unsupported; }, [this, &fd, in_fd, &pos, &len, &unsupported] {
+            return writeable(fd).then([this, &fd, in_fd, &pos, &len] {
+                // The socket does not block, but reading the file may have
+                // to wait for the disk, so the call goes to the syscall thread.
+                return _thread_pool->submit<syscall_result<ssize_t>>([out_fd = fd.fd.get(), in_fd, off = off_t(pos), count = std::min(len, max_sendfile_size)] () mutable {
+                    return wrap_syscall(::sendfile(out_fd, in_fd, &off, count));
+                });
+            }).then([&fd, &pos, &len, &unsupported] (syscall_result<ssize_t> sr) {
+                if (sr.result == -1 && (sr.error == EAGAIN || sr.error == EWOULDBLOCK)) {
+                    return;
+                }
+                // Before Linux 6.5, files opened with O_DIRECT can only be
+                // sent from aligned offsets.
+                if (sr.result == -1 && sr.error == EINVAL) {
+                    unsupported = true;
+                    return;
+                }
+                sr.throw_if_error();
+                if (!sr.result) {
+                    throw file::eof_error();
+                }
+                // See the comment about speculation in pollable_fd_state::sendmsg().
+                if (uint64_t(sr.result) == std::min(len, max_sendfile_size)) {
+                    fd.speculate_epoll(EPOLLOUT);
+                }
+                pos += sr.result;
+                len -= sr.result;
+            });
+        }).then([&len, total] {
+            return total - len;
+        });
+    });
+}
+
+// Packets sent with MSG_ZEROCOPY on one socket. Every successful sendmsg()
+// gets the next sequence number, and the kernel reports on the socket's error
+// queue, in ranges of sequence numbers, when it is done with their buffers.
+struct reactor::zero_copy_sends {
+    // Keeps the socket open, and its error queue readable, until all
+    // completions arrived.
+    pollable_fd_state_ptr fd;
+    uint32_t first_seq = 0;
+    // Sent packets in sequence order, starting with first_seq; completed
+    // ones are reset, and popped once they reach the front.
+    circular_buffer<net::packet> pending;
+
+    explicit zero_copy_sends(pollable_fd_state& fd) : fd(&fd) {}
+
+    void add(uint32_t seq, net::packet p) {
+        if (pending.empty()) {
+            first_seq = seq;
+        }
+        assert(seq == first_seq + pending.size());
+        pending.push_back(std::move(p));
+    }
+
+    void complete(uint32_t lo, uint32_t hi) {
+        for (uint32_t n = 0; n <= hi - lo; ++n) {
+            uint32_t i = lo + n - first_seq;
+            if (i < pending.size()) {
+                pending[i].reset();
+            }
+        }
+        while (!pending.empty() && !pending.front()) {
+            pending.pop_front();
+            ++first_seq;
+        }
+    }
+
+    bool reap() {
+        bool work = false;
+        for (;;) {
+            char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+            msghdr mh = {};
+            mh.msg_control = control;
+            mh.msg_controllen = sizeof(control);
+            if (::recvmsg(fd->fd.get(), &mh, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+                return work;
+            }
+            for (auto cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+                if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                        && !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                    continue;
+                }
+                auto ee = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+                if (ee->ee_errno || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                    continue;
+                }
+                complete(ee->ee_info, ee->ee_data);
+                work = true;
+            }
+        }
+    }
+};
+
+future<>
+reactor::send_zero_copy(pollable_fd_state& fd, net::packet p) {
+    return do_with(std::move(p), [this, &fd] (net::packet& p) {
+        return repeat([this, &fd, &p] {
+            return writeable(fd).then([this, &fd, &p] {
+                iovec* iov = reinterpret_cast<iovec*>(p.fragment_array());
+                msghdr mh = {};
+                mh.msg_iov = iov;
+                mh.msg_iovlen = std::min<size_t>(p.nr_frags(), IOV_MAX);
+                bool zero_copy = true;
+                auto r = ::sendmsg(fd.fd.get(), &mh, MSG_NOSIGNAL | MSG_ZEROCOPY);
+                if (r == -1 && errno == ENOBUFS) {
+                    // The socket is out of option memory (net.core.optmem_max)
+                    // to track more sends until their completions are reaped.
+                    zero_copy = false;
+                    r = ::sendmsg(fd.fd.get(), &mh, MSG_NOSIGNAL);
+                }
+                if (r == -1 && errno == EAGAIN) {
+                    return stop_iteration::no;
+                }
+                throw_system_error_on(r == -1, "sendmsg");
+                if (zero_copy) {
+                    auto& sends = _zero_copy_sends[&fd];
+                    if (!sends) {
+                        sends = std::make_unique<zero_copy_sends>(fd);
+                        // Only EPOLLERR, which the error queue raises, and
+                        // EPOLLHUP are reported; edge triggered, as reaping
+                        // doesn't clear a hangup.
+                        ::epoll_event evt = {};
+                        evt.events = EPOLLET;
+                        evt.data.ptr = &fd;
+                        throw_system_error_on(::epoll_ctl(_zero_copy_epoll->get_fd(), EPOLL_CTL_ADD, fd.fd.get(), &evt) == -1, "epoll_ctl");
+                    }
+                    auto seq = fd.zero_copy_seq++;
+                    if (size_t(r) == p.len()) {
+                        sends->add(seq, std::move(p));
+                    } else {
+                        // The kernel references the part that was sent until this call completes
+                        sends->add(seq, p.share(0, r));
+                    }
+                }
+                if (size_t(r) == p.len()) {
+                    fd.speculate_epoll(EPOLLOUT);
+                    return stop_iteration::yes;
+                }
+                p.trim_front(r);
+                return stop_iteration::no;
+            });
+        });
+    });
+}
+
+bool
+reactor::reap_zero_copy_completions() {
+    bool work = false;
+    std::array<::epoll_event, 128> events;
+    int nr;
+    do {
+        nr = ::epoll_wait(_zero_copy_epoll->get_fd(), events.data(), events.size(), 0);
+        for (int i = 0; i < nr; ++i) {
+            auto fd = static_cast<pollable_fd_state*>(events[i].data.ptr);
+            if (!fd) {
+                uint64_t garbage;
+                ::read(_zero_copy_wakeup->get(), &garbage, sizeof(garbage));
+                continue;
+            }
+            auto it = _zero_copy_sends.find(fd);
+            if (it == _zero_copy_sends.end()) {
+                continue;
+            }
+            work |= it->second->reap();
+            if (it->second->pending.empty()) {
+                ::epoll_ctl(_zero_copy_epoll->get_fd(), EPOLL_CTL_DEL, fd->fd.get(), nullptr);
+                _zero_copy_sends.erase(it);
+            }
+        }
+    } while (nr == int(events.size()));
+    return work;
+}
+
 future<size_t> pollable_fd_state::read_some(char* buffer, size_t size) {
     return engine()._backend->read_some(*this, buffer, size);
 }
@@ -485,6 +673,47 @@ future<size_t> pollable_fd_state::sendmsg(struct msghdr* msg) {
     });
 }
 
+future<size_t> pollable_fd_state::recvmmsg(struct mmsghdr* msgvec, size_t vlen) {
+    maybe_no_more_recv();
+    return engine().readable(*this).then([this, msgvec, vlen] {
+        auto r = fd.recvmmsg(msgvec, vlen, 0);
+        if (!r) {
+            return recvmmsg(msgvec, vlen);
+        }
+        // Unlike recvmsg(), we know whether the queue was drained: it was
+        // not if all slots were filled.
+        if (*r == vlen) {
+            speculate_epoll(EPOLLIN);
+        }
+        return make_ready_future<size_t>(*r);
+    });
+}
+
+future<size_t> pollable_fd_state::sendmmsg(struct mmsghdr* msgvec, size_t vlen) {
+    maybe_no_more_send();
+    return engine().writeable(*this).then([this, msgvec, vlen] () mutable {
+        auto r = fd.sendmmsg(msgvec, vlen, 0);
+        if (!r) {
+            return sendmmsg(msgvec, vlen);
+        }
+        // See the comment about speculation in sendmsg().
+        if (*r == vlen) {
+            speculate_epoll(EPOLLOUT);
+        }
+        return make_ready_future<size_t>(*r);
+    });
+}
+
+future<> pollable_fd_state::send_zero_copy(net::packet p) {
+    maybe_no_more_send();
+    return engine().send_zero_copy(*this, std::move(p));
+}
+
+future<uint64_t> pollable_fd_state::sendfile(const file& in, uint64_t pos, uint64_t len) {
+    maybe_no_more_send();
+    return engine().sendfile(*this, in, pos, len);
+}
+
 future<size_t> pollable_fd_state::sendto(socket_address addr, const void* buf, size_t len) {
     maybe_no_more_send();
     return engine().writeable(*this).then([this, buf, len, addr] () mutable {
@@ -1352,6 +1581,7 @@ void reactor::configure(boost::program_options::variables_map vm) {
     _force_io_getevents_syscall = vm["force-aio-syscalls"].as<bool>();
     aio_nowait_supported = vm["linux-aio-nowait"].as<bool>();
     _have_aio_fsync = vm["aio-fsync"].as<bool>();
+    _memory_compaction_period = vm["memory-compaction-period-ms"].as<unsigned>() * 1ms;
 }
 
 pollable_fd
@@ -1434,6 +1664,10 @@ pollable_fd::pollable_fd(file_desc fd, pollable_fd::speculation speculate)
     : _s(engine()._backend->make_pollable_fd_state(std::move(fd), speculate))
 {}
 
+future<> pollable_fd::send_zero_copy(net::packet p) {
+    return _s->send_zero_copy(std::move(p));
+}
+
 void pollable_fd::shutdown(int how) {
     engine()._backend->shutdown(*_s, how);
 }
@@ -1553,10 +1787,23 @@ const io_priority_class& default_priority_class() {
     return shard_default_class;
 }
 
+void
+reactor::register_dma_buffer_arena(size_t size, size_t chunk_size) {
+    if (_dma_buffer_arena) {
+        throw std::logic_error("DMA buffer arena already registered on this shard");
+    }
+    auto arena = std::make_unique<internal::dma_buffer_arena>(size, chunk_size);
+    arena->set_buffer_index(_backend->register_dma_buffers(arena->base(), arena->size()));
+    _dma_buffer_arena = std::move(arena);
+}
+
 future<size_t>
 reactor::submit_io_read(io_queue* ioq, const io_priority_class& pc, size_t len, io_request req) noexcept {
     ++_io_stats.aio_reads;
     _io_stats.aio_read_bytes += len;
+    if (_dma_buffer_arena && req.opcode() == io_request::operation::read) {
+        req.set_fixed_buffer(_dma_buffer_arena->buffer_index(req.address(), req.size()));
+    }
     return ioq->queue_request(pc, len, std::move(req));
 }
 
@@ -1564,6 +1811,9 @@ future<size_t>
 reactor::submit_io_write(io_queue* ioq, const io_priority_class& pc, size_t len, io_request req) noexcept {
     ++_io_stats.aio_writes;
     _io_stats.aio_write_bytes += len;
+    if (_dma_buffer_arena && req.opcode() == io_request::operation::write) {
+        req.set_fixed_buffer(_dma_buffer_arena->buffer_index(req.address(), req.size()));
+    }
     return ioq->queue_request(pc, len, std::move(req));
 }
 
@@ -2032,6 +2282,7 @@ future<> reactor::run_exit_tasks() {
     _stop_requested.broadcast();
     _stopping = true;
     stop_aio_eventfd_loop();
+    stop_zero_copy_loop();
     return do_for_each(_exit_funcs.rbegin(), _exit_funcs.rend(), [] (auto& func) {
         return func();
     });
@@ -2123,9 +2374,51 @@ void reactor::register_metrics() {
             sm::make_current_bytes("free_memory", [] { return memory::stats().free_memory(); }, sm::description("Free memeory size in bytes")),
             sm::make_current_bytes("total_memory", [] { return memory::stats().total_memory(); }, sm::description("Total memeory size in bytes")),
             sm::make_current_bytes("allocated_memory", [] { return memory::stats().allocated_memory(); }, sm::description("Allocated memeory size in bytes")),
-            sm::make_derive("reclaims_operations", [] { return memory::stats().reclaims(); }, sm::description("Total reclaims operations"))
+            sm::make_derive("reclaims_operations", [] { return memory::stats().reclaims(); }, sm::description("Total reclaims operations")),
+            sm::make_derive("cross_node_free_operations", [] { return memory::stats().cross_node_frees(); }, sm::description("Total number of frees of memory owned by a shard on a different NUMA node")),
+            sm::make_derive("cross_cpu_free_drains", [] { return memory::stats().cross_cpu_drains(); }, sm::description("Total number of times objects freed by other shards were returned to this shard")),
+            sm::make_derive("cross_cpu_free_drained_objects", [] { return memory::stats().cross_cpu_drained_objects(); }, sm::description("Total number of objects freed by other shards and returned to this shard")),
+            sm::make_gauge("cross_cpu_free_last_drain_batch", [] { return memory::stats().last_cross_cpu_drain(); }, sm::description("Number of objects returned to this shard by the last drain of its cross cpu free list")),
+            sm::make_current_bytes("fragmented_free_memory", [] { return memory::fragmentation_stats().fragmented_free_memory; }, sm::description("Free memory in spans smaller than a huge page, which cannot be returned to the OS")),
+            sm::make_current_bytes("released_memory", [] { return memory::fragmentation_stats().released_memory; }, sm::description("Free memory returned to the OS by memory compaction")),
+            sm::make_derive("compactions", [] { return memory::fragmentation_stats().compactions; }, sm::description("Total number of memory compaction passes")),
+            sm::make_derive("compacted_spans", [] { return memory::fragmentation_stats().compacted_spans; }, sm::description("Total number of small object spans returned to the page allocator by memory compaction")),
     });
 
+    auto dest_shard_label = sm::label("dest_shard");
+    for (unsigned shard = 0; shard < smp::count; ++shard) {
+        if (shard == _id) {
+            continue;
+        }
+        _metric_groups.add_group("memory", {
+                sm::make_derive("cross_shard_free_operations", [shard] { return memory::cross_shard_frees(shard); },
+                        sm::description("Total number of frees of memory owned by another shard"), {dest_shard_label(shard)}),
+        });
+    }
+
+    auto size_class_label = sm::label("object_size");
+    for (unsigned idx = 0; idx < memory::size_classes(); ++idx) {
+        auto object_size = memory::size_class_stats(idx).object_size;
+        _metric_groups.add_group("memory", {
+                sm::make_derive("small_pool_spans_allocated", [idx] { return memory::size_class_stats(idx).spans_allocated; },
+                        sm::description("Total number of spans taken from the page allocator by a small object size class"), {size_class_label(object_size)}),
+                sm::make_derive("small_pool_spans_freed", [idx] { return memory::size_class_stats(idx).spans_freed; },
+                        sm::description("Total number of spans returned to the page allocator by a small object size class"), {size_class_label(object_size)}),
+                sm::make_gauge("small_pool_pages_in_use", [idx] { return memory::size_class_stats(idx).pages_in_use; },
+                        sm::description("Number of pages held by a small object size class"), {size_class_label(object_size)}),
+                sm::make_derive("small_pool_allocs", [idx] { return memory::size_class_stats(idx).allocs; },
+                        sm::description("Total number of objects allocated from a small object size class"), {size_class_label(object_size)}),
+                sm::make_derive("small_pool_frees", [idx] { return memory::size_class_stats(idx).frees; },
+                        sm::description("Total number of objects freed to a small object size class"), {size_class_label(object_size)}),
+                sm::make_gauge("small_pool_live_objects", [idx] { return memory::size_class_stats(idx).live_objects(); },
+                        sm::description("Number of live objects of a small object size class"), {size_class_label(object_size)}),
+                sm::make_gauge("small_pool_free_list_length", [idx] { return memory::size_class_stats(idx).free_list_length; },
+                        sm::description("Number of free objects cached by a small object size class"), {size_class_label(object_size)}),
+                sm::make_derive("small_pool_rounding_loss_bytes", [idx] { return memory::size_class_stats(idx).rounding_loss(); },
+                        sm::description("Total number of bytes lost to rounding allocations up to the object size of a small object size class"), {size_class_label(object_size)}),
+        });
+    }
+
     _metric_groups.add_group("reactor", {
             sm::make_derive("logging_failures", [] { return logging_failures; }, sm::description("Total number of logging failures")),
             // total_operations value:DERIVE:0:U
@@ -2159,6 +2452,10 @@ void reactor::register_metrics() {
                 description(
                         "Counts the number of buffered bytes that were read ahead of time and were discarded because they were not needed, wasting disk bandwidth."
                         " Indicates over-eager read ahead configuration.")),
+        make_current_bytes("fstream_read_ahead_memory", _io_stats.fstream_read_ahead_memory,
+                description(
+                        "Holds the size of buffers which disk file streams have read, or are reading, but which were not consumed yet."
+                        " Adaptive read ahead stops growing when it reaches the configured limit.")),
     });
 }
 
@@ -2423,7 +2720,8 @@ class reactor::drain_cross_cpu_freelist_pollfn final : public reactor::pollfn
 public:
     virtual bool poll() final override
     {
-        return memory::drain_cross_cpu_freelist();
+        auto flushed = memory::flush_cross_cpu_frees();
+        return memory::drain_cross_cpu_freelist() || flushed;
     }
 
     virtual bool pure_poll() override final
@@ -2438,6 +2736,10 @@ class reactor::drain_cross_cpu_freelist_pollfn final : public reactor::pollfn
         // doesn't have any side effects.
         //
         // We'll take care of those items when we wake up for another reason.
+        //
+        // Our own batched frees must go out before we sleep though, or
+        // their owners won't see that memory until we wake up.
+        memory::flush_cross_cpu_frees();
         return true;
     }
 
@@ -2619,6 +2921,37 @@ void reactor::stop_aio_eventfd_loop() {
     ::write(_aio_eventfd->get_fd(), &one, 8);
 }
 
+// Zero-copy completions don't wake the reactor up by themselves. The error
+// queues of the sockets waiting for them are watched by an epoll instance
+// of their own, which becomes readable when any of them has completions,
+// so the reactor can sleep while they are outstanding.
+void reactor::start_zero_copy_loop() {
+    _zero_copy_epoll = pollable_fd(file_desc::epoll_create(EPOLL_CLOEXEC));
+    _zero_copy_wakeup = file_desc::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ::epoll_event evt = {};
+    evt.events = EPOLLIN;
+    evt.data.ptr = nullptr;
+    throw_system_error_on(::epoll_ctl(_zero_copy_epoll->get_fd(), EPOLL_CTL_ADD, _zero_copy_wakeup->get(), &evt) == -1, "epoll_ctl");
+    future<> loop_done = repeat([this] {
+        return _zero_copy_epoll->readable().then([this] {
+            reap_zero_copy_completions();
+            return _stopping ? stop_iteration::yes : stop_iteration::no;
+        });
+    });
+    // must use make_lw_shared, because at_exit expects a copyable function
+    at_exit([loop_done = make_lw_shared(std::move(loop_done))] {
+        return std::move(*loop_done);
+    });
+}
+
+void reactor::stop_zero_copy_loop() {
+    if (!_zero_copy_wakeup) {
+        return;
+    }
+    uint64_t one = 1;
+    ::write(_zero_copy_wakeup->get(), &one, 8);
+}
+
 inline
 bool
 reactor::have_more_tasks() const {
@@ -2787,6 +3120,7 @@ int reactor::run()
     poller execution_stage_poller(std::make_unique<execution_stage_pollfn>());
 
     start_aio_eventfd_loop();
+    start_zero_copy_loop();
 
     if (_id == 0 && _cfg.auto_handle_sigint_sigterm)
     {
@@ -2861,6 +3195,13 @@ int reactor::run()
 
     load_timer.arm_periodic(1s);
 
+    timer<lowres_clock> memory_compaction_timer([] {
+        memory::compact();
+    });
+    if (_memory_compaction_period.count()) {
+        memory_compaction_timer.arm_periodic(_memory_compaction_period);
+    }
+
     itimerspec its = seastar::posix::to_relative_itimerspec(_task_quota, _task_quota);
     _task_quota_timer.timerfd_settime(0, its);
     auto& task_quote_itimerspec = its;
@@ -2887,6 +3228,7 @@ int reactor::run()
         if (_stopped)
         {
             load_timer.cancel();
+            memory_compaction_timer.cancel();
             // Final tasks may include sending the last response to cpu 0, so run them
             while (have_more_tasks())
             {
@@ -3232,7 +3574,7 @@ void smp_message_queue::submit_item(shard_id t, smp_timeout_clock::time_point ti
     // no exceptions from this point
     item.release();
     units_fut.get0().release();
-    if (_tx.a.pending_fifo.size() >= batch_size) {
+    if (_tx.a.pending_fifo.size() >= _batch_size) {
         move_pending();
     }
     });
@@ -3240,7 +3582,7 @@ void smp_message_queue::submit_item(shard_id t, smp_timeout_clock::time_point ti
 
 void smp_message_queue::respond(work_item* item) {
     _completed_fifo.push_back(item);
-    if (_completed_fifo.size() >= batch_size || engine()._stopped) {
+    if (_completed_fifo.size() >= _batch_size || engine()._stopped) {
         flush_response_batch();
     }
 }
@@ -3316,12 +3658,25 @@ size_t smp_message_queue::process_queue(lf_queue& q, Func process) {
 }
 
 size_t smp_message_queue::process_completions(shard_id t) {
-    auto nr = process_queue<prefetch_cnt*2>(_completed, [t] (work_item* wi) {
+    // Return semaphore units once per run of completions belonging to the
+    // same service group rather than once per item; a batch usually comes
+    // from a single group.
+    unsigned last_ssg_id = 0;
+    size_t units = 0;
+    auto nr = process_queue<prefetch_cnt*2>(_completed, [t, &last_ssg_id, &units] (work_item* wi) {
         wi->complete();     // 异步任务已经完成，执行 set_value
         auto ssg_id = smp_service_group_id(wi->ssg);
-        get_smp_service_groups_semaphore(ssg_id, t).signal();
+        if (units && ssg_id != last_ssg_id) {
+            get_smp_service_groups_semaphore(last_ssg_id, t).signal(units);
+            units = 0;
+        }
+        last_ssg_id = ssg_id;
+        ++units;
         delete wi;
     });
+    if (units) {
+        get_smp_service_groups_semaphore(last_ssg_id, t).signal(units);
+    }
     _current_queue_length -= nr;
     _compl += nr;
     _last_cmpl_batch = nr;
@@ -3344,9 +3699,10 @@ size_t smp_message_queue::process_incoming() {
     return nr;
 }
 
-void smp_message_queue::start(unsigned cpuid)
+void smp_message_queue::start(unsigned cpuid, size_t batch_size)
 {
     _tx.init();
+    _batch_size = batch_size;
     namespace sm = seastar::metrics;
     char instance[10];
     std::snprintf(instance, sizeof(instance), "%u-%u", this_shard_id(), cpuid);
@@ -3357,6 +3713,7 @@ void smp_message_queue::start(unsigned cpuid)
             sm::make_queue_length("receive_batch_queue_length", _last_rcv_batch, sm::description("Current receive batch queue length"), {sm::shard_label(instance)})(sm::metric_disabled),
             sm::make_queue_length("complete_batch_queue_length", _last_cmpl_batch, sm::description("Current complete batch queue length"), {sm::shard_label(instance)})(sm::metric_disabled),
             sm::make_queue_length("send_queue_length", _current_queue_length, sm::description("Current send queue length"), {sm::shard_label(instance)})(sm::metric_disabled),
+            sm::make_gauge("batch_size", _batch_size, sm::description("Number of queued messages that triggers a publish to the other shard"), {sm::shard_label(instance)})(sm::metric_disabled),
             // total_operations value:DERIVE:0:U
             sm::make_derive("total_received_messages", _received, sm::description("Total number of received messages"), {sm::shard_label(instance)})(sm::metric_disabled),
             // total_operations value:DERIVE:0:U
@@ -3499,8 +3856,12 @@ reactor::get_options_description(reactor_config cfg) {
                 format("Internal reactor implementation ({})", reactor_backend_selector::available()).c_str())
         ("aio-fsync", bpo::value<bool>()->default_value(kernel_supports_aio_fsync()),
                 "Use Linux aio for fsync() calls. This reduces latency; requires Linux 4.18 or later.")
+        ("memory-compaction-period-ms", bpo::value<unsigned>()->default_value(0),
+                "Consolidate free memory and return free huge pages to the OS every this many milliseconds (0 to disable)")
 #ifdef SEASTAR_HEAPPROF
         ("heapprof", "enable seastar heap profiling")
+        ("heapprof-sampling-interval", bpo::value<size_t>()->default_value(0),
+                "sample one allocation per this many bytes on average when heap profiling, instead of recording every allocation (0)")
 #endif
         ;
     if (cfg.auto_handle_sigint_sigterm) {
@@ -3533,7 +3894,14 @@ smp::get_options_description()
 #endif
         ("io-properties-file", bpo::value<std::string>(), "path to a YAML file describing the characteristics of the I/O Subsystem")
         ("io-properties", bpo::value<std::string>(), "a YAML string describing the characteristics of the I/O Subsystem")
+        ("io-latency-target-us", bpo::value<unsigned>()->default_value(0),
+                "Adjust the I/O queues' in-flight capacity to keep disk latency, on top of the latency of an idle disk, within this target (0 to use the static capacity)")
+        ("io-latency-target-quantile", bpo::value<float>()->default_value(0.99),
+                "Quantile of the disk latencies which must stay within --io-latency-target-us")
+        ("io-shared-capacity", "Let the I/O queues of a disk use the capacity the other queues of the same disk leave unused, instead of a static slice each")
         ("mbind", bpo::value<bool>()->default_value(true), "enable mbind")
+        ("smp-local-batch-size", bpo::value<unsigned>(), "number of cross-shard messages batched before publishing to a shard on the same NUMA node (rounded up to a cache line of messages)")
+        ("smp-remote-batch-size", bpo::value<unsigned>(), "number of cross-shard messages batched before publishing to a shard on a different NUMA node (rounded up to a cache line of messages)")
 #ifndef SEASTAR_NO_EXCEPTION_HACK
         ("enable-glibc-exception-scaling-workaround", bpo::value<bool>()->default_value(true), "enable workaround for glibc/gcc c++ exception scalablity problem")
 #endif
@@ -3591,6 +3959,21 @@ std::unique_ptr<smp_message_queue*[], smp::qs_deleter> smp::_qs;
 std::thread::id smp::_tmain;        // 主线程的线程 id
 unsigned smp::count = 1;
 bool smp::_using_dpdk;
+std::vector<unsigned> smp::_shard_to_numa_node;
+size_t smp::_local_batch_size = 2 * smp_message_queue::items_per_cache_line;
+size_t smp::_remote_batch_size = 4 * smp_message_queue::items_per_cache_line;
+
+// Shards on the same NUMA node keep the batch of 16 pointers the queue has
+// always used, since handing cache lines over between them is cheap. Across
+// nodes every transfer of the ring indices crosses the interconnect and is
+// worth amortizing over a larger batch.
+size_t smp::message_batch_size(shard_id from, shard_id to)
+{
+    if (_shard_to_numa_node.empty() || _shard_to_numa_node[from] == _shard_to_numa_node[to]) {
+        return _local_batch_size;
+    }
+    return _remote_batch_size;
+}
 
 // 该接口会被每个 reactor 调用
 void smp::start_all_queues()
@@ -3599,7 +3982,7 @@ void smp::start_all_queues()
     {
         if (c != this_shard_id())
         {
-            _qs[c][this_shard_id()].start(c); // 这里不会启动 _qs[0][0] _qs[1][1] _qs[2][2] _qs[3][3], 因为不需要将一个任务从当前 reactor 递交给当前 reactor
+            _qs[c][this_shard_id()].start(c, message_batch_size(this_shard_id(), c)); // 这里不会启动 _qs[0][0] _qs[1][1] _qs[2][2] _qs[3][3], 因为不需要将一个任务从当前 reactor 递交给当前 reactor
         }
     }
 
@@ -3654,6 +4037,7 @@ void smp::allocate_reactor(unsigned id, reactor_backend_selector rbs, reactor_co
     assert(r == 0);
     local_engine = reinterpret_cast<reactor*>(buf);
     *internal::this_shard_id_ptr() = id;            // 保存当前线程所属的 cpu core id, 该变量是 thread_local
+    memory::internal::set_shard_id(id);
     new (buf) reactor(id, std::move(rbs), cfg);
     reactor_holder.reset(local_engine);     // 把 engine 的生命周期交给 reactor_holder 来管理
 }
@@ -3744,6 +4128,9 @@ class disk_config_params {
     compat::optional<unsigned> _capacity;
     std::unordered_map<dev_t, mountpoint_params> _mountpoints;
     std::chrono::duration<double> _latency_goal;
+    std::chrono::microseconds _latency_target{0};
+    float _latency_target_quantile = 0.99;
+    bool _shared_capacity = false;
 
 public:
     uint64_t per_io_queue(uint64_t qty, dev_t devid) const {
@@ -3760,6 +4147,10 @@ class disk_config_params {
         return _latency_goal;
     }
 
+    bool shared_capacity() const {
+        return _shared_capacity;
+    }
+
     void parse_config(boost::program_options::variables_map& configuration) {
         seastar_logger.debug("smp::count: {}", smp::count);
         _latency_goal = std::chrono::duration_cast<std::chrono::duration<double>>(configuration["task-quota-ms"].as<double>() * 1.5 * 1ms);
@@ -3769,6 +4160,13 @@ class disk_config_params {
             _capacity = configuration["max-io-requests"].as<unsigned>();
         }
 
+        _shared_capacity = configuration.count("io-shared-capacity");
+        _latency_target = std::chrono::microseconds(configuration["io-latency-target-us"].as<unsigned>());
+        _latency_target_quantile = configuration["io-latency-target-quantile"].as<float>();
+        if (_latency_target_quantile <= 0 || _latency_target_quantile >= 1) {
+            throw std::runtime_error("io-latency-target-quantile must be between 0 and 1");
+        }
+
         if (configuration.count("num-io-queues")) {
             _num_io_queues = configuration["num-io-queues"].as<unsigned>();
             if (!_num_io_queues) {
@@ -3851,24 +4249,42 @@ class disk_config_params {
         _mountpoints.emplace(0, d);
     }
 
+    static unsigned write_to_read_multiplier(uint64_t read_rate, uint64_t write_rate) {
+        auto m = (io_queue::read_request_base_count * read_rate + write_rate / 2) / write_rate;
+        return std::min<uint64_t>(std::max<uint64_t>(m, 1), std::numeric_limits<unsigned>::max());
+    }
+
+    // Both rates are needed to size the capacity and to weigh writes
+    // against it, a disk with only one of them configured is not limited.
+    static bool rates_configured(const mountpoint_params& p, uint64_t read_rate, uint64_t write_rate, const char* what) {
+        auto unset = std::numeric_limits<uint64_t>::max();
+        if ((read_rate == unset) != (write_rate == unset)) {
+            seastar_logger.warn("Mountpoint {}: {} {} rate is not configured, not limiting its {}",
+                    p.mountpoint, what, read_rate == unset ? "read" : "write", what);
+        }
+        return read_rate != unset && write_rate != unset;
+    }
+
     struct io_queue::config generate_config(dev_t devid) const {
         seastar_logger.debug("generate_config dev_id: {}", devid);
         const mountpoint_params& p = _mountpoints.at(devid);
         struct io_queue::config cfg;
-        uint64_t max_bandwidth = std::max(p.read_bytes_rate, p.write_bytes_rate);
-        uint64_t max_iops = std::max(p.read_req_rate, p.write_req_rate);
 
         cfg.disk_bytes_write_to_read_multiplier = io_queue::read_request_base_count;
         cfg.disk_req_write_to_read_multiplier = io_queue::read_request_base_count;
 
         if (!_capacity) {
-            if (max_bandwidth != std::numeric_limits<uint64_t>::max()) {
-                cfg.disk_bytes_write_to_read_multiplier = (io_queue::read_request_base_count * p.read_bytes_rate) / p.write_bytes_rate;
-                cfg.max_bytes_count = io_queue::read_request_base_count * per_io_queue(max_bandwidth * latency_goal().count(), devid);
+            // Capacities are expressed in read units: a read costs the base
+            // count and a write costs the base count scaled by how much slower
+            // the disk writes than it reads, so that running the disk at its
+            // full write rate consumes exactly the capacity of its read rate.
+            if (rates_configured(p, p.read_bytes_rate, p.write_bytes_rate, "bandwidth")) {
+                cfg.disk_bytes_write_to_read_multiplier = write_to_read_multiplier(p.read_bytes_rate, p.write_bytes_rate);
+                cfg.max_bytes_count = io_queue::read_request_base_count * per_io_queue(p.read_bytes_rate * latency_goal().count(), devid);
             }
-            if (max_iops != std::numeric_limits<uint64_t>::max()) {
-                cfg.max_req_count = io_queue::read_request_base_count * per_io_queue(max_iops * latency_goal().count(), devid);
-                cfg.disk_req_write_to_read_multiplier = (io_queue::read_request_base_count * p.read_req_rate) / p.write_req_rate;
+            if (rates_configured(p, p.read_req_rate, p.write_req_rate, "IOPS")) {
+                cfg.max_req_count = io_queue::read_request_base_count * per_io_queue(p.read_req_rate * latency_goal().count(), devid);
+                cfg.disk_req_write_to_read_multiplier = write_to_read_multiplier(p.read_req_rate, p.write_req_rate);
             }
             cfg.mountpoint = p.mountpoint;
         } else {
@@ -3879,6 +4295,8 @@ class disk_config_params {
             // specify size in terms of 16kB IOPS.
             cfg.max_bytes_count = io_queue::read_request_base_count * (cfg.max_req_count << 14);
         }
+        cfg.latency_target = _latency_target;
+        cfg.latency_quantile = _latency_target_quantile;
         return cfg;
     }
 
@@ -4087,6 +4505,21 @@ void smp::configure(boost::program_options::variables_map configuration, reactor
     // 后面会在这些内存中创建用于给内核递交异步任务的 io_queue
     auto resources = resource::allocate(rc);
     std::vector<resource::cpu> allocations = std::move(resources.cpus);
+
+    _shard_to_numa_node.clear();
+    for (auto&& a : allocations) {
+        _shard_to_numa_node.push_back(a.mem.empty() ? 0 : a.mem.front().nodeid);
+    }
+    auto message_batch_option = [&] (const char* name, size_t def) {
+        if (!configuration.count(name)) {
+            return def;
+        }
+        auto n = std::max<size_t>(configuration[name].as<unsigned>(), 1);
+        n = align_up(n, smp_message_queue::items_per_cache_line);
+        return std::min(n, smp_message_queue::queue_length);
+    };
+    _local_batch_size = message_batch_option("smp-local-batch-size", _local_batch_size);
+    _remote_batch_size = message_batch_option("smp-remote-batch-size", _remote_batch_size);
     if (thread_affinity)
     {
         smp::pin(allocations[0].cpu_id);        // 当前主线程绑定到 cpu core 0
@@ -4100,8 +4533,13 @@ void smp::configure(boost::program_options::variables_map configuration, reactor
     }
 
     bool heapprof_enabled = configuration.count("heapprof");
+    size_t heapprof_sampling_interval = 0;
+    if (configuration.count("heapprof-sampling-interval")) {
+        heapprof_sampling_interval = configuration["heapprof-sampling-interval"].as<size_t>();
+    }
     if (heapprof_enabled)
     {
+        memory::set_heap_profiling_sampling_interval(heapprof_sampling_interval);
         memory::set_heap_profiling_enabled(heapprof_enabled);
     }
 
@@ -4125,14 +4563,26 @@ void smp::configure(boost::program_options::variables_map configuration, reactor
 
     std::unordered_map<dev_t, std::vector<io_queue*>> all_io_queues; // dev_t: NUMA node index, std::vector<io_queue*>: 每个 NUMA node 上的每个 cpu core 对应着一个 io queue
 
+    std::unordered_map<dev_t, std::shared_ptr<fair_group>> io_groups;
+
     for (auto& id : disk_config.device_ids())
     {
         auto io_info = ioq_topology.at(id);
         all_io_queues.emplace(id, io_info.coordinators.size());
+        if (disk_config.shared_capacity()) {
+            // Each queue is configured with its slice of the disk; the
+            // group holds the whole disk.
+            auto cfg = disk_config.generate_config(id);
+            auto nr_queues = io_info.coordinators.size();
+            auto total = [nr_queues] (unsigned slice) {
+                return unsigned(std::min<uint64_t>(uint64_t(slice) * nr_queues, std::numeric_limits<unsigned>::max()));
+            };
+            io_groups.emplace(id, std::make_shared<fair_group>(fair_queue_ticket(total(cfg.max_req_count), total(cfg.max_bytes_count))));
+        }
     }
 
     // shard: cpu core index,       id: NUMA node index
-    auto alloc_io_queue = [&ioq_topology, &all_io_queues, &disk_config] (unsigned shard, dev_t id) {
+    auto alloc_io_queue = [&ioq_topology, &all_io_queues, &io_groups, &disk_config] (unsigned shard, dev_t id) {
         auto io_info = ioq_topology.at(id);
         auto cid = io_info.shard_to_coordinator[shard];
         auto vec_idx = io_info.coordinator_to_idx[cid];
@@ -4143,6 +4593,9 @@ void smp::configure(boost::program_options::variables_map configuration, reactor
             struct io_queue::config cfg = disk_config.generate_config(id);
             cfg.coordinator = cid;    // cid 是 cpu core id
             cfg.io_topology = io_info.shard_to_coordinator;
+            if (io_groups.count(id)) {
+                cfg.group = io_groups.at(id);
+            }
             assert(vec_idx < all_io_queues[id].size());
             assert(!all_io_queues[id][vec_idx]);
             all_io_queues[id][vec_idx] = new io_queue(std::move(cfg));
@@ -4173,7 +4626,7 @@ void smp::configure(boost::program_options::variables_map configuration, reactor
     for (i = 1; i < smp::count; i++)
     {
         auto allocation = allocations[i];
-        create_thread([configuration, &disk_config, hugepages_path, i, allocation, assign_io_queue, alloc_io_queue, thread_affinity, heapprof_enabled, mbind, backend_selector, reactor_cfg] {
+        create_thread([configuration, &disk_config, hugepages_path, i, allocation, assign_io_queue, alloc_io_queue, thread_affinity, heapprof_enabled, heapprof_sampling_interval, mbind, backend_selector, reactor_cfg] {
             try
             {
                 auto thread_name = seastar::format("reactor-{}", i);
@@ -4186,6 +4639,7 @@ void smp::configure(boost::program_options::variables_map configuration, reactor
                 memory::configure(allocation.mem, mbind, hugepages_path);
                 if (heapprof_enabled)
                 {
+                    memory::set_heap_profiling_sampling_interval(heapprof_sampling_interval);
                     memory::set_heap_profiling_enabled(heapprof_enabled);
                 }
 
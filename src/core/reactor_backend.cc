@@ -27,6 +27,8 @@
 #include <seastar/util/defer.hh>
 #include <seastar/util/read_first_line.hh>
 #include <chrono>
+#include <boost/intrusive/list.hpp>
+#include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/syscall.h>
 
@@ -854,6 +856,852 @@ void reactor_backend_epoll::reset_preemption_monitor() {
     _r->_preemption_monitor.head.store(0, std::memory_order_relaxed);
 }
 
+#ifdef SEASTAR_HAVE_URING
+
+static int io_uring_setup(unsigned entries, ::io_uring_params* p) {
+    return ::syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, const sigset_t* sig) {
+    return ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, sig, _NSIG / 8);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return ::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+template <typename T>
+static T* ring_ptr(const mmap_area& area, unsigned offset) {
+    return reinterpret_cast<T*>(area.get() + offset);
+}
+
+static mmap_area map_ring(int fd, size_t size, off_t offset) {
+    auto p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    throw_system_error_on(p == MAP_FAILED, "mmap(io_uring)");
+    return mmap_area(reinterpret_cast<char*>(p), mmap_deleter{size});
+}
+
+static file_desc setup_uring(unsigned entries, ::io_uring_params& params) {
+    auto fd = io_uring_setup(entries, &params);
+    throw_system_error_on(fd == -1, "io_uring_setup");
+    return file_desc::from_fd(fd);
+}
+
+uring_context::uring_context(unsigned entries)
+        : _fd(setup_uring(entries, _params)) {
+    auto sq_size = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+    auto cq_size = _params.cq_off.cqes + _params.cq_entries * sizeof(::io_uring_cqe);
+    if (_params.features & IORING_FEAT_SINGLE_MMAP) {
+        _sq_ring = map_ring(_fd.get(), std::max(sq_size, cq_size), IORING_OFF_SQ_RING);
+    } else {
+        _sq_ring = map_ring(_fd.get(), sq_size, IORING_OFF_SQ_RING);
+        _cq_ring = map_ring(_fd.get(), cq_size, IORING_OFF_CQ_RING);
+    }
+    auto& cq_ring = _cq_ring ? _cq_ring : _sq_ring;
+    _sqes_area = map_ring(_fd.get(), _params.sq_entries * sizeof(::io_uring_sqe), IORING_OFF_SQES);
+
+    _sq_head = ring_ptr<unsigned>(_sq_ring, _params.sq_off.head);
+    _sq_tail = ring_ptr<unsigned>(_sq_ring, _params.sq_off.tail);
+    _sq_mask = ring_ptr<unsigned>(_sq_ring, _params.sq_off.ring_mask);
+    _sq_flags = ring_ptr<unsigned>(_sq_ring, _params.sq_off.flags);
+    _sq_array = ring_ptr<unsigned>(_sq_ring, _params.sq_off.array);
+    _sqes = ring_ptr<::io_uring_sqe>(_sqes_area, 0);
+    _sq_local_tail = *_sq_tail;
+
+    _cq_head = ring_ptr<unsigned>(cq_ring, _params.cq_off.head);
+    _cq_tail = ring_ptr<unsigned>(cq_ring, _params.cq_off.tail);
+    _cq_mask = ring_ptr<unsigned>(cq_ring, _params.cq_off.ring_mask);
+    _cqes = ring_ptr<::io_uring_cqe>(cq_ring, _params.cq_off.cqes);
+}
+
+::io_uring_sqe* uring_context::get_sqe() {
+    auto head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    if (_sq_local_tail - head >= _params.sq_entries) {
+        return nullptr;
+    }
+    auto idx = _sq_local_tail++ & *_sq_mask;
+    _sq_array[idx] = idx;
+    auto sqe = &_sqes[idx];
+    *sqe = {};
+    return sqe;
+}
+
+unsigned uring_context::pending_submissions() const {
+    return _sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+}
+
+int uring_context::submit_and_wait(unsigned wait_nr, const sigset_t* active_sigmask) {
+    __atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+    auto to_submit = pending_submissions();
+    unsigned flags = 0;
+    if (wait_nr || (__atomic_load_n(_sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    if (!to_submit && !flags) {
+        return 0;
+    }
+    return io_uring_enter(_fd.get(), to_submit, wait_nr, flags, active_sigmask);
+}
+
+template <typename Func>
+unsigned uring_context::for_each_completion(Func&& func) {
+    auto head = *_cq_head;
+    auto tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+    unsigned nr = 0;
+    while (head != tail) {
+        // Copy the cqe out and release its slot before running the
+        // completion, which may want to queue more work.
+        auto cqe = _cqes[head++ & *_cq_mask];
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        func(cqe);
+        ++nr;
+    }
+    return nr;
+}
+
+static void prepare_sqe(const io_request& req, ::io_uring_sqe& sqe) {
+    sqe.fd = req.fd();
+    switch (req.opcode()) {
+    case io_request::operation::fdatasync:
+        sqe.opcode = IORING_OP_FSYNC;
+        sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+        break;
+    case io_request::operation::write:
+        sqe.opcode = IORING_OP_WRITE;
+        sqe.off = req.pos();
+        sqe.addr = reinterpret_cast<uintptr_t>(req.address());
+        sqe.len = req.size();
+        break;
+    case io_request::operation::writev:
+        sqe.opcode = IORING_OP_WRITEV;
+        sqe.off = req.pos();
+        sqe.addr = reinterpret_cast<uintptr_t>(req.iov());
+        sqe.len = req.iov_len();
+        break;
+    case io_request::operation::read:
+        sqe.opcode = IORING_OP_READ;
+        sqe.off = req.pos();
+        sqe.addr = reinterpret_cast<uintptr_t>(req.address());
+        sqe.len = req.size();
+        break;
+    case io_request::operation::readv:
+        sqe.opcode = IORING_OP_READV;
+        sqe.off = req.pos();
+        sqe.addr = reinterpret_cast<uintptr_t>(req.iov());
+        sqe.len = req.iov_len();
+        break;
+    case io_request::operation::recv:
+        sqe.opcode = IORING_OP_RECV;
+        sqe.addr = reinterpret_cast<uintptr_t>(req.address());
+        sqe.len = req.size();
+        sqe.msg_flags = req.flags();
+        break;
+    case io_request::operation::recvmsg:
+        sqe.opcode = IORING_OP_RECVMSG;
+        sqe.addr = reinterpret_cast<uintptr_t>(req.msghdr());
+        sqe.len = 1;
+        sqe.msg_flags = req.flags();
+        break;
+    case io_request::operation::send:
+        sqe.opcode = IORING_OP_SEND;
+        sqe.addr = reinterpret_cast<uintptr_t>(req.address());
+        sqe.len = req.size();
+        sqe.msg_flags = req.flags();
+        break;
+    case io_request::operation::sendmsg:
+        sqe.opcode = IORING_OP_SENDMSG;
+        sqe.addr = reinterpret_cast<uintptr_t>(req.msghdr());
+        sqe.len = 1;
+        sqe.msg_flags = req.flags();
+        break;
+    case io_request::operation::accept:
+        sqe.opcode = IORING_OP_ACCEPT;
+        sqe.addr = reinterpret_cast<uintptr_t>(req.posix_sockaddr());
+        sqe.addr2 = reinterpret_cast<uintptr_t>(req.socklen_ptr());
+        sqe.accept_flags = req.flags();
+        break;
+    case io_request::operation::connect:
+        sqe.opcode = IORING_OP_CONNECT;
+        sqe.addr = reinterpret_cast<uintptr_t>(req.posix_sockaddr());
+        sqe.off = req.socklen();
+        break;
+    case io_request::operation::poll_add:
+        sqe.opcode = IORING_OP_POLL_ADD;
+        sqe.poll_events = req.events();
+        break;
+    case io_request::operation::poll_remove:
+        sqe.opcode = IORING_OP_POLL_REMOVE;
+        sqe.fd = -1;
+        sqe.addr = reinterpret_cast<uintptr_t>(req.address());
+        break;
+    case io_request::operation::cancel:
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.fd = -1;
+        sqe.addr = reinterpret_cast<uintptr_t>(req.address());
+        break;
+    }
+    if (req.fixed_buffer() >= 0) {
+        if (sqe.opcode == IORING_OP_READ) {
+            sqe.opcode = IORING_OP_READ_FIXED;
+            sqe.buf_index = req.fixed_buffer();
+        } else if (sqe.opcode == IORING_OP_WRITE) {
+            sqe.opcode = IORING_OP_WRITE_FIXED;
+            sqe.buf_index = req.fixed_buffer();
+        }
+    }
+    if (req.fixed_file() >= 0) {
+        sqe.fd = req.fixed_file();
+        sqe.flags |= IOSQE_FIXED_FILE;
+    }
+    sqe.user_data = reinterpret_cast<uintptr_t>(req.get_kernel_completion());
+}
+
+class uring_pollable_fd_state;
+
+// Completion for a single socket operation. It owns whatever the kernel
+// accesses besides the data buffers (msghdr, iovecs, peer address), so it
+// is kept alive by the continuation waiting for the result. It also keeps
+// the fd state alive until then, so that the continuation can see whether
+// the fd was forgotten while the operation was in flight.
+class uring_socket_completion final : public kernel_completion {
+    promise<ssize_t> _pr;
+    uring_pollable_fd_state* _owner;
+    bool _completed = false;
+public:
+    boost::intrusive::list_member_hook<> hook;
+    ::msghdr msg = {};
+    std::vector<iovec> iov;
+    socket_address peer;
+    socklen_t peer_len = sizeof(peer.u);
+
+    explicit uring_socket_completion(pollable_fd_state& fd);
+    uring_socket_completion(const uring_socket_completion&) = delete;
+    void operator=(const uring_socket_completion&) = delete;
+    ~uring_socket_completion();
+    virtual void complete_with(ssize_t res) override {
+        _completed = true;
+        _pr.set_value(res);
+    }
+    future<ssize_t> get_future() {
+        return _pr.get_future();
+    }
+    // Whether the kernel is done with the operation
+    bool completed() const {
+        return _completed;
+    }
+    // Whether the fd was forgotten meanwhile, in which case the result is
+    // dropped and the fd must not be touched.
+    bool fd_forgotten() const;
+};
+
+// A POLLIN poll on a long-lived eventfd or timerfd, re-armed whenever the
+// backend wants to be woken up by it.
+class reactor_backend_uring::fd_poll_completion final : public fd_kernel_completion {
+    noncopyable_function<void ()> _on_event;
+    bool _armed = false;
+public:
+    fd_poll_completion(reactor* r, file_desc& fd, noncopyable_function<void ()> on_event)
+        : fd_kernel_completion(r, fd), _on_event(std::move(on_event)) {}
+    virtual void complete_with(ssize_t res) override {
+        _armed = false;
+        uint64_t v = 0;
+        (void)_fd.read(&v, 8);
+        if (v) {
+            _on_event();
+        }
+    }
+    bool armed() const {
+        return _armed;
+    }
+    void set_armed() {
+        _armed = true;
+    }
+};
+
+class uring_pollable_fd_state : public pollable_fd_state {
+public:
+    class poll_completion final : public kernel_completion {
+        uring_pollable_fd_state* _owner = nullptr;
+        promise<> _pr;
+        bool _armed = false;
+    public:
+        void init(uring_pollable_fd_state* owner) {
+            _owner = owner;
+        }
+        virtual void complete_with(ssize_t res) override {
+            _armed = false;
+            _pr.set_value();
+            _owner->maybe_dispose();
+        }
+        future<> arm() {
+            _armed = true;
+            _pr = promise<>();
+            return _pr.get_future();
+        }
+        bool armed() const {
+            return _armed;
+        }
+    };
+    using socket_completion_list = boost::intrusive::list<uring_socket_completion,
+            boost::intrusive::member_hook<uring_socket_completion, boost::intrusive::list_member_hook<>, &uring_socket_completion::hook>,
+            boost::intrusive::constant_time_size<false>>;
+private:
+    poll_completion _pollin;
+    poll_completion _pollout;
+    socket_completion_list _socket_requests;
+    bool _forgotten = false;
+public:
+    explicit uring_pollable_fd_state(file_desc fd, speculation speculate)
+        : pollable_fd_state(std::move(fd), std::move(speculate)) {
+        _pollin.init(this);
+        _pollout.init(this);
+    }
+    poll_completion& get_desc(int events) {
+        if (events & POLLIN) {
+            return _pollin;
+        }
+        return _pollout;
+    }
+    socket_completion_list& socket_requests() {
+        return _socket_requests;
+    }
+    // A poll sqe references its completion, and a socket operation's
+    // continuation references the state, so after forget() the state is
+    // kept around until the kernel returns every outstanding poll and every
+    // socket operation's continuation has run.
+    void maybe_dispose() {
+        if (_forgotten && !_pollin.armed() && !_pollout.armed() && _socket_requests.empty()) {
+            delete this;
+        }
+    }
+    void mark_forgotten() {
+        _forgotten = true;
+    }
+    bool forgotten() const {
+        return _forgotten;
+    }
+};
+
+uring_socket_completion::uring_socket_completion(pollable_fd_state& fd)
+        : _owner(static_cast<uring_pollable_fd_state*>(&fd)) {
+    _owner->socket_requests().push_back(*this);
+}
+
+uring_socket_completion::~uring_socket_completion() {
+    auto& requests = _owner->socket_requests();
+    requests.erase(requests.iterator_to(*this));
+    _owner->maybe_dispose();
+}
+
+bool uring_socket_completion::fd_forgotten() const {
+    return _owner->forgotten();
+}
+
+file_desc reactor_backend_uring::make_timerfd() {
+    return file_desc::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK);
+}
+
+reactor_backend_uring::reactor_backend_uring(reactor* r)
+    : _r(r)
+    , _uring(queue_len)
+    , _hrtimer_timerfd(make_timerfd())
+    , _preempting_io(_r, _r->_task_quota_timer, _hrtimer_timerfd)
+    , _hrtimer_poll_completion(std::make_unique<fd_poll_completion>(_r, _hrtimer_timerfd, [r] {
+        r->service_highres_timer();
+    }))
+    , _smp_wakeup_poll_completion(std::make_unique<fd_poll_completion>(_r, _r->_notify_eventfd, [] {}))
+{
+    // Protect against spurious wakeups - if we get notified that the timer has
+    // expired when it really hasn't, we don't want to block in read(tfd, ...).
+    auto tfd = _r->_task_quota_timer.get();
+    ::fcntl(tfd, F_SETFL, ::fcntl(tfd, F_GETFL) | O_NONBLOCK);
+
+    sigset_t mask = make_sigset_mask(hrtimer_signal());
+    auto e = ::pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    assert(e == 0);
+
+    // Reserve an empty file table so files can be registered one by one
+    // later on; older kernels refuse sparse tables, and then we simply
+    // don't register files.
+    std::vector<int> fds(max_registered_files, -1);
+    if (io_uring_register(_uring.fd(), IORING_REGISTER_FILES, fds.data(), fds.size()) == 0) {
+        _file_slots.resize(max_registered_files, false);
+        _free_file_slots = max_registered_files;
+    }
+}
+
+reactor_backend_uring::~reactor_backend_uring() = default;
+
+int reactor_backend_uring::register_dma_buffers(void* base, size_t size) {
+    if (_has_registered_buffers) {
+        return -1;
+    }
+    ::iovec iov{base, size};
+    if (io_uring_register(_uring.fd(), IORING_REGISTER_BUFFERS, &iov, 1) != 0) {
+        seastar_logger.warn("Could not register DMA buffers with io_uring ({}), using them unregistered",
+                std::error_code(errno, std::system_category()).message());
+        return -1;
+    }
+    _has_registered_buffers = true;
+    return 0;
+}
+
+int reactor_backend_uring::register_file(int fd) {
+    if (!_free_file_slots) {
+        return -1;
+    }
+    auto it = std::find(_file_slots.begin(), _file_slots.end(), false);
+    int slot = it - _file_slots.begin();
+    ::io_uring_files_update up{};
+    up.offset = slot;
+    up.fds = reinterpret_cast<uintptr_t>(&fd);
+    if (io_uring_register(_uring.fd(), IORING_REGISTER_FILES_UPDATE, &up, 1) != 1) {
+        return -1;
+    }
+    *it = true;
+    --_free_file_slots;
+    return slot;
+}
+
+void reactor_backend_uring::unregister_file(int slot) {
+    int fd = -1;
+    ::io_uring_files_update up{};
+    up.offset = slot;
+    up.fds = reinterpret_cast<uintptr_t>(&fd);
+    // Requests already submitted keep their own reference to the file
+    (void)io_uring_register(_uring.fd(), IORING_REGISTER_FILES_UPDATE, &up, 1);
+    _file_slots[slot] = false;
+    ++_free_file_slots;
+}
+
+::io_uring_sqe& reactor_backend_uring::get_sqe() {
+    auto* sqe = _uring.get_sqe();
+    while (!sqe) {
+        // The ring is full: hand what we have to the kernel, and make room
+        // in the completion ring in case that is what is holding it back.
+        flush_submissions();
+        _did_work_while_getting_sqe |= process_completions();
+        sqe = _uring.get_sqe();
+    }
+    return *sqe;
+}
+
+bool reactor_backend_uring::flush_submissions() {
+    if (!_uring.pending_submissions()) {
+        return false;
+    }
+    auto r = _uring.submit_and_wait(0);
+    if (r == -1) {
+        // EBUSY/EAGAIN: the kernel is short of resources or still has
+        // overflowed completions for us; retry on the next poll.
+        throw_system_error_on(errno != EBUSY && errno != EAGAIN && errno != EINTR, "io_uring_enter");
+        return false;
+    }
+    return r > 0;
+}
+
+bool reactor_backend_uring::submit_pending_io() {
+    auto& pending = _r->_pending_io;
+    bool did_work = !pending.empty();
+    while (!pending.empty()) {
+        auto* sqe = _uring.get_sqe();
+        if (!sqe) {
+            flush_submissions();
+            sqe = _uring.get_sqe();
+            if (!sqe) {
+                break;
+            }
+        }
+        prepare_sqe(pending.front(), *sqe);
+        pending.pop_front();
+        if (sqe->opcode == IORING_OP_READ_FIXED || sqe->opcode == IORING_OP_WRITE_FIXED) {
+            ++_r->_io_stats.aio_fixed_buffer_ops;
+        }
+        if (sqe->flags & IOSQE_FIXED_FILE) {
+            ++_r->_io_stats.aio_fixed_file_ops;
+        }
+    }
+    return did_work;
+}
+
+bool reactor_backend_uring::process_completions() {
+    auto nr = _uring.for_each_completion([] (const ::io_uring_cqe& cqe) {
+        auto* desc = reinterpret_cast<kernel_completion*>(uintptr_t(cqe.user_data));
+        // Cancellations of forgotten polls are fire-and-forget.
+        if (desc) {
+            desc->complete_with(cqe.res);
+        }
+    });
+    return nr;
+}
+
+void reactor_backend_uring::arm_poll(fd_poll_completion& completion) {
+    if (!completion.armed()) {
+        auto& sqe = get_sqe();
+        auto req = io_request::make_poll_add(completion.fd().get(), POLLIN);
+        req.attach_kernel_completion(&completion);
+        prepare_sqe(req, sqe);
+        completion.set_armed();
+    }
+}
+
+bool reactor_backend_uring::reap_kernel_completions() {
+    bool did_work = std::exchange(_did_work_while_getting_sqe, false);
+    did_work |= process_completions();
+    return did_work;
+}
+
+bool reactor_backend_uring::kernel_submit_work() {
+    arm_poll(*_hrtimer_poll_completion);
+    bool did_work = submit_pending_io();
+    did_work |= flush_submissions();
+    return did_work;
+}
+
+bool reactor_backend_uring::kernel_events_can_sleep() const {
+    // Disk and socket completions are delivered to the same ring we sleep
+    // on, so in-flight I/O never needs to be polled for.
+    return true;
+}
+
+void reactor_backend_uring::wait_and_process_events(const sigset_t* active_sigmask) {
+    bool did_work = _preempting_io.service_preempting_io();
+    did_work |= process_completions();
+
+    arm_poll(*_hrtimer_poll_completion);
+    arm_poll(*_smp_wakeup_poll_completion);
+    submit_pending_io();
+    auto r = _uring.submit_and_wait(did_work ? 0 : 1, active_sigmask);
+    if (r == -1) {
+        throw_system_error_on(errno != EINTR && errno != EBUSY && errno != EAGAIN, "io_uring_enter");
+    }
+    process_completions();
+    _preempting_io.service_preempting_io(); // clear task quota timer
+}
+
+future<> reactor_backend_uring::poll(pollable_fd_state& fd, int events) {
+    try {
+        if (events & fd.events_known) {
+            fd.events_known &= ~events;
+            return make_ready_future<>();
+        }
+
+        fd.events_rw = events == (POLLIN|POLLOUT);
+
+        auto* pfd = static_cast<uring_pollable_fd_state*>(&fd);
+        auto& desc = pfd->get_desc(events);
+        auto& sqe = get_sqe();
+        auto fut = desc.arm();
+        auto req = io_request::make_poll_add(fd.fd.get(), events);
+        req.attach_kernel_completion(&desc);
+        prepare_sqe(req, sqe);
+        return fut;
+    } catch (...) {
+        return make_exception_future<>(std::current_exception());
+    }
+}
+
+future<> reactor_backend_uring::readable(pollable_fd_state& fd) {
+    return poll(fd, POLLIN);
+}
+
+future<> reactor_backend_uring::writeable(pollable_fd_state& fd) {
+    return poll(fd, POLLOUT);
+}
+
+future<> reactor_backend_uring::readable_or_writeable(pollable_fd_state& fd) {
+    return poll(fd, POLLIN|POLLOUT);
+}
+
+void reactor_backend_uring::forget(pollable_fd_state& fd) noexcept {
+    auto* pfd = static_cast<uring_pollable_fd_state*>(&fd);
+    // get_sqe() may process completions, so the state is only marked as
+    // forgotten (and may only be disposed of) once all cancellations are
+    // queued.
+    for (auto events : {POLLIN, POLLOUT}) {
+        auto& desc = pfd->get_desc(events);
+        if (desc.armed()) {
+            auto& sqe = get_sqe();
+            auto req = io_request::make_poll_remove(-1, static_cast<kernel_completion*>(&desc));
+            req.attach_kernel_completion(nullptr);
+            prepare_sqe(req, sqe);
+        }
+    }
+    // The kernel holds a reference to the socket, and may still write to
+    // the caller's buffers, until every socket operation on it completes.
+    for (auto& desc : pfd->socket_requests()) {
+        if (!desc.completed()) {
+            auto& sqe = get_sqe();
+            auto req = io_request::make_cancel(-1, static_cast<kernel_completion*>(&desc));
+            req.attach_kernel_completion(nullptr);
+            prepare_sqe(req, sqe);
+        }
+    }
+    pfd->mark_forgotten();
+    pfd->maybe_dispose();
+}
+
+// The fd was forgotten while a socket operation was in flight; its state
+// only lives on until the operation's continuation is done, so the result
+// is dropped.
+[[noreturn]] static void throw_fd_forgotten() {
+    throw std::system_error(std::error_code(ECONNABORTED, std::system_category()));
+}
+
+future<ssize_t> reactor_backend_uring::submit_socket_request(uring_socket_completion& desc, io_request req) {
+    auto fut = desc.get_future();
+    auto& sqe = get_sqe();
+    req.attach_kernel_completion(&desc);
+    prepare_sqe(req, sqe);
+    return fut;
+}
+
+// The socket operations below go through the ring directly unless a
+// previous operation already told us the socket is ready, in which case
+// the plain syscall is cheaper. A kernel that hands back -EAGAIN (it would
+// have had to poll on our behalf) or a non-socket fd falls back to the
+// poll-then-syscall path.
+
+future<std::tuple<pollable_fd, socket_address>>
+reactor_backend_uring::accept(pollable_fd_state& listenfd) {
+    if (listenfd.events_known & POLLIN) {
+        return engine().do_accept(listenfd);
+    }
+    if (listenfd.no_more_recv) {
+        return make_exception_future<std::tuple<pollable_fd, socket_address>>(
+                std::system_error(std::error_code(ECONNABORTED, std::system_category())));
+    }
+    auto desc = std::make_unique<uring_socket_completion>(listenfd);
+    auto req = io_request::make_accept(listenfd.fd.get(), &desc->peer.u.sa, &desc->peer_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    auto fut = submit_socket_request(*desc, req);
+    return fut.then([&listenfd, desc = std::move(desc)] (ssize_t res) {
+        if (desc->fd_forgotten()) {
+            if (res >= 0) {
+                ::close(res);
+            }
+            throw_fd_forgotten();
+        }
+        if (res == -EAGAIN) {
+            return engine().do_accept(listenfd);
+        }
+        throw_kernel_error(res);
+        // Same speculation as the poll-based accept
+        listenfd.speculate_epoll(EPOLLIN);
+        pollable_fd pfd(file_desc::from_fd(res), pollable_fd::speculation(EPOLLOUT));
+        desc->peer.addr_length = desc->peer_len;
+        return make_ready_future<std::tuple<pollable_fd, socket_address>>(std::make_tuple(std::move(pfd), desc->peer));
+    });
+}
+
+future<> reactor_backend_uring::connect(pollable_fd_state& fd, socket_address& sa) {
+    auto desc = std::make_unique<uring_socket_completion>(fd);
+    // The caller's address may be gone by the time the sqe is submitted
+    desc->peer = sa;
+    desc->peer_len = sa.length();
+    auto fut = submit_socket_request(*desc, io_request::make_connect(fd.fd.get(), &desc->peer.u.sa, desc->peer_len));
+    return fut.then([&fd, desc = std::move(desc)] (ssize_t res) {
+        if (desc->fd_forgotten()) {
+            throw_fd_forgotten();
+        }
+        if (res == -EINPROGRESS || res == -EAGAIN) {
+            return fd.writeable().then([&fd] {
+                auto err = fd.fd.getsockopt<int>(SOL_SOCKET, SO_ERROR);
+                if (err != 0) {
+                    throw std::system_error(err, std::system_category());
+                }
+            });
+        }
+        throw_kernel_error(res);
+        return make_ready_future<>();
+    });
+}
+
+void reactor_backend_uring::shutdown(pollable_fd_state& fd, int how) {
+    fd.fd.shutdown(how);
+}
+
+future<size_t>
+reactor_backend_uring::read_some(pollable_fd_state& fd, void* buffer, size_t len) {
+    if (fd.events_known & POLLIN) {
+        return engine().do_read_some(fd, buffer, len);
+    }
+    auto desc = std::make_unique<uring_socket_completion>(fd);
+    auto fut = submit_socket_request(*desc, io_request::make_recv(fd.fd.get(), buffer, len, 0));
+    return fut.then([&fd, buffer, len, desc = std::move(desc)] (ssize_t res) {
+        if (desc->fd_forgotten()) {
+            throw_fd_forgotten();
+        }
+        if (res == -EAGAIN || res == -ENOTSOCK) {
+            return engine().do_read_some(fd, buffer, len);
+        }
+        throw_kernel_error(res);
+        if (size_t(res) == len) {
+            fd.speculate_epoll(EPOLLIN);
+        }
+        return make_ready_future<size_t>(res);
+    });
+}
+
+future<size_t>
+reactor_backend_uring::read_some(pollable_fd_state& fd, const std::vector<iovec>& iov) {
+    if (fd.events_known & POLLIN) {
+        return engine().do_read_some(fd, iov);
+    }
+    auto desc = std::make_unique<uring_socket_completion>(fd);
+    desc->iov = iov;
+    desc->msg.msg_iov = desc->iov.data();
+    desc->msg.msg_iovlen = desc->iov.size();
+    auto fut = submit_socket_request(*desc, io_request::make_recvmsg(fd.fd.get(), &desc->msg, 0));
+    return fut.then([&fd, desc = std::move(desc)] (ssize_t res) {
+        if (desc->fd_forgotten()) {
+            throw_fd_forgotten();
+        }
+        if (res == -EAGAIN || res == -ENOTSOCK) {
+            return engine().do_read_some(fd, desc->iov);
+        }
+        throw_kernel_error(res);
+        if (size_t(res) == iovec_len(desc->iov)) {
+            fd.speculate_epoll(EPOLLIN);
+        }
+        return make_ready_future<size_t>(res);
+    });
+}
+
+future<temporary_buffer<char>>
+reactor_backend_uring::read_some(pollable_fd_state& fd, internal::buffer_allocator* ba) {
+    if (fd.events_known & POLLIN) {
+        return engine().do_read_some(fd, ba);
+    }
+    auto buffer = ba->allocate_buffer();
+    auto desc = std::make_unique<uring_socket_completion>(fd);
+    auto fut = submit_socket_request(*desc, io_request::make_recv(fd.fd.get(), buffer.get_write(), buffer.size(), 0));
+    return fut.then([&fd, ba, buffer = std::move(buffer), desc = std::move(desc)] (ssize_t res) mutable {
+        if (desc->fd_forgotten()) {
+            throw_fd_forgotten();
+        }
+        if (res == -EAGAIN || res == -ENOTSOCK) {
+            return engine().do_read_some(fd, ba);
+        }
+        throw_kernel_error(res);
+        if (size_t(res) == buffer.size()) {
+            fd.speculate_epoll(EPOLLIN);
+        }
+        buffer.trim(res);
+        return make_ready_future<temporary_buffer<char>>(std::move(buffer));
+    });
+}
+
+future<size_t>
+reactor_backend_uring::write_some(pollable_fd_state& fd, const void* buffer, size_t len) {
+    if (fd.events_known & POLLOUT) {
+        return engine().do_write_some(fd, buffer, len);
+    }
+    auto desc = std::make_unique<uring_socket_completion>(fd);
+    auto fut = submit_socket_request(*desc, io_request::make_send(fd.fd.get(), buffer, len, MSG_NOSIGNAL));
+    return fut.then([&fd, buffer, len, desc = std::move(desc)] (ssize_t res) {
+        if (desc->fd_forgotten()) {
+            throw_fd_forgotten();
+        }
+        if (res == -EAGAIN || res == -ENOTSOCK) {
+            return engine().do_write_some(fd, buffer, len);
+        }
+        throw_kernel_error(res);
+        if (size_t(res) == len) {
+            fd.speculate_epoll(EPOLLOUT);
+        }
+        return make_ready_future<size_t>(res);
+    });
+}
+
+future<size_t>
+reactor_backend_uring::write_some(pollable_fd_state& fd, net::packet& p) {
+    if (fd.events_known & POLLOUT) {
+        return engine().do_write_some(fd, p);
+    }
+    auto desc = std::make_unique<uring_socket_completion>(fd);
+    desc->msg.msg_iov = reinterpret_cast<iovec*>(p.fragment_array());
+    desc->msg.msg_iovlen = std::min<size_t>(p.nr_frags(), IOV_MAX);
+    auto fut = submit_socket_request(*desc, io_request::make_sendmsg(fd.fd.get(), &desc->msg, MSG_NOSIGNAL));
+    return fut.then([&fd, &p, desc = std::move(desc)] (ssize_t res) {
+        if (desc->fd_forgotten()) {
+            throw_fd_forgotten();
+        }
+        if (res == -EAGAIN || res == -ENOTSOCK) {
+            return engine().do_write_some(fd, p);
+        }
+        throw_kernel_error(res);
+        if (size_t(res) == p.len()) {
+            fd.speculate_epoll(EPOLLOUT);
+        }
+        return make_ready_future<size_t>(res);
+    });
+}
+
+void reactor_backend_uring::signal_received(int signo, siginfo_t* siginfo, void* ignore) {
+    engine()._signals.action(signo, siginfo, ignore);
+}
+
+void reactor_backend_uring::start_tick() {
+    _preempting_io.start_tick();
+}
+
+void reactor_backend_uring::stop_tick() {
+    _preempting_io.stop_tick();
+}
+
+void reactor_backend_uring::arm_highres_timer(const ::itimerspec& its) {
+    _hrtimer_timerfd.timerfd_settime(TFD_TIMER_ABSTIME, its);
+}
+
+void reactor_backend_uring::reset_preemption_monitor() {
+    _preempting_io.reset_preemption_monitor();
+}
+
+void reactor_backend_uring::request_preemption() {
+    _preempting_io.request_preemption();
+}
+
+void reactor_backend_uring::start_handling_signal() {
+    // Like the aio backend, we only use signals for SIGHUP/SIGTERM/SIGINT.
+}
+
+pollable_fd_state_ptr
+reactor_backend_uring::make_pollable_fd_state(file_desc fd, pollable_fd::speculation speculate) {
+    return pollable_fd_state_ptr(new uring_pollable_fd_state(std::move(fd), std::move(speculate)));
+}
+
+static bool detect_io_uring() {
+    try {
+        uring_context ring(8);
+        // We rely on the kernel arming its own poll for sockets that are not
+        // ready yet, and on it never dropping completions.
+        auto required_features = IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+        if ((ring.params().features & required_features) != required_features) {
+            return false;
+        }
+        constexpr unsigned probe_ops = 256;
+        std::vector<char> buf(sizeof(::io_uring_probe) + probe_ops * sizeof(::io_uring_probe_op));
+        auto* probe = reinterpret_cast<::io_uring_probe*>(buf.data());
+        if (io_uring_register(ring.fd(), IORING_REGISTER_PROBE, probe, probe_ops) != 0) {
+            return false;
+        }
+        for (auto op : {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READV, IORING_OP_WRITEV, IORING_OP_FSYNC,
+                IORING_OP_RECV, IORING_OP_SEND, IORING_OP_RECVMSG, IORING_OP_SENDMSG, IORING_OP_ACCEPT,
+                IORING_OP_CONNECT, IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_ASYNC_CANCEL}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    } catch (...) {
+        // ENOSYS on old kernels, EPERM under seccomp filters or when
+        // io_uring is disabled through sysctl.
+        return false;
+    }
+}
+
+#endif /* SEASTAR_HAVE_URING */
+
 #ifdef HAVE_OSV
 reactor_backend_osv::reactor_backend_osv() {
 }
@@ -990,6 +1838,10 @@ std::unique_ptr<reactor_backend> reactor_backend_selector::create(reactor* r) {
         return std::make_unique<reactor_backend_aio>(r);
     } else if (_name == "epoll") {
         return std::make_unique<reactor_backend_epoll>(r);
+#ifdef SEASTAR_HAVE_URING
+    } else if (_name == "io_uring") {
+        return std::make_unique<reactor_backend_uring>(r);
+#endif
     }
     throw std::logic_error("bad reactor backend");
 }
@@ -1000,11 +1852,25 @@ reactor_backend_selector reactor_backend_selector::default_backend() {
 
 std::vector<reactor_backend_selector> reactor_backend_selector::available() {
     std::vector<reactor_backend_selector> ret;
-    if (detect_aio_poll() && has_enough_aio_nr()) {
+    bool has_aio = detect_aio_poll() && has_enough_aio_nr();
+    if (has_aio) {
         ret.push_back(reactor_backend_selector("linux-aio"));
     }
     ret.push_back(reactor_backend_selector("epoll"));
+#ifdef SEASTAR_HAVE_URING
+    // The io_uring backend still sets up an aio context, polled for
+    // preemption.
+    if (has_aio && detect_io_uring()) {
+        ret.push_back(reactor_backend_selector("io_uring"));
+    }
+#endif
     return ret;
 }
 
+reactor_backend_selector reactor_backend_selector::uring_fallback() {
+    auto rbs = default_backend();
+    seastar_logger.warn("io_uring reactor backend requested but not supported by this kernel, falling back to {}", rbs);
+    return rbs;
+}
+
 }
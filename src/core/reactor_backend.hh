@@ -25,6 +25,7 @@
 #include <seastar/core/posix.hh>
 #include <seastar/core/internal/pollable_fd.hh>
 #include <seastar/core/internal/poll.hh>
+#include <seastar/core/internal/io_request.hh>
 #include <seastar/core/linux-aio.hh>
 #include <seastar/core/cacheline.hh>
 #include <sys/time.h>
@@ -35,6 +36,11 @@
 #include <boost/program_options.hpp>
 #include <boost/container/static_vector.hpp>
 
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define SEASTAR_HAVE_URING
+#endif
+
 #ifdef HAVE_OSV
 #include <osv/newpoll.hh>
 #endif
@@ -196,6 +202,17 @@ class reactor_backend {
     virtual void start_handling_signal() = 0;
 
     virtual pollable_fd_state_ptr make_pollable_fd_state(file_desc fd, pollable_fd::speculation speculate) = 0;
+
+    // Registration of long-lived I/O resources with the kernel, so that
+    // requests using them skip per-request page pinning and file reference
+    // counting. Backends without such a facility keep the defaults, and
+    // requests are then submitted with the plain buffer and fd.
+    //
+    // Returns the registered buffer index, or -1.
+    virtual int register_dma_buffers(void* base, size_t size) { return -1; }
+    // Returns the registered file slot, or -1.
+    virtual int register_file(int fd) { return -1; }
+    virtual void unregister_file(int slot) {}
 };
 
 // reactor backend using file-descriptor & epoll, suitable for running on
@@ -296,6 +313,126 @@ class reactor_backend_aio : public reactor_backend {
     make_pollable_fd_state(file_desc fd, pollable_fd::speculation speculate) override;
 };
 
+#ifdef SEASTAR_HAVE_URING
+// A minimal io_uring submission/completion ring pair, driven directly through
+// the io_uring_setup(2) and io_uring_enter(2) system calls (in the same way
+// linux-aio.hh talks to the kernel without libaio).
+class uring_context {
+    ::io_uring_params _params{}; // filled in by io_uring_setup(), so it must precede _fd
+    file_desc _fd;
+    mmap_area _sq_ring;
+    mmap_area _cq_ring; // empty if the kernel maps both rings together
+    mmap_area _sqes_area;
+    // Submission ring
+    unsigned* _sq_head;
+    unsigned* _sq_tail;
+    unsigned* _sq_mask;
+    unsigned* _sq_flags;
+    unsigned* _sq_array;
+    ::io_uring_sqe* _sqes;
+    unsigned _sq_local_tail; // sqes prepared but not yet made visible to the kernel
+    // Completion ring
+    unsigned* _cq_head;
+    unsigned* _cq_tail;
+    unsigned* _cq_mask;
+    ::io_uring_cqe* _cqes;
+public:
+    explicit uring_context(unsigned entries);
+    uring_context(const uring_context&) = delete;
+    void operator=(const uring_context&) = delete;
+
+    const ::io_uring_params& params() const {
+        return _params;
+    }
+    int fd() const {
+        return _fd.get();
+    }
+    // Returns a zeroed sqe, or nullptr if the submission ring is full.
+    ::io_uring_sqe* get_sqe();
+    // Number of sqes the kernel has not consumed yet.
+    unsigned pending_submissions() const;
+    // Publishes prepared sqes and enters the kernel to consume them, and,
+    // if wait_nr != 0, to wait for that many completions. Returns the
+    // io_uring_enter(2) result (-1 with errno on error).
+    int submit_and_wait(unsigned wait_nr, const sigset_t* active_sigmask = nullptr);
+    // Calls func(const io_uring_cqe&) for every available completion and
+    // returns the number of completions consumed.
+    template <typename Func>
+    unsigned for_each_completion(Func&& func);
+};
+
+class uring_socket_completion;
+
+// reactor backend that submits disk I/O, socket operations and fd polls
+// through a single io_uring. The task quota timer and preemption still use
+// the aio-based preempt_io_context, since it lets need_preempt() poll a
+// shared memory ring without making a system call.
+class reactor_backend_uring : public reactor_backend {
+    // The submission ring is sized for batching, not for the number of
+    // in-flight requests; the kernel backs up overflowing completions
+    // (IORING_FEAT_NODROP), so the ring length only bounds batch size.
+    static constexpr unsigned queue_len = 256;
+    static constexpr unsigned max_registered_files = 1024;
+    reactor* _r;
+    uring_context _uring;
+    file_desc _hrtimer_timerfd;
+    preempt_io_context _preempting_io;
+    // Sparse table of registered files; empty if the kernel cannot do it.
+    std::vector<bool> _file_slots;
+    unsigned _free_file_slots = 0;
+    bool _has_registered_buffers = false;
+    class fd_poll_completion;
+    std::unique_ptr<fd_poll_completion> _hrtimer_poll_completion;
+    std::unique_ptr<fd_poll_completion> _smp_wakeup_poll_completion;
+    bool _did_work_while_getting_sqe = false;
+    static file_desc make_timerfd();
+    ::io_uring_sqe& get_sqe();
+    bool submit_pending_io();
+    bool flush_submissions();
+    bool process_completions();
+    void arm_poll(fd_poll_completion& completion);
+    future<ssize_t> submit_socket_request(uring_socket_completion& desc, internal::io_request req);
+public:
+    explicit reactor_backend_uring(reactor* r);
+    virtual ~reactor_backend_uring() override;
+
+    virtual bool reap_kernel_completions() override;
+    virtual bool kernel_submit_work() override;
+    virtual bool kernel_events_can_sleep() const override;
+    virtual void wait_and_process_events(const sigset_t* active_sigmask) override;
+    future<> poll(pollable_fd_state& fd, int events);
+    virtual future<> readable(pollable_fd_state& fd) override;
+    virtual future<> writeable(pollable_fd_state& fd) override;
+    virtual future<> readable_or_writeable(pollable_fd_state& fd) override;
+    virtual void forget(pollable_fd_state& fd) noexcept override;
+
+    virtual future<std::tuple<pollable_fd, socket_address>>
+    accept(pollable_fd_state& listenfd) override;
+    virtual future<> connect(pollable_fd_state& fd, socket_address& sa) override;
+    virtual void shutdown(pollable_fd_state& fd, int how) override;
+    virtual future<size_t> read_some(pollable_fd_state& fd, void* buffer, size_t len) override;
+    virtual future<size_t> read_some(pollable_fd_state& fd, const std::vector<iovec>& iov) override;
+    virtual future<temporary_buffer<char>> read_some(pollable_fd_state& fd, internal::buffer_allocator* ba) override;
+    virtual future<size_t> write_some(pollable_fd_state& fd, net::packet& p) override;
+    virtual future<size_t> write_some(pollable_fd_state& fd, const void* buffer, size_t len) override;
+
+    virtual void signal_received(int signo, siginfo_t* siginfo, void* ignore) override;
+    virtual void start_tick() override;
+    virtual void stop_tick() override;
+    virtual void arm_highres_timer(const ::itimerspec& its) override;
+    virtual void reset_preemption_monitor() override;
+    virtual void request_preemption() override;
+    virtual void start_handling_signal() override;
+
+    virtual pollable_fd_state_ptr
+    make_pollable_fd_state(file_desc fd, pollable_fd::speculation speculate) override;
+
+    virtual int register_dma_buffers(void* base, size_t size) override;
+    virtual int register_file(int fd) override;
+    virtual void unregister_file(int slot) override;
+};
+#endif /* SEASTAR_HAVE_URING */
+
 #ifdef HAVE_OSV
 // reactor_backend using OSv-specific features, without any file descriptors.
 // This implementation cannot currently wait on file descriptors, but unlike
@@ -338,6 +475,7 @@ class reactor_backend_selector {
     std::string _name;
 private:
     static bool has_enough_aio_nr();
+    static reactor_backend_selector uring_fallback();
     explicit reactor_backend_selector(std::string name) : _name(std::move(name)) {}
 public:
     std::unique_ptr<reactor_backend> create(reactor* r);
@@ -356,6 +494,12 @@ class reactor_backend_selector {
                 return;
             }
         }
+        if (s == "io_uring") {
+            // Asked for io_uring, but this kernel (or a seccomp policy) does
+            // not let us use it.
+            v = uring_fallback();
+            return;
+        }
         throw bpo::validation_error(bpo::validation_error::invalid_option_value);
     }
 };
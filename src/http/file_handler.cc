@@ -89,11 +89,15 @@ future<std::unique_ptr<reply>> file_interaction_handler::read(
         return do_with(output_stream<char>(get_stream(std::move(req), extension, std::move(s))),
                 [file_name] (output_stream<char>& os) {
             return open_file_dma(file_name, open_flags::ro).then([&os] (file f) {
-                return do_with(input_stream<char>(make_file_input_stream(std::move(f))), [&os](input_stream<char>& is) {
-                    return copy(is, os).then([&os] {
+                return do_with(std::move(f), [&os] (file& f) {
+                    // Written as a whole, so that it can be sent by the kernel
+                    // rather than copied through the stream's buffers.
+                    return f.size().then([&os, &f] (uint64_t size) {
+                        return os.write(f, 0, size);
+                    }).then([&os] {
                         return os.close();
-                    }).then([&is] {
-                        return is.close();
+                    }).finally([&f] {
+                        return f.close();
                     });
                 });
             });
@@ -118,9 +122,31 @@ future<std::unique_ptr<reply>> file_handler::handle(const sstring& path,
     if (force_path && redirect_if_needed(*req.get(), *rep.get())) {
         return make_ready_future<std::unique_ptr<reply>>(std::move(rep));
     }
+    if (memory_mapped) {
+        return read_mapped(std::move(req), std::move(rep));
+    }
     return read(file, std::move(req), std::move(rep));
 }
 
+future<std::unique_ptr<reply>> file_handler::read_mapped(
+        std::unique_ptr<request> req, std::unique_ptr<reply> rep) {
+    auto mapped = mapping ? make_ready_future<>() : map_file_read_only(file).then([this] (mapped_file m) {
+        mapping = std::move(m);
+    });
+    return mapped.then([this, req = std::move(req), rep = std::move(rep)] () mutable {
+        auto extension = get_extension(file);
+        rep->write_body(extension, [this, req = std::move(req), extension, data = mapping->get()] (output_stream<char>&& s) mutable {
+            return do_with(output_stream<char>(get_stream(std::move(req), extension, std::move(s))),
+                    [data = std::move(data)] (output_stream<char>& os) mutable {
+                return os.write(std::move(data)).then([&os] {
+                    return os.close();
+                });
+            });
+        });
+        return make_ready_future<std::unique_ptr<reply>>(std::move(rep));
+    });
+}
+
 }
 
 }
@@ -130,6 +130,18 @@ class http_chunked_data_sink_impl : public data_sink_impl {
             return _out.write("\r\n", 2);
         });
     }
+    // The whole range goes out as a single chunk, so that the connection's
+    // stream can send it straight from the file.
+    virtual future<> put_file(const file& f, uint64_t pos, uint64_t len) override {
+        if (len == 0) {
+            return make_ready_future<>();
+        }
+        return write_size(len).then([this, &f, pos, len] {
+            return _out.write(f, pos, len);
+        }).then([this] {
+            return _out.write("\r\n", 2);
+        });
+    }
     virtual future<> close() override {
         return  make_ready_future<>();
     }
@@ -53,6 +53,9 @@ class native_server_socket_impl : public server_socket_impl {
 template <typename Protocol>
 native_server_socket_impl<Protocol>::native_server_socket_impl(Protocol& proto, uint16_t port, listen_options opt)
     : _listener(proto.listen(port)) {
+    _listener.set_congestion_control(opt.congestion_control);
+    _listener.set_pacing(opt.pacing);
+    _listener.set_rto_min(opt.rto_min);
 }
 
 template <typename Protocol>
@@ -100,6 +103,9 @@ class native_connected_socket_impl : public connected_socket_impl {
     bool get_keepalive() const override;
     void set_keepalive_parameters(const keepalive_params&) override;
     keepalive_params get_keepalive_parameters() const override;
+    void set_congestion_control(tcp_congestion_control cc) override;
+    void set_pacing(bool pacing) override;
+    void set_rto_min(std::chrono::milliseconds rto_min) override;
 };
 
 template <typename Protocol>
@@ -245,6 +251,21 @@ void native_connected_socket_impl<Protocol>::set_keepalive_parameters(const keep
     std::cerr << "Keepalive parameters are not supported by native stack" << std::endl;
 }
 
+template <typename Protocol>
+void native_connected_socket_impl<Protocol>::set_congestion_control(tcp_congestion_control cc) {
+    _conn->set_congestion_control(cc);
+}
+
+template <typename Protocol>
+void native_connected_socket_impl<Protocol>::set_pacing(bool pacing) {
+    _conn->set_pacing(pacing);
+}
+
+template <typename Protocol>
+void native_connected_socket_impl<Protocol>::set_rto_min(std::chrono::milliseconds rto_min) {
+    _conn->set_rto_min(rto_min);
+}
+
 template <typename Protocol>
 keepalive_params native_connected_socket_impl<Protocol>::get_keepalive_parameters() const {
     // FIXME: implement
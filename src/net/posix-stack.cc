@@ -34,7 +34,17 @@
 #include <seastar/net/inet_address.hh>
 #include <seastar/util/std-compat.hh>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <netinet/sctp.h>
+#include <deque>
+
+// Not defined by glibc before 2.29
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
 
 namespace std {
 
@@ -81,6 +91,7 @@ class posix_connected_socket_operations {
     virtual bool get_keepalive(file_desc& _fd) const = 0;
     virtual void set_keepalive_parameters(file_desc& _fd, const keepalive_params& params) const = 0;
     virtual keepalive_params get_keepalive_parameters(file_desc& _fd) const = 0;
+    virtual bool enable_zero_copy(file_desc& _fd) const = 0;
 };
 
 thread_local posix_ap_server_socket_impl::sockets_map_t posix_ap_server_socket_impl::sockets{};
@@ -113,6 +124,10 @@ class posix_tcp_connected_socket_operations : public posix_connected_socket_oper
             _fd.getsockopt<unsigned>(IPPROTO_TCP, TCP_KEEPCNT)
         };
     }
+    virtual bool enable_zero_copy(file_desc& _fd) const override {
+        int one = 1;
+        return ::setsockopt(_fd.get(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    }
 };
 
 class posix_sctp_connected_socket_operations : public posix_connected_socket_operations {
@@ -149,6 +164,9 @@ class posix_sctp_connected_socket_operations : public posix_connected_socket_ope
             params.spp_pathmaxrxt
         };
     }
+    virtual bool enable_zero_copy(file_desc& _fd) const override {
+        return false;
+    }
 };
 
 class posix_unix_stream_connected_socket_operations : public posix_connected_socket_operations {
@@ -167,6 +185,9 @@ class posix_unix_stream_connected_socket_operations : public posix_connected_soc
     virtual keepalive_params get_keepalive_parameters(file_desc& fd) const override {
         return keepalive_params{};
     }
+    virtual bool enable_zero_copy(file_desc& fd) const override {
+        return false;
+    }
 };
 
 static const posix_connected_socket_operations*
@@ -234,6 +255,12 @@ class posix_connected_socket_impl final : public connected_socket_impl {
     keepalive_params get_keepalive_parameters() const override {
         return _ops->get_keepalive_parameters(_fd.get_file_desc());
     }
+    void set_zero_copy_send(size_t threshold) override {
+        if (threshold && !_fd.zero_copy_threshold() && !_ops->enable_zero_copy(_fd.get_file_desc())) {
+            return;
+        }
+        _fd.set_zero_copy_threshold(threshold);
+    }
     friend class posix_server_socket_impl;
     friend class posix_ap_server_socket_impl;
     friend class posix_reuseport_server_socket_impl;
@@ -611,15 +638,31 @@ std::vector<iovec> to_iovec(std::vector<temporary_buffer<char>>& buf_vec) {
 
 future<>
 posix_data_sink_impl::put(temporary_buffer<char> buf) {
+    if (_fd.zero_copy_threshold() && buf.size() >= _fd.zero_copy_threshold()) {
+        return _fd.send_zero_copy(packet(std::move(buf)));
+    }
     return _fd.write_all(buf.get(), buf.size()).then([d = buf.release()] {});
 }
 
 future<>
 posix_data_sink_impl::put(packet p) {
+    if (_fd.zero_copy_threshold() && p.len() >= _fd.zero_copy_threshold()) {
+        return _fd.send_zero_copy(std::move(p));
+    }
     _p = std::move(p);
     return _fd.write_all(_p).then([this] { _p.reset(); });
 }
 
+future<>
+posix_data_sink_impl::put_file(const file& f, uint64_t pos, uint64_t len) {
+    return _fd.sendfile(f, pos, len).then([this, &f, pos, len] (uint64_t sent) {
+        if (sent == len) {
+            return make_ready_future<>();
+        }
+        return data_sink_impl::put_file(f, pos + sent, len - sent);
+    });
+}
+
 future<>
 posix_data_sink_impl::close() {
     _fd.shutdown(SHUT_WR);
@@ -691,28 +734,42 @@ struct cmsg_with_pktinfo {
 class posix_udp_channel : public udp_channel_impl {
 private:
     static constexpr int MAX_DATAGRAM_SIZE = 65507;
-    struct recv_ctx {
-        struct msghdr _hdr;
+    // Messages coalesced by GRO may be a little larger than a datagram
+    static constexpr int MAX_RECEIVE_SIZE = 65536;
+    // Most messages passed to one recvmmsg() or sendmmsg() call
+    static constexpr size_t max_batch = 64;
+    // Most datagrams the kernel segments out of one UDP GSO message
+    static constexpr size_t max_gso_segments = 64;
+    struct recv_slot {
+        char* _buffer = nullptr;
         struct iovec _iov;
         socket_address _src_addr;
-        char* _buffer;
-        cmsg_with_pktinfo _cmsg;
-
-        recv_ctx() {
-            memset(&_hdr, 0, sizeof(_hdr));
-            _hdr.msg_iov = &_iov;
-            _hdr.msg_iovlen = 1;
-            _hdr.msg_name = &_src_addr.u.sa;
-            _hdr.msg_namelen = sizeof(_src_addr.u.sas);
-            memset(&_cmsg, 0, sizeof(_cmsg));
-            _hdr.msg_control = &_cmsg;
-            _hdr.msg_controllen = sizeof(_cmsg);
+        union {
+            struct cmsghdr _align;
+            char _data[CMSG_SPACE(sizeof(in6_pktinfo)) + CMSG_SPACE(sizeof(int))];
+        } _cmsg;
+
+        recv_slot() = default;
+        recv_slot(const recv_slot&) = delete;
+        ~recv_slot() {
+            delete[] _buffer;
         }
 
-        void prepare() {
-            _buffer = new char[MAX_DATAGRAM_SIZE];
+        // The buffer of a slot whose datagram was received is handed over to
+        // the datagram, so a new one is only allocated for those slots.
+        void prepare(struct msghdr& hdr) {
+            if (!_buffer) {
+                _buffer = new char[MAX_RECEIVE_SIZE];
+            }
             _iov.iov_base = _buffer;
-            _iov.iov_len = MAX_DATAGRAM_SIZE;
+            _iov.iov_len = MAX_RECEIVE_SIZE;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_iov = &_iov;
+            hdr.msg_iovlen = 1;
+            hdr.msg_name = &_src_addr.u.sa;
+            hdr.msg_namelen = sizeof(_src_addr.u.sas);
+            hdr.msg_control = &_cmsg;
+            hdr.msg_controllen = sizeof(_cmsg);
         }
     };
     struct send_ctx {
@@ -737,28 +794,133 @@ class posix_udp_channel : public udp_channel_impl {
             resolve_outgoing_address(_dst);
         }
     };
+    struct send_batch_ctx {
+        union segment_cmsg {
+            struct cmsghdr _align;
+            char _data[CMSG_SPACE(sizeof(uint16_t))];
+        };
+        std::vector<std::pair<socket_address, packet>> _datagrams;
+        std::vector<struct mmsghdr> _hdrs;
+        std::vector<struct iovec> _iovecs;
+        std::vector<segment_cmsg> _cmsgs;
+        // Index in _datagrams of the first datagram of each message
+        std::vector<size_t> _first;
+
+        explicit send_batch_ctx(std::vector<std::pair<socket_address, packet>> datagrams)
+            : _datagrams(std::move(datagrams)) {
+            for (auto&& d : _datagrams) {
+                resolve_outgoing_address(d.first);
+            }
+        }
+
+        size_t datagrams_in(size_t msg) const {
+            return (msg + 1 < _first.size() ? _first[msg + 1] : _datagrams.size()) - _first[msg];
+        }
+
+        // Prepares the messages for the datagrams starting at \c from. With
+        // \c gso, runs of datagrams to the same destination which are all of
+        // the same size, except maybe for a shorter last one, are sent as a
+        // single message for the kernel to segment.
+        void build(size_t from, bool gso) {
+            _hdrs.clear();
+            _iovecs.clear();
+            _cmsgs.clear();
+            _first.clear();
+            size_t frags = 0;
+            for (size_t i = from; i < _datagrams.size(); ++i) {
+                frags += _datagrams[i].second.nr_frags();
+            }
+            // Messages point into these, so they must not reallocate
+            _iovecs.reserve(frags);
+            _cmsgs.reserve(std::min(_datagrams.size() - from, max_batch));
+            size_t i = from;
+            while (i < _datagrams.size() && _hdrs.size() < max_batch) {
+                auto& dst = _datagrams[i].first;
+                auto seg = _datagrams[i].second.len();
+                auto total = seg;
+                auto nr_frags = _datagrams[i].second.nr_frags();
+                auto j = i + 1;
+                while (gso && seg && j < _datagrams.size() && j - i < max_gso_segments) {
+                    auto& next = _datagrams[j];
+                    if (!(next.first == dst) || !next.second.len() || next.second.len() > seg
+                            || total + next.second.len() > MAX_DATAGRAM_SIZE || nr_frags + next.second.nr_frags() > IOV_MAX) {
+                        break;
+                    }
+                    total += next.second.len();
+                    nr_frags += next.second.nr_frags();
+                    ++j;
+                    if (next.second.len() < seg) {
+                        break;
+                    }
+                }
+                struct mmsghdr m;
+                memset(&m, 0, sizeof(m));
+                m.msg_hdr.msg_name = &dst.u.sa;
+                m.msg_hdr.msg_namelen = dst.addr_length;
+                m.msg_hdr.msg_iov = _iovecs.data() + _iovecs.size();
+                m.msg_hdr.msg_iovlen = nr_frags;
+                for (auto k = i; k < j; ++k) {
+                    for (auto&& f : _datagrams[k].second.fragments()) {
+                        _iovecs.push_back({.iov_base = f.base, .iov_len = f.size});
+                    }
+                }
+                if (j - i > 1) {
+                    _cmsgs.emplace_back();
+                    m.msg_hdr.msg_control = &_cmsgs.back();
+                    m.msg_hdr.msg_controllen = sizeof(segment_cmsg);
+                    auto cm = CMSG_FIRSTHDR(&m.msg_hdr);
+                    cm->cmsg_level = SOL_UDP;
+                    cm->cmsg_type = UDP_SEGMENT;
+                    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                    uint16_t size = seg;
+                    memcpy(CMSG_DATA(cm), &size, sizeof(size));
+                }
+                _hdrs.push_back(m);
+                _first.push_back(i);
+                i = j;
+            }
+        }
+    };
     pollable_fd _fd;
     socket_address _address;
-    recv_ctx _recv;
+    std::vector<recv_slot> _recv;
+    std::vector<struct mmsghdr> _recv_hdrs;
+    // Datagrams received but not returned yet, as a message coalesced by
+    // UDP GRO or a batch may hold more than asked for
+    std::deque<udp_datagram> _received;
     send_ctx _send;
+    bool _gso = false;
     bool _closed;
+private:
+    void add_received(recv_slot& slot, struct msghdr& hdr, size_t size);
+    std::vector<udp_datagram> take_received(size_t max);
 public:
     posix_udp_channel(const socket_address& bind_address)
-            : _closed(false) {
+            : _recv(max_batch)
+            , _recv_hdrs(max_batch)
+            , _closed(false) {
         auto sa = bind_address.is_unspecified() ? socket_address(inet_address(inet_address::family::INET)) : bind_address;
         file_desc fd = file_desc::socket(sa.u.sa.sa_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
         fd.setsockopt(SOL_IP, IP_PKTINFO, true);
         if (engine().posix_reuseport_available()) {
             fd.setsockopt(SOL_SOCKET, SO_REUSEPORT, 1);
         }
+        // Both are best effort: kernels before 4.18 and 5.0 do not have them
+        int one = 1;
+        ::setsockopt(fd.get(), SOL_UDP, UDP_GRO, &one, sizeof(one));
+        int segment_size;
+        socklen_t len = sizeof(segment_size);
+        _gso = ::getsockopt(fd.get(), SOL_UDP, UDP_SEGMENT, &segment_size, &len) == 0;
         fd.bind(sa.u.sa, sizeof(sa.u.sas));
         _address = fd.get_address();
         _fd = std::move(fd);
     }
     virtual ~posix_udp_channel() { if (!_closed) close(); };
     virtual future<udp_datagram> receive() override;
+    virtual future<std::vector<udp_datagram>> receive_batch(size_t max) override;
     virtual future<> send(const socket_address& dst, const char *msg) override;
     virtual future<> send(const socket_address& dst, packet p) override;
+    virtual future<> send_batch(std::vector<std::pair<socket_address, packet>> datagrams) override;
     virtual void shutdown_input() override {
         _fd.abort_reader();
     }
@@ -791,6 +953,35 @@ future<> posix_udp_channel::send(const socket_address& dst, packet p) {
             .then([len] (size_t size) { assert(size == len); });
 }
 
+future<> posix_udp_channel::send_batch(std::vector<std::pair<socket_address, packet>> datagrams) {
+    return do_with(send_batch_ctx(std::move(datagrams)), [this] (send_batch_ctx& ctx) {
+        ctx.build(0, _gso);
+        return repeat([this, &ctx] {
+            if (ctx._hdrs.empty()) {
+                return make_ready_future<stop_iteration>(stop_iteration::yes);
+            }
+            return _fd.sendmmsg(ctx._hdrs.data(), ctx._hdrs.size()).then_wrapped([this, &ctx] (future<size_t> f) {
+                size_t next;
+                try {
+                    auto sent = f.get0();
+                    next = sent < ctx._first.size() ? ctx._first[sent] : ctx._datagrams.size();
+                } catch (std::system_error&) {
+                    // The first message failed. If the kernel could not
+                    // segment it, e.g. because its datagrams exceed the
+                    // path MTU, send them one by one from now on.
+                    if (ctx.datagrams_in(0) == 1) {
+                        throw;
+                    }
+                    _gso = false;
+                    next = ctx._first[0];
+                }
+                ctx.build(next, _gso);
+                return stop_iteration::no;
+            });
+        });
+    });
+}
+
 udp_channel
 posix_network_stack::make_udp_channel(const socket_address& addr) {
     return udp_channel(std::make_unique<posix_udp_channel>(addr));
@@ -823,25 +1014,65 @@ class posix_datagram : public udp_datagram_impl {
     virtual packet& get_data() override { return _p; }
 };
 
+void posix_udp_channel::add_received(recv_slot& slot, struct msghdr& hdr, size_t size) {
+    socket_address dst;
+    size_t segment = 0;
+    for (auto* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+            dst = ipv4_addr(copy_reinterpret_cast<in_pktinfo>(CMSG_DATA(cmsg)).ipi_addr, _address.port());
+        } else if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO) {
+            dst = ipv6_addr(copy_reinterpret_cast<in6_pktinfo>(CMSG_DATA(cmsg)).ipi6_addr, _address.port());
+        } else if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            segment = copy_reinterpret_cast<int>(CMSG_DATA(cmsg));
+        }
+    }
+    auto buf = std::exchange(slot._buffer, nullptr);
+    auto del = make_deleter([buf] { delete[] buf; });
+    // A message coalesced by GRO holds datagrams of the segment size, the
+    // last of which may be shorter.
+    if (!segment) {
+        segment = size;
+    }
+    size_t offset = 0;
+    do {
+        auto len = std::min(segment, size - offset);
+        _received.emplace_back(std::make_unique<posix_datagram>(
+            slot._src_addr, dst, packet(fragment{buf + offset, len}, del.share())));
+        offset += len;
+    } while (offset < size);
+}
+
+std::vector<udp_datagram> posix_udp_channel::take_received(size_t max) {
+    std::vector<udp_datagram> ret;
+    ret.reserve(std::min(max, _received.size()));
+    while (ret.size() < max && !_received.empty()) {
+        ret.push_back(std::move(_received.front()));
+        _received.pop_front();
+    }
+    return ret;
+}
+
+future<std::vector<udp_datagram>>
+posix_udp_channel::receive_batch(size_t max) {
+    if (!_received.empty()) {
+        return make_ready_future<std::vector<udp_datagram>>(take_received(max));
+    }
+    auto n = std::max<size_t>(1, std::min(max, max_batch));
+    for (size_t i = 0; i < n; ++i) {
+        _recv[i].prepare(_recv_hdrs[i].msg_hdr);
+    }
+    return _fd.recvmmsg(_recv_hdrs.data(), n).then([this, max] (size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            add_received(_recv[i], _recv_hdrs[i].msg_hdr, _recv_hdrs[i].msg_len);
+        }
+        return take_received(max);
+    });
+}
+
 future<udp_datagram>
 posix_udp_channel::receive() {
-    _recv.prepare();
-    return _fd.recvmsg(&_recv._hdr).then([this] (size_t size) {
-        socket_address dst;
-        for (auto* cmsg = CMSG_FIRSTHDR(&_recv._hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&_recv._hdr, cmsg)) {
-            if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
-                dst = ipv4_addr(copy_reinterpret_cast<in_pktinfo>(CMSG_DATA(cmsg)).ipi_addr, _address.port());
-                break;
-            } else if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO) {
-                dst = ipv6_addr(copy_reinterpret_cast<in6_pktinfo>(CMSG_DATA(cmsg)).ipi6_addr, _address.port());
-                break;
-            }
-        }
-        return make_ready_future<udp_datagram>(udp_datagram(std::make_unique<posix_datagram>(
-            _recv._src_addr, dst, packet(fragment{_recv._buffer, size}, make_deleter([buf = _recv._buffer] { delete[] buf; })))));
-    }).handle_exception([p = _recv._buffer](auto ep) {
-        delete[] p;
-        return make_exception_future<udp_datagram>(std::move(ep));
+    return receive_batch(1).then([] (std::vector<udp_datagram> dgrams) {
+        return std::move(dgrams.front());
     });
 }
 
@@ -21,6 +21,8 @@
 
 #include <seastar/net/stack.hh>
 #include <seastar/net/inet_address.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/do_with.hh>
 
 namespace seastar {
 
@@ -44,6 +46,10 @@ future<net::udp_datagram> net::udp_channel::receive() {
     return _impl->receive();
 }
 
+future<std::vector<net::udp_datagram>> net::udp_channel::receive_batch(size_t max) {
+    return _impl->receive_batch(max);
+}
+
 future<> net::udp_channel::send(const socket_address& dst, const char* msg) {
     return _impl->send(dst, msg);
 }
@@ -52,6 +58,26 @@ future<> net::udp_channel::send(const socket_address& dst, packet p) {
     return _impl->send(dst, std::move(p));
 }
 
+future<> net::udp_channel::send_batch(std::vector<std::pair<socket_address, packet>> datagrams) {
+    return _impl->send_batch(std::move(datagrams));
+}
+
+future<std::vector<net::udp_datagram>> net::udp_channel_impl::receive_batch(size_t max) {
+    return receive().then([] (udp_datagram dgram) {
+        std::vector<udp_datagram> ret;
+        ret.push_back(std::move(dgram));
+        return ret;
+    });
+}
+
+future<> net::udp_channel_impl::send_batch(std::vector<std::pair<socket_address, packet>> datagrams) {
+    return do_with(std::move(datagrams), [this] (std::vector<std::pair<socket_address, packet>>& datagrams) {
+        return do_for_each(datagrams, [this] (std::pair<socket_address, packet>& d) {
+            return send(d.first, std::move(d.second));
+        });
+    });
+}
+
 bool net::udp_channel::is_closed() const {
     return _impl->is_closed();
 }
@@ -111,6 +137,21 @@ void connected_socket::set_keepalive_parameters(const net::keepalive_params& p)
 net::keepalive_params connected_socket::get_keepalive_parameters() const {
     return _csi->get_keepalive_parameters();
 }
+void connected_socket::set_zero_copy_send(size_t threshold) {
+    _csi->set_zero_copy_send(threshold);
+}
+
+void connected_socket::set_congestion_control(tcp_congestion_control cc) {
+    _csi->set_congestion_control(cc);
+}
+
+void connected_socket::set_pacing(bool pacing) {
+    _csi->set_pacing(pacing);
+}
+
+void connected_socket::set_rto_min(std::chrono::milliseconds rto_min) {
+    _csi->set_rto_min(rto_min);
+}
 
 void connected_socket::shutdown_output() {
     _csi->shutdown_output();
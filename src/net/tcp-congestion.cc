@@ -0,0 +1,321 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#include <seastar/net/tcp-congestion.hh>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace seastar {
+
+namespace net {
+
+uint64_t tcp_congestion_controller::pacing_rate(uint32_t cwnd, uint32_t ssthresh, const tcp_congestion_event& ev) const {
+    if (!ev.rtt.count()) {
+        return 0;
+    }
+    auto srtt = std::chrono::duration<double>(std::max(ev.srtt, std::chrono::milliseconds(1))).count();
+    return (cwnd < ssthresh ? 2 : 1.2) * cwnd / srtt;
+}
+
+namespace {
+
+class reno_congestion_controller final : public tcp_congestion_controller {
+public:
+    virtual void on_ack(uint32_t& cwnd, uint32_t ssthresh, const tcp_congestion_event& ev) override {
+        uint32_t smss = ev.mss;
+        if (cwnd < ssthresh) {
+            // In slow start phase
+            cwnd += std::min(ev.acked_bytes, smss);
+        } else {
+            // In congestion avoidance phase
+            uint32_t round_up = 1;
+            cwnd += std::max(round_up, smss * smss / cwnd);
+        }
+    }
+    virtual uint32_t on_loss(uint32_t cwnd, const tcp_congestion_event& ev, bool timeout) override {
+        return std::max(ev.in_flight / 2, 2 * uint32_t(ev.mss));
+    }
+};
+
+// CUBIC per RFC8312. After a loss the window grows along a cubic function
+// of the time since the loss, which is centered on the window the loss
+// happened at, so it quickly returns there, stays there for a while, and
+// then probes for more bandwidth; this does not depend on the RTT and
+// fills long, fat pipes much faster than Reno does.
+class cubic_congestion_controller final : public tcp_congestion_controller {
+    // In segments per second cubed
+    static constexpr double c = 0.4;
+    static constexpr double beta = 0.7;
+    // Growth of the Reno friendly window per RTT, in segments
+    static constexpr double alpha = 3 * (1 - beta) / (1 + beta);
+
+    // Window at the last loss and the time it takes to get back there, in
+    // segments and seconds
+    double _w_max = 0;
+    double _k = 0;
+    // The window Reno would have, in segments
+    double _w_est = 0;
+    bool _epoch_started = false;
+    lowres_clock::time_point _epoch_start;
+    // Fraction of a byte by which the window grew
+    double _carry = 0;
+public:
+    virtual void on_ack(uint32_t& cwnd, uint32_t ssthresh, const tcp_congestion_event& ev) override {
+        if (cwnd < ssthresh) {
+            cwnd += std::min(ev.acked_bytes, uint32_t(ev.mss));
+            return;
+        }
+        double mss = ev.mss;
+        double w = cwnd / mss;
+        if (!_epoch_started) {
+            _epoch_started = true;
+            _epoch_start = ev.now;
+            if (w < _w_max) {
+                _k = std::cbrt((_w_max - w) / c);
+            } else {
+                _k = 0;
+                _w_max = w;
+            }
+            _w_est = w;
+        }
+        // Aim at the window the cubic function gives one RTT from now
+        auto t = std::chrono::duration<double>(ev.now - _epoch_start + ev.srtt).count();
+        auto w_cubic = c * std::pow(t - _k, 3) + _w_max;
+        _w_est += alpha * (ev.acked_bytes / mss) / w;
+        double target;
+        if (w_cubic < _w_est) {
+            // Reno friendly region
+            target = _w_est;
+        } else {
+            target = std::min(w_cubic, 1.5 * w);
+        }
+        if (target > w) {
+            _carry += (target - w) / w * ev.acked_bytes;
+            auto inc = uint32_t(_carry);
+            cwnd += inc;
+            _carry -= inc;
+        }
+    }
+    virtual uint32_t on_loss(uint32_t cwnd, const tcp_congestion_event& ev, bool timeout) override {
+        double w = double(cwnd) / ev.mss;
+        // Fast convergence: a flow whose window stopped growing releases
+        // some bandwidth to newcomers
+        _w_max = w < _w_max ? w * (1 + beta) / 2 : w;
+        _epoch_started = false;
+        _carry = 0;
+        return std::max(uint32_t(cwnd * beta), 2 * uint32_t(ev.mss));
+    }
+};
+
+// A model based controller after BBR. It estimates the bottleneck bandwidth
+// as the maximum delivery rate over the last rounds and the propagation
+// delay as the minimum RTT over the last seconds, and keeps about twice
+// their product in flight; losses do not shrink the window.
+//
+// Rates are measured over whole round trips with the connection's
+// millisecond clock, so the model is meant for paths with RTTs of several
+// milliseconds and more.
+class bbr_congestion_controller final : public tcp_congestion_controller {
+    enum class mode { startup, drain, probe_bw, probe_rtt };
+    // 2/ln(2), the smallest gain which doubles the delivery rate every round
+    static constexpr double high_gain = 2.885;
+    static constexpr double cwnd_gain = 2;
+    static constexpr unsigned bw_window_rounds = 10;
+    static constexpr unsigned min_cwnd_segments = 4;
+    static constexpr std::chrono::seconds min_rtt_window{10};
+    static constexpr std::chrono::milliseconds probe_rtt_duration{200};
+    // Pacing gains of the phases of probe_bw, each lasting a min RTT: probe
+    // for more bandwidth, drain the queue this may have built, then cruise
+    static constexpr std::array<double, 8> probe_bw_gains{{1.25, 0.75, 1, 1, 1, 1, 1, 1}};
+
+    mode _mode = mode::startup;
+    // Delivery rate of each of the last rounds, in bytes per second
+    std::array<uint64_t, bw_window_rounds> _bw_samples{};
+    uint64_t _btl_bw = 0;
+    uint64_t _round = 0;
+    uint64_t _round_start_delivered = 0;
+    uint64_t _next_round_delivered = 0;
+    lowres_clock::time_point _round_start;
+    std::chrono::milliseconds _min_rtt{0};
+    lowres_clock::time_point _min_rtt_stamp;
+    // The pipe is full once the bandwidth did not grow by a quarter in
+    // three rounds
+    uint64_t _full_bw = 0;
+    unsigned _full_bw_rounds = 0;
+    bool _full_pipe = false;
+    lowres_clock::time_point _probe_rtt_done;
+    uint32_t _prior_cwnd = 0;
+    unsigned _cycle_index = 0;
+    lowres_clock::time_point _cycle_start;
+private:
+    uint32_t bdp() const {
+        return _btl_bw * std::chrono::duration<double>(_min_rtt).count();
+    }
+    // Returns true when the ACK ends a round trip, the delivery of all the
+    // data that was in flight when the round started
+    bool end_round(const tcp_congestion_event& ev) {
+        if (ev.delivered < _next_round_delivered) {
+            return false;
+        }
+        auto elapsed = std::chrono::duration<double>(ev.now - _round_start).count();
+        if (_round && elapsed > 0) {
+            _bw_samples[_round % bw_window_rounds] = (ev.delivered - _round_start_delivered) / elapsed;
+            _btl_bw = *std::max_element(_bw_samples.begin(), _bw_samples.end());
+        }
+        _round++;
+        _bw_samples[_round % bw_window_rounds] = 0;
+        _round_start = ev.now;
+        _round_start_delivered = ev.delivered;
+        _next_round_delivered = ev.delivered + ev.in_flight;
+        return true;
+    }
+    void enter_probe_bw(lowres_clock::time_point now) {
+        _mode = mode::probe_bw;
+        // Start cruising rather than draining
+        _cycle_index = 2;
+        _cycle_start = now;
+    }
+    void check_full_pipe() {
+        if (_btl_bw >= _full_bw * 5 / 4) {
+            _full_bw = _btl_bw;
+            _full_bw_rounds = 0;
+        } else if (++_full_bw_rounds >= 3) {
+            _full_pipe = true;
+        }
+    }
+public:
+    virtual void on_ack(uint32_t& cwnd, uint32_t ssthresh, const tcp_congestion_event& ev) override {
+        if (end_round(ev) && !_full_pipe) {
+            check_full_pipe();
+        }
+        bool min_rtt_expired = ev.now - _min_rtt_stamp > min_rtt_window;
+        if (ev.rtt.count() && (!_min_rtt.count() || ev.rtt < _min_rtt || (min_rtt_expired && _mode != mode::probe_rtt))) {
+            _min_rtt = ev.rtt;
+            _min_rtt_stamp = ev.now;
+            min_rtt_expired = false;
+        }
+
+        switch (_mode) {
+        case mode::startup:
+            if (_full_pipe) {
+                _mode = mode::drain;
+            }
+            break;
+        case mode::drain:
+            if (ev.in_flight <= bdp()) {
+                enter_probe_bw(ev.now);
+            }
+            break;
+        case mode::probe_bw:
+            if (ev.now - _cycle_start > _min_rtt) {
+                _cycle_index = (_cycle_index + 1) % probe_bw_gains.size();
+                _cycle_start = ev.now;
+            }
+            break;
+        case mode::probe_rtt:
+            if (ev.now >= _probe_rtt_done) {
+                _min_rtt_stamp = ev.now;
+                if (_full_pipe) {
+                    enter_probe_bw(ev.now);
+                } else {
+                    _mode = mode::startup;
+                }
+                cwnd = std::max(cwnd, _prior_cwnd);
+            }
+            break;
+        }
+        // Drain the queues every few seconds to see the propagation delay
+        if (min_rtt_expired && _min_rtt.count() && _mode != mode::probe_rtt) {
+            _mode = mode::probe_rtt;
+            _prior_cwnd = cwnd;
+            _probe_rtt_done = ev.now + std::max<std::chrono::milliseconds>(probe_rtt_duration, _min_rtt);
+        }
+
+        uint32_t min_cwnd = min_cwnd_segments * ev.mss;
+        if (_mode == mode::probe_rtt) {
+            cwnd = min_cwnd;
+            return;
+        }
+        if (!_btl_bw || !_min_rtt.count()) {
+            // No model yet, grow as in slow start
+            cwnd += ev.acked_bytes;
+        } else {
+            // Draining the queue built in startup means keeping no more
+            // than the BDP in flight
+            double gain = _mode == mode::startup ? high_gain : _mode == mode::drain ? 1 : cwnd_gain;
+            auto target = std::max(uint32_t(gain * bdp()), min_cwnd);
+            if (_full_pipe) {
+                cwnd = std::min(cwnd + ev.acked_bytes, target);
+            } else if (cwnd < target) {
+                cwnd += ev.acked_bytes;
+            }
+        }
+        cwnd = std::max(cwnd, min_cwnd);
+    }
+    virtual uint32_t on_loss(uint32_t cwnd, const tcp_congestion_event& ev, bool timeout) override {
+        // Loss is not taken as a sign of congestion
+        return std::max(cwnd, min_cwnd_segments * ev.mss);
+    }
+    virtual uint64_t pacing_rate(uint32_t cwnd, uint32_t ssthresh, const tcp_congestion_event& ev) const override {
+        if (!_btl_bw) {
+            return tcp_congestion_controller::pacing_rate(cwnd, ssthresh, ev);
+        }
+        double gain;
+        switch (_mode) {
+        case mode::startup:
+            gain = high_gain;
+            break;
+        case mode::drain:
+            gain = 1 / high_gain;
+            break;
+        case mode::probe_bw:
+            gain = probe_bw_gains[_cycle_index];
+            break;
+        case mode::probe_rtt:
+            gain = 1;
+            break;
+        }
+        return gain * _btl_bw;
+    }
+};
+
+constexpr std::chrono::seconds bbr_congestion_controller::min_rtt_window;
+constexpr std::chrono::milliseconds bbr_congestion_controller::probe_rtt_duration;
+constexpr std::array<double, 8> bbr_congestion_controller::probe_bw_gains;
+
+}
+
+std::unique_ptr<tcp_congestion_controller> make_tcp_congestion_controller(tcp_congestion_control cc) {
+    switch (cc) {
+    case tcp_congestion_control::reno:
+        return std::make_unique<reno_congestion_controller>();
+    case tcp_congestion_control::cubic:
+        return std::make_unique<cubic_congestion_controller>();
+    case tcp_congestion_control::bbr:
+        return std::make_unique<bbr_congestion_controller>();
+    }
+    abort();
+}
+
+}
+
+}
@@ -59,6 +59,11 @@ void tcp_option::parse(uint8_t* beg1, uint8_t* end1) {
             _sack_received = true;
             beg += option_len::sack;
             break;
+        case option_kind::timestamps:
+            _timestamps_received = true;
+            _ts_recent = timestamps::read(beg).t1;
+            beg += option_len::timestamps;
+            break;
         case option_kind::nop:
             beg += option_len::nop;
             break;
@@ -77,6 +82,51 @@ void tcp_option::parse(uint8_t* beg1, uint8_t* end1) {
     }
 }
 
+// Returns the option of the given kind, or nullptr if there is none
+static const char* find_option(uint8_t* beg1, uint8_t* end1, tcp_option::option_kind wanted) {
+    using option_kind = tcp_option::option_kind;
+    using option_len = tcp_option::option_len;
+    const char* beg = reinterpret_cast<const char*>(beg1);
+    const char* end = reinterpret_cast<const char*>(end1);
+    while (beg < end) {
+        auto kind = option_kind(*beg);
+        if (kind == option_kind::eol) {
+            break;
+        }
+        if (kind == option_kind::nop) {
+            beg += option_len::nop;
+            continue;
+        }
+        if (beg + 1 >= end) {
+            break;
+        }
+        auto len = uint8_t(beg[1]);
+        // Prevent infinite loop and make sure there is enough room for this option
+        if (len < 2 || beg + len > end) {
+            break;
+        }
+        if (kind == wanted) {
+            return beg;
+        }
+        beg += len;
+    }
+    return nullptr;
+}
+
+tcp_option::sack_blocks tcp_option::parse_sack_blocks(uint8_t* beg, uint8_t* end) {
+    auto p = find_option(beg, end, option_kind::sack_blocks);
+    return p ? sack_blocks::read(p) : sack_blocks();
+}
+
+bool tcp_option::parse_timestamps(uint8_t* beg, uint8_t* end, timestamps& ts) {
+    auto p = find_option(beg, end, option_kind::timestamps);
+    if (!p || uint8_t(p[1]) != uint8_t(option_len::timestamps)) {
+        return false;
+    }
+    ts = timestamps::read(p);
+    return true;
+}
+
 uint8_t tcp_option::fill(void* h, const tcp_hdr* th, uint8_t options_size) {
     auto hdr = reinterpret_cast<char*>(h);
     auto off = hdr + tcp_hdr::len;
@@ -99,6 +149,25 @@ uint8_t tcp_option::fill(void* h, const tcp_hdr* th, uint8_t options_size) {
             off += win_scale.len;
             size += win_scale.len;
         }
+        if (_sack_received || !ack_on) {
+            auto sack = tcp_option::sack();
+            sack.write(off);
+            off += sack.len;
+            size += sack.len;
+        }
+    }
+    if (timestamps_on(syn_on, ack_on)) {
+        auto ts = tcp_option::timestamps();
+        ts.t1 = _local_ts_val;
+        ts.t2 = _ts_recent;
+        ts.write(off);
+        off += ts.len;
+        size += ts.len;
+    }
+    if (_local_sack.nr) {
+        _local_sack.write(off);
+        off += _local_sack.size();
+        size += _local_sack.size();
     }
     if (size > 0) {
         // Insert NOP option
@@ -127,7 +196,14 @@ uint8_t tcp_option::get_size(bool syn_on, bool ack_on) {
         if (_win_scale_received || !ack_on) {
             size += option_len::win_scale;
         }
+        if (_sack_received || !ack_on) {
+            size += option_len::sack;
+        }
+    }
+    if (timestamps_on(syn_on, ack_on)) {
+        size += option_len::timestamps;
     }
+    size += _local_sack.size();
     if (size > 0) {
         size += option_len::eol;
         // Insert NOP option to align on 32-bit
@@ -0,0 +1,174 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#include <random>
+#include <vector>
+
+#include <seastar/core/timer-set.hh>
+#include <seastar/core/timer-wheel.hh>
+#include <seastar/testing/perf_tests.hh>
+
+namespace {
+
+struct churn_timer {
+    using clock = seastar::steady_clock_type;
+    using time_point = clock::time_point;
+    using duration = clock::duration;
+
+    boost::intrusive::list_member_hook<> link;
+    time_point expiry;
+    bool armed = false;
+
+    time_point get_timeout() const { return expiry; }
+    void cancel() { armed = false; }
+};
+
+// Models a shard with many idle-connection and RPC timeouts, most of
+// which are pushed back or cancelled before they fire, while time moves
+// forward by a millisecond between batches. Timers are picked at random
+// since connections are not rearmed in the order they were created.
+template <typename Container>
+class timer_churn {
+    static constexpr size_t n_timers = 200000;
+    static constexpr size_t batch = 1000;
+
+    std::vector<churn_timer> _timers{n_timers};
+    Container _container;
+    std::default_random_engine _rnd{42};
+    std::uniform_int_distribution<size_t> _pick{0, n_timers - 1};
+    std::uniform_int_distribution<int64_t> _delay;
+    churn_timer::time_point _now = churn_timer::time_point(std::chrono::hours(1));
+public:
+    explicit timer_churn(std::chrono::nanoseconds min_delay, std::chrono::nanoseconds max_delay)
+        : _delay(min_delay.count(), max_delay.count()) {
+        for (auto& t : _timers) {
+            arm(t);
+        }
+    }
+
+    ~timer_churn() {
+        _container.clear();
+    }
+
+    void arm(churn_timer& t) {
+        t.expiry = _now + churn_timer::duration(_delay(_rnd));
+        t.armed = true;
+        _container.insert(t);
+    }
+
+    void disarm(churn_timer& t) {
+        if (t.armed) {
+            _container.remove(t);
+            t.armed = false;
+        }
+    }
+
+    size_t rearm() {
+        for (size_t i = 0; i < batch; ++i) {
+            auto& t = _timers[_pick(_rnd)];
+            disarm(t);
+            arm(t);
+        }
+        return batch;
+    }
+
+    size_t cancel_and_expire() {
+        for (size_t i = 0; i < batch; ++i) {
+            auto& t = _timers[_pick(_rnd)];
+            disarm(t);
+            if (i % 8) {
+                arm(t);
+            }
+        }
+        _now += std::chrono::milliseconds(1);
+        auto expired = _container.expire(_now);
+        for (auto& t : expired) {
+            t.armed = false;
+        }
+        perf_tests::do_not_optimize(expired.size());
+        expired.clear();
+        perf_tests::do_not_optimize(_container.get_next_timeout());
+        return batch;
+    }
+};
+
+// Timeouts spread between a millisecond and half a minute.
+template <typename Container>
+struct mixed_timeouts : timer_churn<Container> {
+    mixed_timeouts() : timer_churn<Container>(std::chrono::milliseconds(1), std::chrono::seconds(30)) {}
+};
+
+// A single idle timeout for every connection, so that all timers
+// land within a millisecond of each other.
+template <typename Container>
+struct idle_timeouts : timer_churn<Container> {
+    idle_timeouts() : timer_churn<Container>(std::chrono::seconds(10), std::chrono::seconds(10) + std::chrono::milliseconds(1)) {}
+};
+
+using set_t = seastar::timer_set<churn_timer, &churn_timer::link>;
+using wheel_t = seastar::timer_wheel<churn_timer, &churn_timer::link>;
+
+using timer_set_mixed = mixed_timeouts<set_t>;
+using timer_wheel_mixed = mixed_timeouts<wheel_t>;
+using timer_set_idle = idle_timeouts<set_t>;
+using timer_wheel_idle = idle_timeouts<wheel_t>;
+
+}
+
+PERF_TEST_F(timer_set_mixed, rearm)
+{
+    return rearm();
+}
+
+PERF_TEST_F(timer_set_mixed, cancel_and_expire)
+{
+    return cancel_and_expire();
+}
+
+PERF_TEST_F(timer_wheel_mixed, rearm)
+{
+    return rearm();
+}
+
+PERF_TEST_F(timer_wheel_mixed, cancel_and_expire)
+{
+    return cancel_and_expire();
+}
+
+PERF_TEST_F(timer_set_idle, rearm)
+{
+    return rearm();
+}
+
+PERF_TEST_F(timer_set_idle, cancel_and_expire)
+{
+    return cancel_and_expire();
+}
+
+PERF_TEST_F(timer_wheel_idle, rearm)
+{
+    return rearm();
+}
+
+PERF_TEST_F(timer_wheel_idle, cancel_and_expire)
+{
+    return cancel_and_expire();
+}
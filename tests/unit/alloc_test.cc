@@ -24,6 +24,9 @@
 #include <seastar/core/smp.hh>
 #include <seastar/core/temporary_buffer.hh>
 #include <vector>
+#include <sstream>
+#include <cstdio>
+#include <array>
 
 using namespace seastar;
 
@@ -69,6 +72,158 @@ SEASTAR_TEST_CASE(test_live_objects_counter_with_cross_cpu_free) {
     });
 }
 
+SEASTAR_TEST_CASE(test_cross_shard_free_statistics) {
+#ifndef SEASTAR_DEFAULT_ALLOCATOR
+    auto before = memory::cross_shard_frees(1);
+    auto total_before = memory::stats().cross_cpu_frees();
+    return smp::submit_to(1, [] {
+        auto ret = std::vector<std::unique_ptr<int>>(1000);
+        for (auto& o : ret) {
+            o = std::make_unique<int>(0);
+        }
+        return ret;
+    }).then([before, total_before] (auto&& vec) {
+        vec.clear(); // cause cross-cpu free
+        BOOST_REQUIRE_GE(memory::cross_shard_frees(1) - before, 1000u);
+        BOOST_REQUIRE_GE(memory::stats().cross_cpu_frees() - total_before, 1000u);
+        BOOST_REQUIRE_LE(memory::stats().cross_node_frees(), memory::stats().cross_cpu_frees());
+    });
+#else
+    return make_ready_future<>();
+#endif
+}
+
+SEASTAR_TEST_CASE(test_batched_cross_shard_free) {
+#ifndef SEASTAR_DEFAULT_ALLOCATOR
+    // Not a multiple of the batch size, so some of the objects are left
+    // in a partial batch on this shard until it is flushed.
+    static constexpr size_t nr = 1001;
+    return smp::submit_to(1, [] {
+        auto drained = memory::stats().cross_cpu_drained_objects();
+        auto ret = std::vector<std::unique_ptr<int>>(nr);
+        for (auto& o : ret) {
+            o = std::make_unique<int>(0);
+        }
+        return std::make_pair(std::move(ret), drained);
+    }).then([] (auto&& p) {
+        memory::flush_cross_cpu_frees();
+        auto before = memory::cross_shard_frees(1);
+        for (auto& o : p.first) {
+            o.reset(); // cause cross-cpu free
+        }
+        BOOST_REQUIRE_EQUAL(memory::cross_shard_frees(1) - before, nr);
+        BOOST_REQUIRE(memory::flush_cross_cpu_frees());
+        BOOST_REQUIRE(!memory::flush_cross_cpu_frees());
+        return smp::submit_to(1, [drained = p.second] {
+            memory::drain_cross_cpu_freelist();
+            return memory::stats().cross_cpu_drained_objects() - drained;
+        }).then([] (uint64_t drained) {
+            BOOST_REQUIRE_GE(drained, nr);
+        });
+    });
+#else
+    return make_ready_future<>();
+#endif
+}
+
+SEASTAR_TEST_CASE(test_sampled_heap_profile) {
+#if defined(SEASTAR_HEAPPROF) && !defined(SEASTAR_DEFAULT_ALLOCATOR)
+    static constexpr size_t interval = 4096;
+    static constexpr size_t nr = 4000;
+    static constexpr size_t size = 1024;
+    memory::set_heap_profiling_sampling_interval(interval);
+    BOOST_REQUIRE_EQUAL(memory::get_heap_profiling_sampling_interval(), interval);
+    std::ostringstream os;
+    {
+        memory::scoped_heap_profiling profiling;
+        auto objects = std::vector<std::unique_ptr<std::array<char, size>>>(nr);
+        for (auto& o : objects) {
+            o = std::make_unique<std::array<char, size>>();
+        }
+        memory::dump_heap_profile(os);
+    }
+    memory::set_heap_profiling_sampling_interval(0);
+
+    auto profile = os.str();
+    size_t count, bytes, total_count, total_bytes, sampling_interval;
+    BOOST_REQUIRE_EQUAL(sscanf(profile.c_str(), "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu",
+            &count, &bytes, &total_count, &total_bytes, &sampling_interval), 5);
+    BOOST_REQUIRE_EQUAL(sampling_interval, interval);
+    // Each object is sampled with probability 1 - exp(-size / interval),
+    // about 0.22, so about 880 of them are recorded. The bounds are many
+    // standard deviations away.
+    BOOST_REQUIRE_GE(total_count, 600u);
+    BOOST_REQUIRE_LE(total_count, 1200u);
+    BOOST_REQUIRE_LE(count, total_count);
+    BOOST_REQUIRE_GE(total_bytes, 600u * size);
+    // The allocation sites follow, with their backtraces
+    auto site = profile.find("\n", 1);
+    BOOST_REQUIRE(site != std::string::npos);
+    BOOST_REQUIRE(profile.find(" @ 0x", site) != std::string::npos);
+    BOOST_REQUIRE(profile.find("\nMAPPED_LIBRARIES:\n") != std::string::npos);
+#endif
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_size_class_statistics) {
+#ifndef SEASTAR_DEFAULT_ALLOCATOR
+    auto snapshot = [] {
+        std::vector<memory::size_class_statistics> ret;
+        for (unsigned idx = 0; idx < memory::size_classes(); ++idx) {
+            ret.push_back(memory::size_class_stats(idx));
+        }
+        return ret;
+    };
+    auto before = snapshot();
+    auto objects = std::vector<std::unique_ptr<std::array<char, 100>>>(1000);
+    for (auto& o : objects) {
+        o = std::make_unique<std::array<char, 100>>();
+    }
+    auto allocated = snapshot();
+    // The size class serving the objects is the one which grew the most.
+    unsigned idx = 0;
+    for (unsigned i = 0; i < allocated.size(); ++i) {
+        if (allocated[i].allocs - before[i].allocs > allocated[idx].allocs - before[idx].allocs) {
+            idx = i;
+        }
+    }
+    BOOST_REQUIRE_GE(allocated[idx].object_size, 100u);
+    BOOST_REQUIRE_GE(allocated[idx].allocs - before[idx].allocs, 1000u);
+    BOOST_REQUIRE_GE(allocated[idx].live_objects(), 1000u);
+    BOOST_REQUIRE_GE(allocated[idx].requested_bytes - before[idx].requested_bytes, 1000u * 100);
+    BOOST_REQUIRE_LE(allocated[idx].live_objects() * allocated[idx].object_size, allocated[idx].pages_in_use * memory::page_size);
+    objects.clear();
+    auto freed = snapshot();
+    BOOST_REQUIRE_GE(freed[idx].frees - allocated[idx].frees, 1000u);
+#endif
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_compaction) {
+#ifndef SEASTAR_DEFAULT_ALLOCATOR
+    auto before = memory::fragmentation_stats();
+    {
+        auto objects = std::vector<std::unique_ptr<std::array<char, 500>>>(100000);
+        for (auto& o : objects) {
+            o = std::make_unique<std::array<char, 500>>();
+        }
+        // Freed in allocation order, the free objects cached by the pool
+        // come from the last spans, which hold no other objects.
+        for (auto& o : objects) {
+            o.reset();
+        }
+    }
+    auto res = memory::compact();
+    auto after = memory::fragmentation_stats();
+    BOOST_REQUIRE_GT(res.spans_freed, 0u);
+    BOOST_REQUIRE_EQUAL(after.compactions, before.compactions + 1);
+    BOOST_REQUIRE_EQUAL(after.compacted_spans, before.compacted_spans + res.spans_freed);
+    BOOST_REQUIRE_LE(after.fragmented_free_memory, memory::stats().free_memory());
+    BOOST_REQUIRE_LE(after.released_memory, memory::stats().free_memory());
+#endif
+    return make_ready_future<>();
+}
+
 SEASTAR_TEST_CASE(test_aligned_alloc) {
     for (size_t align = sizeof(void*); align <= 65536; align <<= 1) {
         for (size_t size = align; size <= align * 2; size <<= 1) {
@@ -1,5 +1,7 @@
 #include <seastar/core/reactor.hh>
+#include <seastar/core/sleep.hh>
 #include <seastar/testing/test_case.hh>
+#include <seastar/testing/thread_test_case.hh>
 #include <seastar/testing/test_runner.hh>
 #include <seastar/net/ip.hh>
 
@@ -72,3 +74,40 @@ SEASTAR_TEST_CASE(test_accept_after_abort) {
         });
     });
 }
+
+SEASTAR_THREAD_TEST_CASE(test_zero_copy_send) {
+    std::default_random_engine& rnd = testing::local_random_engine;
+    auto distr = std::uniform_int_distribution<uint16_t>(12000, 65000);
+    auto sa = make_ipv4_address({"127.0.0.1", distr(rnd)});
+    auto listener = engine().net().listen(sa, listen_options());
+    auto accepted = listener.accept();
+    auto conn = engine().net().connect(sa).get0();
+    auto server = accepted.get0().connection;
+    conn.set_zero_copy_send(4096);
+
+    size_t size = 1 << 20;
+    temporary_buffer<char> buf(size);
+    for (size_t i = 0; i < size; ++i) {
+        buf.get_write()[i] = char(i * 7);
+    }
+    std::string expected(buf.get(), size);
+    bool released = false;
+    auto data = buf.get_write();
+    auto out = conn.output();
+    out.write(temporary_buffer<char>(data, size, make_deleter(buf.release(), [&released] { released = true; }))).get();
+    out.close().get();
+
+    auto in = server.input();
+    std::string received;
+    while (auto b = in.read().get0()) {
+        received.append(b.get(), b.size());
+    }
+    BOOST_REQUIRE(received == expected);
+
+    // The buffer is held until the kernel is done with it
+    for (int i = 0; i < 1000 && !released; ++i) {
+        sleep(std::chrono::milliseconds(1)).get();
+    }
+    BOOST_REQUIRE(released);
+    listener.abort_accept();
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+// A DMA buffer arena stays registered for the lifetime of the shard, so
+// this test has a binary of its own. It is run with
+// --reactor-backend=io_uring, to exercise registered buffers and files.
+
+#include <seastar/testing/thread_test_case.hh>
+#include <seastar/core/reactor.hh>
+#include <seastar/core/file.hh>
+#include <seastar/util/tmp_file.hh>
+#include "core/reactor_backend.hh"
+#include <sstream>
+
+using namespace seastar;
+
+static bool uring_in_use() {
+    for (auto&& rbs : reactor_backend_selector::available()) {
+        std::ostringstream name;
+        name << rbs;
+        if (name.str() == "io_uring") {
+            return true;
+        }
+    }
+    return false;
+}
+
+SEASTAR_THREAD_TEST_CASE(test_registered_dma_buffers) {
+    tmp_dir::do_with_thread([] (tmp_dir& t) {
+        static constexpr size_t buffer_size = 4096;
+        static constexpr size_t chunk_size = 4 * buffer_size;
+
+        engine().register_dma_buffer_arena(4 * chunk_size, chunk_size);
+
+        file_open_options options;
+        options.register_fd = true;
+        auto filename = (t.get_path() / "testfile.tmp").native();
+        auto f = open_file_dma(filename, open_flags::rw | open_flags::create, options).get0();
+        auto wbuf = temporary_buffer<char>::aligned(buffer_size, 2 * chunk_size);
+        for (size_t i = 0; i < wbuf.size(); i++) {
+            wbuf.get_write()[i] = char(i / buffer_size);
+        }
+        auto written = f.dma_write(0, wbuf.get(), wbuf.size()).get0();
+        BOOST_REQUIRE_EQUAL(written, wbuf.size());
+
+        auto stats = engine().get_io_stats();
+        // Fits a chunk, exhausts the arena, and falls back to the heap
+        std::vector<temporary_buffer<char>> held;
+        for (size_t pos = 0; pos < wbuf.size(); pos += buffer_size) {
+            for (auto i = 0; i < 2; i++) {
+                auto rbuf = f.dma_read_bulk<char>(pos, buffer_size).get0();
+                BOOST_REQUIRE_EQUAL(rbuf.size(), buffer_size);
+                BOOST_REQUIRE(std::equal(rbuf.begin(), rbuf.end(), wbuf.get() + pos));
+                held.push_back(std::move(rbuf));
+            }
+        }
+        auto fixed_buffer_ops = engine().get_io_stats().aio_fixed_buffer_ops - stats.aio_fixed_buffer_ops;
+        auto fixed_file_ops = engine().get_io_stats().aio_fixed_file_ops - stats.aio_fixed_file_ops;
+        if (uring_in_use()) {
+            // The arena holds four chunks, one per read until it is exhausted
+            BOOST_REQUIRE_EQUAL(fixed_buffer_ops, 4u);
+            BOOST_REQUIRE_EQUAL(fixed_file_ops, held.size());
+        } else {
+            BOOST_REQUIRE_EQUAL(fixed_buffer_ops, 0u);
+            BOOST_REQUIRE_EQUAL(fixed_file_ops, 0u);
+        }
+        // Larger than a chunk
+        auto big = f.dma_read_bulk<char>(0, wbuf.size()).get0();
+        BOOST_REQUIRE(std::equal(big.begin(), big.end(), wbuf.get(), wbuf.get() + wbuf.size()));
+
+        f.close().get();
+    }).get();
+}
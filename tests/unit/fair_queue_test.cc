@@ -412,3 +412,94 @@ SEASTAR_THREAD_TEST_CASE(test_fair_queue_random_run) {
     auto expected_error = std::max(1, int(round(reqs * 0.05)));
     env.verify(format("random_run ({:d} requests)", reqs), {1, 1}, expected_error);
 }
+
+// Capacity backs off when requests are late and grows back when they are not.
+SEASTAR_THREAD_TEST_CASE(test_fair_queue_latency_target) {
+    fair_queue::config cfg;
+    cfg.max_req_count = 100;
+    cfg.latency_target = 1ms;
+    cfg.latency_quantile = 0.9;
+    cfg.latency_window = 0us;
+    fair_queue fq(cfg);
+    auto pc = fq.register_priority_class(1);
+    auto ticket = fair_queue_ticket(1, 0);
+    unsigned executing = 0;
+
+    auto run = [&] (unsigned queued) {
+        for (unsigned i = 0; i < queued; ++i) {
+            fq.queue(pc, ticket, [&executing] () noexcept { executing++; });
+        }
+        fq.dispatch_requests();
+    };
+    auto complete = [&] (unsigned n, std::chrono::microseconds latency) {
+        for (unsigned i = 0; i < n; ++i) {
+            fq.notify_request_latency(ticket, latency);
+            fq.notify_requests_finished(ticket);
+            executing--;
+        }
+    };
+
+    run(150);
+    BOOST_REQUIRE_EQUAL(executing, 100u);
+    // One fast request sets the baseline, the others are late.
+    complete(1, 100us);
+    complete(9, 5ms);
+    BOOST_REQUIRE(fq.current_capacity() < fair_queue_ticket(100, 2));
+    BOOST_REQUIRE(fair_queue_ticket(50, 0) < fq.current_capacity());
+
+    // Everything is fast while requests wait for capacity.
+    complete(executing, 100us);
+    run(200);
+    BOOST_REQUIRE_EQUAL(executing, 75u);
+    complete(executing, 100us);
+    BOOST_REQUIRE(fair_queue_ticket(75, 0) < fq.current_capacity());
+
+    fq.dispatch_requests();
+    while (executing) {
+        complete(executing, 100us);
+        fq.dispatch_requests();
+    }
+    fq.unregister_priority_class(pc);
+}
+
+// A queue can use the capacity of the queues it shares a group with
+// while they are idle, but they still get their own capacity back.
+SEASTAR_THREAD_TEST_CASE(test_fair_queue_shared_capacity) {
+    fair_group group(fair_queue_ticket(20, 20));
+    fair_queue::config cfg;
+    cfg.max_req_count = 10;
+    cfg.max_bytes_count = 10;
+    cfg.group = &group;
+    fair_queue busy(cfg);
+    fair_queue idle(cfg);
+    auto busy_pc = busy.register_priority_class(1);
+    auto idle_pc = idle.register_priority_class(1);
+    auto ticket = fair_queue_ticket(1, 1);
+    unsigned busy_executing = 0;
+    unsigned idle_executing = 0;
+
+    for (unsigned i = 0; i < 30; ++i) {
+        busy.queue(busy_pc, ticket, [&busy_executing] () noexcept { busy_executing++; });
+    }
+    busy.dispatch_requests();
+    BOOST_REQUIRE_EQUAL(busy_executing, 20u);
+    BOOST_REQUIRE(!group.available());
+
+    for (unsigned i = 0; i < 10; ++i) {
+        idle.queue(idle_pc, ticket, [&idle_executing] () noexcept { idle_executing++; });
+    }
+    idle.dispatch_requests();
+    BOOST_REQUIRE_EQUAL(idle_executing, 10u);
+
+    // Completions return the borrowed capacity to the group.
+    busy.notify_requests_finished(fair_queue_ticket(busy_executing, busy_executing));
+    idle.notify_requests_finished(fair_queue_ticket(idle_executing, idle_executing));
+    busy_executing = idle_executing = 0;
+    busy.dispatch_requests();
+    BOOST_REQUIRE_EQUAL(busy_executing, 10u);
+    busy.notify_requests_finished(fair_queue_ticket(busy_executing, busy_executing));
+    BOOST_REQUIRE(!(group.available() < fair_queue_ticket(20, 20)) && !(fair_queue_ticket(20, 20) < group.available()));
+
+    busy.unregister_priority_class(busy_pc);
+    idle.unregister_priority_class(idle_pc);
+}
@@ -23,12 +23,16 @@
 #include <seastar/testing/thread_test_case.hh>
 
 #include <seastar/core/seastar.hh>
+#include <seastar/core/reactor.hh>
 #include <seastar/core/semaphore.hh>
 #include <seastar/core/condition-variable.hh>
 #include <seastar/core/file.hh>
 #include <seastar/core/thread.hh>
 #include <seastar/core/stall_sampler.hh>
 #include <seastar/core/aligned_buffer.hh>
+#include <seastar/core/cached_file.hh>
+#include <seastar/core/mapped_file.hh>
+#include <seastar/net/api.hh>
 #include <seastar/util/tmp_file.hh>
 
 #include <boost/range/adaptor/transformed.hpp>
@@ -479,3 +483,140 @@ SEASTAR_THREAD_TEST_CASE(test_file_stat_method) {
 
     umask(orig_umask);
 }
+
+SEASTAR_TEST_CASE(test_cached_file) {
+    return tmp_dir::do_with_thread([] (tmp_dir& t) {
+        sstring filename = (t.get_path() / "testfile.tmp").native();
+        block_cache::config cfg;
+        cfg.block_size = 8192;
+        cfg.capacity = 4 * cfg.block_size;
+        cfg.name = "test";
+        block_cache cache(cfg);
+        auto f = make_cached_file(open_file_dma(filename, open_flags::rw | open_flags::create).get0(), cache);
+
+        auto wbuf = allocate_aligned_buffer<char>(4 * 8192, 4096);
+        for (size_t i = 0; i < 4 * 8192; ++i) {
+            wbuf[i] = char(i / 4096);
+        }
+        BOOST_REQUIRE_EQUAL(f.dma_write(0, wbuf.get(), 4 * 8192).get0(), 4 * 8192u);
+
+        // Reads crossing blocks are assembled from whole cached blocks
+        auto buf = f.dma_read_bulk<char>(4096, 8192).get0();
+        BOOST_REQUIRE_EQUAL(buf.size(), 8192u);
+        BOOST_REQUIRE(buf[0] == 1 && buf[8191] == 2);
+        auto stats = cache.get_stats();
+        BOOST_REQUIRE_EQUAL(stats.misses, 2u);
+        BOOST_REQUIRE_EQUAL(stats.hits, 0u);
+
+        buf = f.dma_read_bulk<char>(0, 4096).get0();
+        BOOST_REQUIRE(buf[0] == 0);
+        BOOST_REQUIRE_EQUAL(cache.get_stats().hits, 1u);
+        BOOST_REQUIRE_EQUAL(cache.get_stats().misses, 2u);
+
+        // Writes drop the blocks they touch
+        ::memset(wbuf.get(), 9, 4096);
+        f.dma_write(8192, wbuf.get(), 4096).get();
+        buf = f.dma_read_bulk<char>(8192, 4096).get0();
+        BOOST_REQUIRE(buf[0] == 9);
+        BOOST_REQUIRE_EQUAL(cache.get_stats().misses, 3u);
+
+        // Reading more than fits evicts the least recently used blocks
+        f.dma_read_bulk<char>(0, 4 * 8192).get();
+        f.dma_read_bulk<char>(2 * 8192, 4096).get();
+        BOOST_REQUIRE_LE(cache.get_stats().bytes, cfg.capacity);
+        cache.set_capacity(8192);
+        BOOST_REQUIRE_EQUAL(cache.get_stats().bytes, 8192u);
+        auto misses = cache.get_stats().misses;
+        f.dma_read_bulk<char>(2 * 8192, 4096).get();
+        BOOST_REQUIRE_EQUAL(cache.get_stats().misses, misses);
+
+        f.close().get();
+        BOOST_REQUIRE_EQUAL(cache.get_stats().bytes, 0u);
+    });
+}
+
+SEASTAR_TEST_CASE(test_mapped_file) {
+    return tmp_dir::do_with_thread([] (tmp_dir& t) {
+        sstring filename = (t.get_path() / "testfile.tmp").native();
+        auto f = open_file_dma(filename, open_flags::rw | open_flags::create).get0();
+        auto wbuf = allocate_aligned_buffer<char>(4096, 4096);
+        for (size_t i = 0; i < 4096; ++i) {
+            wbuf[i] = char(i);
+        }
+        f.dma_write(0, wbuf.get(), 4096).get();
+        f.truncate(1000).get();
+        f.close().get();
+
+        auto m = map_file_read_only(filename).get0();
+        BOOST_REQUIRE_EQUAL(m.size(), 1000u);
+        auto buf = m.read(10, 100);
+        BOOST_REQUIRE_EQUAL(buf.size(), 100u);
+        BOOST_REQUIRE_EQUAL(buf[0], char(10));
+        buf = m.read(990, 100);
+        BOOST_REQUIRE_EQUAL(buf.size(), 10u);
+        BOOST_REQUIRE(m.read(1000, 1).empty());
+
+        // Views keep the mapping alive
+        buf = m.get();
+        m = mapped_file();
+        BOOST_REQUIRE_EQUAL(buf[999], char(999));
+
+        BOOST_REQUIRE_THROW(map_file_read_only((t.get_path() / "missing").native()).get(), compat::filesystem::filesystem_error);
+    });
+}
+
+SEASTAR_TEST_CASE(test_socket_sendfile) {
+    return tmp_dir::do_with_thread([] (tmp_dir& t) {
+        sstring filename = (t.get_path() / "testfile.tmp").native();
+        auto f = open_file_dma(filename, open_flags::rw | open_flags::create).get0();
+        size_t size = 256 * 1024;
+        auto wbuf = allocate_aligned_buffer<char>(size, 4096);
+        for (size_t i = 0; i < size; ++i) {
+            wbuf[i] = char(i * 7);
+        }
+        f.dma_write(0, wbuf.get(), size).get();
+        block_cache cache(block_cache::config{});
+        auto cached = make_cached_file(f, cache);
+
+        auto listener = seastar::listen(make_ipv4_address({"127.0.0.1", 0}));
+        auto send_and_receive = [&] (file src, uint64_t pos, uint64_t len) {
+            auto sender = seastar::async([&] {
+                auto s = listener.accept().get0().connection;
+                auto out = s.output();
+                try {
+                    out.write("head").get();
+                    out.write(src, pos, len).get();
+                    out.write("tail").get();
+                    out.close().get();
+                } catch (...) {
+                    s.shutdown_output();
+                    throw;
+                }
+            });
+            auto s = connect(listener.local_address()).get0();
+            auto in = s.input();
+            std::string received;
+            while (auto buf = in.read().get0()) {
+                received.append(buf.get(), buf.size());
+            }
+            sender.get();
+            return received;
+        };
+
+        // Posix files are sent by the kernel, other files are copied. So are
+        // O_DIRECT files at unaligned offsets on kernels that can't send them.
+        for (auto src : {f, cached}) {
+            for (uint64_t pos : {uint64_t(1000), uint64_t(4096)}) {
+                auto received = send_and_receive(src, pos, size - pos);
+                BOOST_REQUIRE_EQUAL(received.size(), size - pos + 8);
+                BOOST_REQUIRE(received.compare(0, 4, "head") == 0);
+                BOOST_REQUIRE(received.compare(4, size - pos, wbuf.get() + pos, size - pos) == 0);
+                BOOST_REQUIRE(received.compare(size - pos + 4, 4, "tail") == 0);
+            }
+            BOOST_REQUIRE_THROW(send_and_receive(src, size - 10, 20), file::eof_error);
+        }
+
+        listener.abort_accept();
+        cached.close().get();
+    });
+}
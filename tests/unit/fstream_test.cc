@@ -518,3 +518,84 @@ SEASTAR_TEST_CASE(test_fstream_slow_start) {
         read_while_file_at_full_speed(make_fstream());
     });
 }
+
+SEASTAR_TEST_CASE(test_fstream_adaptive_read_ahead) {
+    return seastar::async([] {
+        static constexpr size_t file_size = 64 * 1024 * 1024;
+        static constexpr size_t buffer_size = 64 * 1024;
+        static constexpr size_t max_buffer_size = 1024 * 1024;
+
+        auto mock_file = make_shared<mock_read_only_file>(file_size);
+        mock_file->set_allowed_read_requests(std::numeric_limits<size_t>::max());
+
+        file_input_stream_options options{};
+        options.buffer_size = buffer_size;
+        options.read_ahead = 1;
+        options.adaptive_read_ahead = true;
+        options.max_buffer_size = max_buffer_size;
+        options.max_read_ahead = 4;
+
+        size_t last_read_size = 0;
+        mock_file->set_read_size_verifier([&] (size_t length) {
+            BOOST_CHECK_GE(length, buffer_size);
+            BOOST_CHECK_LE(length, max_buffer_size);
+            last_read_size = length;
+        });
+
+        auto in = make_file_input_stream(file(mock_file), 0, file_size, options);
+        auto close_in = defer([&in] { in.close().get(); });
+
+        // A sequential scan grows the buffer size up to the limit.
+        uint64_t total_read = 0;
+        while (last_read_size < max_buffer_size) {
+            BOOST_REQUIRE_LT(total_read, file_size / 2);
+            total_read += in.read().get0().size();
+        }
+
+        // Skipping shrinks it back.
+        in.skip(4 * max_buffer_size).get();
+        in.read().get();
+        BOOST_REQUIRE_EQUAL(last_read_size, buffer_size);
+
+        // Without memory for read-ahead the buffer size stays put.
+        set_file_input_stream_read_ahead_memory_limit(0);
+        auto restore_limit = defer([] { set_file_input_stream_read_ahead_memory_limit(64 * 1024 * 1024); });
+        in.skip(4 * max_buffer_size).get();
+        for (int i = 0; i < 16; ++i) {
+            in.read().get();
+            BOOST_REQUIRE_EQUAL(last_read_size, buffer_size);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_fstream_coalesced_writes) {
+    return tmp_dir::do_with_thread([] (tmp_dir& t) {
+        auto filename = (t.get_path() / "testfile.tmp").native();
+        auto f = open_file_dma(filename, open_flags::rw | open_flags::create | open_flags::truncate).get0();
+
+        file_output_stream_options options;
+        options.buffer_size = 4096;
+        options.write_behind = 2;
+        options.max_coalesced_write = 64 * 1024;
+        auto out = make_file_output_stream(std::move(f), options);
+
+        // Many small buffers back up behind the write-behind slots and are
+        // merged; the unaligned tail is padded and truncated away.
+        static constexpr size_t file_size = 4 * 1024 * 1024 + 100;
+        std::vector<char> data(file_size);
+        for (size_t i = 0; i < file_size; ++i) {
+            data[i] = char(i * 7 + i / 4096);
+        }
+        for (size_t pos = 0; pos < file_size; pos += 1000) {
+            out.write(data.data() + pos, std::min<size_t>(1000, file_size - pos)).get();
+        }
+        out.close().get();
+
+        f = open_file_dma(filename, open_flags::ro).get0();
+        BOOST_REQUIRE_EQUAL(f.size().get0(), file_size);
+        auto in = make_file_input_stream(std::move(f));
+        auto buf = in.read_exactly(file_size).get0();
+        in.close().get();
+        BOOST_REQUIRE(std::equal(buf.begin(), buf.end(), data.begin(), data.end()));
+    });
+}
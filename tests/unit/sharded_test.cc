@@ -98,3 +98,36 @@ SEASTAR_THREAD_TEST_CASE(invoke_map_returns_future_value_from_thread) {
     }).get();
     s.stop().get();
 }
+
+SEASTAR_THREAD_TEST_CASE(broadcast_reaches_all_shards) {
+    seastar::sharded<mydata> s;
+    s.start().get();
+    const int value = 7;
+    s.broadcast([value] (mydata& m) {
+        m.x = value + this_shard_id();
+    }).get();
+    s.map([] (mydata& m) {
+        return m.x - int(this_shard_id());
+    }).then([] (std::vector<int> results) {
+        BOOST_REQUIRE_EQUAL(results.size(), smp::count);
+        for (auto& x : results) {
+            BOOST_REQUIRE_EQUAL(x, 7);
+        }
+    }).get();
+    s.stop().get();
+}
+
+SEASTAR_THREAD_TEST_CASE(broadcast_propagates_exception) {
+    struct broadcast_error {};
+    std::vector<int> counts(smp::count);
+    BOOST_REQUIRE_THROW(smp::broadcast([&counts] {
+        counts[this_shard_id()]++;
+        if (this_shard_id() == smp::count - 1) {
+            return make_exception_future<>(broadcast_error());
+        }
+        return make_ready_future<>();
+    }).get(), broadcast_error);
+    for (auto c : counts) {
+        BOOST_REQUIRE_EQUAL(c, 1);
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+// Cross-shard message batching. The test is run with
+// --smp-local-batch-size and --smp-remote-batch-size set to values that are
+// not a multiple of a cache line of messages, so they are rounded up.
+
+#include <seastar/testing/test_case.hh>
+#include <seastar/testing/thread_test_case.hh>
+#include <seastar/core/smp.hh>
+#include <seastar/core/future-util.hh>
+#include <boost/range/irange.hpp>
+
+using namespace seastar;
+
+// Messages from shard s carry s * shard_base plus their sequence number
+static constexpr uint64_t shard_base = 1000000;
+
+// Sends n messages from every shard to every other shard at once, and
+// checks that each one is executed on its destination and answered. The
+// results are checked back on the test shard, Boost.Test is not thread safe.
+static void exchange_messages(unsigned n) {
+    auto bad = map_reduce(boost::irange(0u, smp::count), [n] (unsigned from) {
+        return smp::submit_to(from, [n, from] {
+            return map_reduce(boost::irange(0u, smp::count), [n, from] (unsigned to) {
+                if (to == from) {
+                    return make_ready_future<unsigned>(0);
+                }
+                return map_reduce(boost::irange(0u, n), [from, to] (unsigned i) {
+                    return smp::submit_to(to, [from, to, i] {
+                        return this_shard_id() == to ? uint64_t(from) * shard_base + i : uint64_t(0);
+                    });
+                }, uint64_t(0), std::plus<uint64_t>()).then([n, from] (uint64_t sum) {
+                    return unsigned(sum != uint64_t(from) * shard_base * n + uint64_t(n) * (n - 1) / 2);
+                });
+            }, 0u, std::plus<unsigned>());
+        });
+    }, 0u, std::plus<unsigned>()).get0();
+    BOOST_REQUIRE_EQUAL(bad, 0u);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_many_cross_shard_messages) {
+    // Several times the ring length, so the queue fills up and the
+    // batches are published as the other side makes room.
+    exchange_messages(20000);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_partial_batches) {
+    // Counts below and around the batch sizes. A partial batch is not
+    // left behind waiting for more messages.
+    for (auto n : {1u, 2u, 7u, 8u, 9u, 31u, 33u, 127u, 129u}) {
+        exchange_messages(n);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/included/unit_test.hpp>
+#include <seastar/net/tcp-congestion.hh>
+
+using namespace seastar;
+using namespace net;
+using namespace std::chrono_literals;
+
+static constexpr uint16_t mss = 1000;
+
+// Sends over a path with the given bottleneck bandwidth and base RTT for
+// the given number of round trips, acknowledging one segment at a time.
+// Data in flight beyond the path's BDP queues up and delays the round.
+static uint32_t run_path(tcp_congestion_controller& cc, lowres_clock::time_point& now, uint32_t cwnd, uint32_t ssthresh,
+        uint64_t bytes_per_second, std::chrono::milliseconds base_rtt, unsigned rounds) {
+    uint64_t delivered = 0;
+    for (unsigned r = 0; r < rounds; r++) {
+        auto in_flight = cwnd;
+        auto rtt = std::max(base_rtt, std::chrono::milliseconds(in_flight * 1000 / bytes_per_second));
+        auto segs = in_flight / mss;
+        for (unsigned i = 1; i <= segs; i++) {
+            delivered += mss;
+            auto ev = tcp_congestion_event{now + rtt * i / segs, mss, in_flight, mss, delivered, rtt, rtt};
+            cc.on_ack(cwnd, ssthresh, ev);
+        }
+        now += rtt;
+    }
+    return cwnd;
+}
+
+BOOST_AUTO_TEST_CASE(test_reno) {
+    auto cc = make_tcp_congestion_controller(tcp_congestion_control::reno);
+    uint32_t cwnd = 10 * mss;
+    auto ev = tcp_congestion_event{lowres_clock::time_point(1s), mss, cwnd, 2 * mss, 0, 10ms, 10ms};
+    cc->on_ack(cwnd, 64 * mss, ev);
+    BOOST_REQUIRE_EQUAL(cwnd, 11 * mss);
+    cc->on_ack(cwnd, 0, ev);
+    BOOST_REQUIRE_EQUAL(cwnd, 11 * mss + mss / 11);
+    BOOST_REQUIRE_EQUAL(cc->on_loss(cwnd, ev, false), 5 * mss);
+}
+
+BOOST_AUTO_TEST_CASE(test_cubic_recovers_the_window) {
+    auto cc = make_tcp_congestion_controller(tcp_congestion_control::cubic);
+    uint32_t cwnd = 1000 * mss;
+    auto now = lowres_clock::time_point(1s);
+    auto ev = tcp_congestion_event{now, mss, cwnd, 0, 0, 100ms, 100ms};
+    auto ssthresh = cc->on_loss(cwnd, ev, false);
+    BOOST_REQUIRE_EQUAL(ssthresh, 700 * mss);
+
+    // K = cbrt(300 / 0.4) is about 9 seconds, or 90 rounds of 100ms. Reno
+    // would have grown by one segment a round instead.
+    cwnd = run_path(*cc, now, ssthresh, ssthresh, uint64_t(100) * 1000 * 1000, 100ms, 80);
+    BOOST_REQUIRE_GT(cwnd, 950 * mss);
+    BOOST_REQUIRE_LE(cwnd, 1000 * mss);
+    cwnd = run_path(*cc, now, cwnd, ssthresh, uint64_t(100) * 1000 * 1000, 100ms, 40);
+    BOOST_REQUIRE_GT(cwnd, 1000 * mss);
+}
+
+BOOST_AUTO_TEST_CASE(test_bbr_follows_the_bdp) {
+    auto cc = make_tcp_congestion_controller(tcp_congestion_control::bbr);
+    // 10MB/s with a 50ms RTT makes a 500kB BDP
+    uint32_t bdp = 500 * 1000;
+    auto now = lowres_clock::time_point(1s);
+    auto cwnd = run_path(*cc, now, 10 * mss, 10 * mss, 10 * 1000 * 1000, 50ms, 60);
+    BOOST_REQUIRE_GE(cwnd, bdp * 3 / 2);
+    BOOST_REQUIRE_LE(cwnd, bdp * 5 / 2);
+
+    // Losses do not shrink the window
+    auto ev = tcp_congestion_event{now, mss, cwnd, 0, 0, 50ms, 50ms};
+    BOOST_REQUIRE_GE(cc->on_loss(cwnd, ev, false), cwnd);
+}
+
+BOOST_AUTO_TEST_CASE(test_pacing_rate) {
+    auto cc = make_tcp_congestion_controller(tcp_congestion_control::reno);
+    uint32_t cwnd = 100 * mss;
+    // No RTT sample yet, no pacing
+    auto ev = tcp_congestion_event{lowres_clock::time_point(1s), mss, cwnd, 0, 0, 0ms, 0ms};
+    BOOST_REQUIRE_EQUAL(cc->pacing_rate(cwnd, 0, ev), 0);
+    // A 100kB window over 10ms makes 10MB/s
+    ev = tcp_congestion_event{lowres_clock::time_point(1s), mss, cwnd, 0, 0, 10ms, 10ms};
+    BOOST_REQUIRE_EQUAL(cc->pacing_rate(cwnd, 0, ev), 12 * 1000 * 1000);
+    BOOST_REQUIRE_EQUAL(cc->pacing_rate(cwnd, 2 * cwnd, ev), 20 * 1000 * 1000);
+
+    // Once BBR has a model it paces at about the bottleneck bandwidth
+    cc = make_tcp_congestion_controller(tcp_congestion_control::bbr);
+    auto now = lowres_clock::time_point(1s);
+    cwnd = run_path(*cc, now, 10 * mss, 10 * mss, 10 * 1000 * 1000, 50ms, 60);
+    ev = tcp_congestion_event{now, mss, cwnd, 0, 0, 50ms, 50ms};
+    auto rate = cc->pacing_rate(cwnd, 0, ev);
+    BOOST_REQUIRE_GE(rate, 10 * 1000 * 1000 * 3 / 4);
+    BOOST_REQUIRE_LE(rate, 10 * 1000 * 1000 * 5 / 4);
+}
@@ -0,0 +1,532 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+// Runs a native stack connection against a peer played by the test, which
+// hands it crafted segments and inspects the ones it sends.
+
+#include <seastar/testing/thread_test_case.hh>
+#include <seastar/core/sleep.hh>
+#include <seastar/net/ip.hh>
+#include <seastar/net/tcp.hh>
+#include <seastar/net/api.hh>
+#include <vector>
+
+using namespace seastar;
+using namespace net;
+using namespace std::chrono_literals;
+
+static const ipv4_address local_ip("10.0.0.1");
+static const ipv4_address peer_ip("10.0.0.2");
+static constexpr uint16_t peer_port = 80;
+static constexpr uint16_t peer_window = 65535;
+static const net::tcp_seq peer_isn = make_seq(1000000);
+
+struct test_netif {
+    uint16_t hw_queues_count() { return 1; }
+    unsigned hash2cpu(uint32_t hash) { return this_shard_id(); }
+    rss_key_type rss_key() const { return default_rsskey_40bytes; }
+};
+
+struct test_ip {
+    test_netif _netif;
+    net::hw_features _hw_features;
+    test_ip() {
+        _hw_features.rx_csum_offload = true;
+        _hw_features.tx_csum_l4_offload = true;
+    }
+    ipv4_address host_address() { return local_ip; }
+    const net::hw_features& hw_features() const { return _hw_features; }
+    test_netif* netif() { return &_netif; }
+};
+
+struct test_l4 {
+    test_ip _inet;
+    ipv4_traits::packet_provider_type _provider;
+    void register_packet_provider(ipv4_traits::packet_provider_type func) {
+        _provider = std::move(func);
+    }
+    future<ethernet_address> get_l2_dst_address(ipv4_address to) {
+        return make_ready_future<ethernet_address>();
+    }
+};
+
+struct test_traits {
+    using address_type = ipv4_address;
+    using inet_type = test_l4;
+    using l4packet = ipv4_traits::l4packet;
+    using packet_provider_type = ipv4_traits::packet_provider_type;
+    static void tcp_pseudo_header_checksum(checksummer& csum, ipv4_address src, ipv4_address dst, uint16_t len) {
+        ipv4_traits::tcp_pseudo_header_checksum(csum, src, dst, len);
+    }
+    static constexpr uint8_t ip_hdr_len_min = ipv4_hdr_len_min;
+};
+
+// A segment sent by the connection
+struct segment {
+    tcp_hdr h;
+    uint32_t len;
+    tcp_option::sack_blocks sack;
+    bool has_ts;
+    tcp_option::timestamps ts;
+
+    net::tcp_seq end() const {
+        return h.seq + len;
+    }
+};
+
+struct options_writer {
+    char buf[40];
+    uint8_t size = 0;
+
+    template <typename Option>
+    void add(const Option& o) {
+        o.write(buf + size);
+        size += Option::len;
+    }
+    void add(const tcp_option::sack_blocks& sack) {
+        sack.write(buf + size);
+        size += sack.size();
+    }
+    void pad() {
+        while (size % tcp_option::align) {
+            add(tcp_option::nop());
+        }
+    }
+};
+
+using sack_list = std::vector<std::pair<net::tcp_seq, net::tcp_seq>>;
+
+// A connection to the peer, established by the constructor. The peer
+// offers timestamps if asked to.
+class tcp_fixture {
+    test_l4 _l4;
+    tcp<test_traits> _tcp{_l4};
+    bool _timestamps;
+public:
+    tcp<test_traits>::connection conn;
+    segment syn;
+    // The timestamp the peer sends, and the one it echoes, by default the
+    // last one received
+    uint32_t ts_val = 1000;
+    uint32_t ts_ecr = 0;
+
+    explicit tcp_fixture(bool timestamps = false)
+        : _timestamps(timestamps)
+        , conn(_tcp.connect(make_ipv4_address({"10.0.0.2", peer_port}))) {
+        auto segs = drain();
+        BOOST_REQUIRE_EQUAL(segs.size(), 1u);
+        syn = segs[0];
+        BOOST_REQUIRE(syn.h.f_syn);
+
+        options_writer o;
+        o.add(tcp_option::mss{1460});
+        o.add(tcp_option::win_scale{0});
+        o.add(tcp_option::sack());
+        add_timestamps(o);
+        auto h = tcp_hdr{};
+        h.seq = peer_isn;
+        h.ack = syn.h.seq + 1;
+        h.f_syn = true;
+        h.f_ack = true;
+        deliver(h, o);
+        conn.connected().get();
+        drain();
+    }
+    ~tcp_fixture() {
+        // Reset the connection, so that none of its timers outlives the stack
+        options_writer o;
+        auto h = tcp_hdr{};
+        h.seq = tcp_tester::rcv(conn).next;
+        h.f_rst = true;
+        deliver(h, o);
+        drain();
+    }
+
+    // Returns the segments the connection sent
+    std::vector<segment> drain() {
+        std::vector<segment> ret;
+        for (;;) {
+            later().get();
+            auto n = ret.size();
+            while (auto l4p = _l4._provider()) {
+                ret.push_back(parse(l4p->p));
+                if (ret.back().has_ts) {
+                    ts_ecr = ret.back().ts.t1;
+                }
+            }
+            if (ret.size() == n) {
+                return ret;
+            }
+        }
+    }
+
+    // Sends nr full-sized segments, with the congestion window out of the way
+    std::vector<segment> write(unsigned nr) {
+        auto& snd = tcp_tester::snd(conn);
+        snd.cwnd = 32 * snd.mss;
+        auto seg_size = snd.mss - tcp_tester::option(conn).get_size(false, true);
+        conn.send(packet(temporary_buffer<char>(nr * seg_size))).get();
+        auto segs = drain();
+        BOOST_REQUIRE_EQUAL(segs.size(), nr);
+        return segs;
+    }
+
+    // Sends a pure ACK
+    void ack(net::tcp_seq ack, const sack_list& blocks = {}) {
+        options_writer o;
+        tcp_option::sack_blocks sack;
+        for (auto& b : blocks) {
+            sack.left[sack.nr] = b.first.raw;
+            sack.right[sack.nr] = b.second.raw;
+            sack.nr++;
+        }
+        add_timestamps(o);
+        if (sack.nr) {
+            o.add(sack);
+        }
+        auto h = tcp_hdr{};
+        h.seq = peer_isn + 1;
+        h.ack = ack;
+        h.f_ack = true;
+        deliver(h, o);
+    }
+
+    // Sends len bytes at the given offset of the peer's stream, and a FIN
+    // after them if asked to
+    void send_data(uint32_t offset, uint32_t len, bool fin = false) {
+        options_writer o;
+        add_timestamps(o);
+        auto h = tcp_hdr{};
+        h.seq = peer_isn + 1 + offset;
+        h.ack = syn.h.seq + 1;
+        h.f_ack = true;
+        h.f_fin = fin;
+        deliver(h, o, len);
+    }
+private:
+    void add_timestamps(options_writer& o) {
+        if (_timestamps) {
+            o.add(tcp_option::timestamps{ts_val, ts_ecr});
+        }
+    }
+    void deliver(tcp_hdr h, options_writer& o, uint32_t len = 0) {
+        o.pad();
+        packet p;
+        if (len) {
+            temporary_buffer<char> buf(len);
+            std::fill_n(buf.get_write(), len, 'x');
+            p = packet(std::move(buf));
+        }
+        auto hdr_len = tcp_hdr::len + o.size;
+        auto th = p.prepend_uninitialized_header(hdr_len);
+        h.src_port = peer_port;
+        h.dst_port = syn.h.src_port;
+        h.data_offset = hdr_len / 4;
+        h.window = peer_window;
+        h.write(th);
+        std::copy_n(o.buf, o.size, th + tcp_hdr::len);
+        _tcp.received(std::move(p), peer_ip, local_ip);
+    }
+    static segment parse(packet& p) {
+        segment s;
+        s.h = tcp_hdr::read(p.get_header(0, tcp_hdr::len));
+        auto hdr_len = s.h.data_offset * 4;
+        auto opt = reinterpret_cast<uint8_t*>(p.get_header(0, hdr_len)) + tcp_hdr::len;
+        s.sack = tcp_option::parse_sack_blocks(opt, opt + hdr_len - tcp_hdr::len);
+        s.has_ts = tcp_option::parse_timestamps(opt, opt + hdr_len - tcp_hdr::len, s.ts);
+        s.len = p.len() - hdr_len;
+        return s;
+    }
+};
+
+// Blocks are given as offsets of the peer's stream
+static void require_sack(const tcp_option::sack_blocks& sack, std::vector<std::pair<uint32_t, uint32_t>> expected) {
+    BOOST_REQUIRE_EQUAL(size_t(sack.nr), expected.size());
+    for (unsigned i = 0; i < expected.size(); i++) {
+        BOOST_REQUIRE_EQUAL(make_seq(sack.left[i]), peer_isn + 1 + expected[i].first);
+        BOOST_REQUIRE_EQUAL(make_seq(sack.right[i]), peer_isn + 1 + expected[i].second);
+    }
+}
+
+SEASTAR_THREAD_TEST_CASE(test_sack_blocks) {
+    tcp_fixture f;
+    auto received = [&f] (uint32_t offset, uint32_t len) {
+        f.send_data(offset, len);
+        auto segs = f.drain();
+        BOOST_REQUIRE_EQUAL(segs.size(), 1u);
+        return segs[0];
+    };
+
+    // Out-of-order data is acknowledged right away, the most recently
+    // received block first
+    auto s = received(1000, 100);
+    BOOST_REQUIRE_EQUAL(s.h.ack, peer_isn + 1);
+    require_sack(s.sack, {{1000, 1100}});
+    s = received(3000, 100);
+    require_sack(s.sack, {{3000, 3100}, {1000, 1100}});
+    // Adjacent segments make a single block
+    s = received(1100, 100);
+    require_sack(s.sack, {{1000, 1200}, {3000, 3100}});
+    s = received(2000, 100);
+    require_sack(s.sack, {{2000, 2100}, {1000, 1200}, {3000, 3100}});
+    s = received(4000, 100);
+    require_sack(s.sack, {{4000, 4100}, {1000, 1200}, {2000, 2100}, {3000, 3100}});
+    // Without timestamps there is room for four blocks
+    s = received(5000, 100);
+    require_sack(s.sack, {{5000, 5100}, {1000, 1200}, {2000, 2100}, {3000, 3100}});
+
+    // Filling the first hole drops its block
+    s = received(0, 1000);
+    BOOST_REQUIRE_EQUAL(s.h.ack, peer_isn + 1 + 1200);
+    require_sack(s.sack, {{5000, 5100}, {2000, 2100}, {3000, 3100}, {4000, 4100}});
+}
+
+SEASTAR_THREAD_TEST_CASE(test_sack_scoreboard) {
+    tcp_fixture f;
+    auto segs = f.write(8);
+    auto& snd = tcp_tester::snd(f.conn);
+    uint32_t mss = snd.mss;
+    // Keep RACK from marking anything lost
+    snd.min_rtt = 10s;
+
+    f.ack(segs[0].h.seq, {{segs[2].h.seq, segs[4].h.seq}});
+    BOOST_REQUIRE_EQUAL(snd.sacked_bytes, 2 * mss);
+    for (unsigned i = 0; i < segs.size(); i++) {
+        BOOST_REQUIRE_EQUAL(snd.data[i].sacked, i == 2 || i == 3);
+    }
+    // Not more than 2 * SMSS is SACKed above the first two segments
+    BOOST_REQUIRE_EQUAL(snd.nr_lost, 0u);
+
+    // A cumulative ACK into a SACKed segment trims it
+    f.ack(segs[2].h.seq + 500);
+    BOOST_REQUIRE_EQUAL(snd.data.size(), 6u);
+    BOOST_REQUIRE(snd.data.front().sacked);
+    BOOST_REQUIRE_EQUAL(snd.data.front().seq, segs[2].h.seq + 500);
+    BOOST_REQUIRE_EQUAL(snd.data.front().p.len(), mss - 500);
+    BOOST_REQUIRE_EQUAL(snd.sacked_bytes, 2 * mss - 500);
+
+    f.ack(segs[4].h.seq);
+    BOOST_REQUIRE_EQUAL(snd.data.size(), 4u);
+    BOOST_REQUIRE_EQUAL(snd.sacked_bytes, 0u);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_sack_loss_recovery) {
+    tcp_fixture f;
+    // Move SND.UNA past the initial sequence number, losses in the first
+    // window do not start a recovery (RFC6582)
+    f.ack(f.write(1)[0].end());
+    auto segs = f.write(8);
+    auto& snd = tcp_tester::snd(f.conn);
+    snd.min_rtt = 10s;
+
+    f.ack(segs[0].h.seq, {{segs[3].h.seq, segs[5].h.seq}});
+    BOOST_REQUIRE_EQUAL(snd.nr_lost, 0u);
+    BOOST_REQUIRE(f.drain().empty());
+
+    // More than 2 * SMSS is now SACKed above segments 0 and 2, which are
+    // lost, and the first of them is retransmitted
+    f.ack(segs[0].h.seq, {{segs[1].h.seq, segs[2].h.seq}, {segs[3].h.seq, segs[6].h.seq}});
+    for (unsigned i = 1; i < segs.size(); i++) {
+        BOOST_REQUIRE_EQUAL(snd.data[i].lost, i == 2);
+    }
+    auto rtx = f.drain();
+    BOOST_REQUIRE_EQUAL(rtx.size(), 1u);
+    BOOST_REQUIRE_EQUAL(rtx[0].h.seq, segs[0].h.seq);
+
+    // Newly SACKed data lets the other hole out, and nothing else
+    f.ack(segs[0].h.seq, {{segs[1].h.seq, segs[2].h.seq}, {segs[3].h.seq, segs[7].h.seq}});
+    rtx = f.drain();
+    BOOST_REQUIRE_EQUAL(rtx.size(), 1u);
+    BOOST_REQUIRE_EQUAL(rtx[0].h.seq, segs[2].h.seq);
+    BOOST_REQUIRE_EQUAL(snd.nr_lost, 0u);
+    BOOST_REQUIRE_EQUAL(snd.data.back().nr_transmits, 0u);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_rack_reorder_window) {
+    tcp_fixture f;
+    f.ack(f.write(1)[0].end());
+    auto segs = f.write(4);
+    auto& snd = tcp_tester::snd(f.conn);
+    // A reordering window of 100ms
+    snd.min_rtt = 400ms;
+
+    // The segment sent before the SACKed one may only be reordered
+    f.ack(segs[0].h.seq, {{segs[1].h.seq, segs[2].h.seq}});
+    BOOST_REQUIRE(!snd.data.front().lost);
+    BOOST_REQUIRE(f.drain().empty());
+
+    // Until the reordering window expires
+    sleep(300ms).get();
+    auto rtx = f.drain();
+    BOOST_REQUIRE_EQUAL(rtx.size(), 1u);
+    BOOST_REQUIRE_EQUAL(rtx[0].h.seq, segs[0].h.seq);
+    BOOST_REQUIRE_EQUAL(snd.data.front().nr_transmits, 1u);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_timestamps_negotiation) {
+    {
+        tcp_fixture f(true);
+        BOOST_REQUIRE(f.syn.has_ts);
+        BOOST_REQUIRE(tcp_tester::option(f.conn)._timestamps_received);
+        // Every segment carries them from now on, in room taken from the data
+        uint32_t mss = tcp_tester::snd(f.conn).mss;
+        for (auto& s : f.write(2)) {
+            BOOST_REQUIRE(s.has_ts);
+            BOOST_REQUIRE_EQUAL(s.ts.t2, f.ts_val);
+            BOOST_REQUIRE_EQUAL(s.len, mss - 12);
+        }
+    }
+    {
+        // Offered on the SYN, but not used unless the peer sent them too
+        tcp_fixture f;
+        BOOST_REQUIRE(f.syn.has_ts);
+        BOOST_REQUIRE(!tcp_tester::option(f.conn)._timestamps_received);
+        uint32_t mss = tcp_tester::snd(f.conn).mss;
+        for (auto& s : f.write(2)) {
+            BOOST_REQUIRE(!s.has_ts);
+            BOOST_REQUIRE_EQUAL(s.len, mss);
+        }
+    }
+}
+
+SEASTAR_THREAD_TEST_CASE(test_timestamps_recent) {
+    tcp_fixture f(true);
+    // An out-of-order segment is not the one the ACK acknowledges, its
+    // timestamp is not echoed
+    f.ts_val = 2000;
+    f.send_data(1000, 100);
+    auto segs = f.drain();
+    BOOST_REQUIRE_EQUAL(segs.size(), 1u);
+    BOOST_REQUIRE_EQUAL(segs[0].ts.t2, 1000u);
+
+    // The segment filling the hole is
+    f.ts_val = 3000;
+    f.send_data(0, 1000);
+    segs = f.drain();
+    BOOST_REQUIRE_EQUAL(segs.size(), 1u);
+    BOOST_REQUIRE_EQUAL(segs[0].h.ack, peer_isn + 1 + 1100);
+    BOOST_REQUIRE_EQUAL(segs[0].ts.t2, 3000u);
+
+    // TS.Recent does not go back in time
+    f.ts_val = 2500;
+    f.send_data(1100, 100);
+    BOOST_REQUIRE_EQUAL(tcp_tester::option(f.conn)._ts_recent, 3000u);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_timestamps_rtt_samples) {
+    tcp_fixture f(true);
+    auto segs = f.write(2);
+    auto& snd = tcp_tester::snd(f.conn);
+
+    // Every ACK of new data gives a sample, as old as the timestamp it echoes
+    f.ts_ecr = segs[0].ts.t1 - 300;
+    f.ack(segs[0].end());
+    BOOST_REQUIRE_GE(snd.last_rtt.count(), 300);
+    f.ts_ecr = segs[1].ts.t1 - 600;
+    f.ack(segs[1].end());
+    BOOST_REQUIRE_GE(snd.last_rtt.count(), 600);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_sack_blocks_with_timestamps) {
+    tcp_fixture f(true);
+    segment s;
+    for (uint32_t offset = 1000; offset <= 5000; offset += 1000) {
+        f.send_data(offset, 100);
+        auto segs = f.drain();
+        BOOST_REQUIRE_EQUAL(segs.size(), 1u);
+        s = segs[0];
+    }
+    // Timestamps leave room for three blocks, four otherwise (see
+    // test_sack_blocks)
+    BOOST_REQUIRE(s.has_ts);
+    require_sack(s.sack, {{5000, 5100}, {1000, 1100}, {2000, 2100}});
+}
+
+SEASTAR_THREAD_TEST_CASE(test_rto_min) {
+    tcp_fixture f;
+    f.conn.set_rto_min(0ms);
+    BOOST_REQUIRE_EQUAL(tcp_tester::rto_min(f.conn).count(), 1);
+    f.conn.set_rto_min(10min);
+    BOOST_REQUIRE_EQUAL(tcp_tester::rto_min(f.conn).count(), 60000);
+    f.conn.set_rto_min(200ms);
+    BOOST_REQUIRE_EQUAL(tcp_tester::rto_min(f.conn).count(), 200);
+
+    // The RTT to the peer is next to nothing, so the RTO drops to the floor
+    f.ack(f.write(1)[0].end());
+    BOOST_REQUIRE_EQUAL(tcp_tester::rto(f.conn).count(), 200);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_ack_after_woken_tasks) {
+    tcp_fixture f;
+    uint32_t mss = tcp_tester::rcv(f.conn).mss;
+    // The reader runs before the ACK is sent
+    auto woken = f.conn.wait_for_data().then([&f] {
+        return tcp_tester::ack_scheduled(f.conn);
+    });
+
+    // Every second full-sized segment is acknowledged
+    f.send_data(0, mss);
+    f.send_data(mss, mss);
+    BOOST_REQUIRE(tcp_tester::ack_scheduled(f.conn));
+    auto segs = f.drain();
+    BOOST_REQUIRE(woken.get0());
+    BOOST_REQUIRE_EQUAL(segs.size(), 1u);
+    BOOST_REQUIRE_EQUAL(segs[0].len, 0u);
+    BOOST_REQUIRE_EQUAL(segs[0].h.ack, peer_isn + 1 + 2 * mss);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_ack_carried_by_reply) {
+    tcp_fixture f;
+    uint32_t mss = tcp_tester::rcv(f.conn).mss;
+    auto replied = f.conn.wait_for_data().then([&f] {
+        return f.conn.send(packet(temporary_buffer<char>(100)));
+    });
+
+    f.send_data(0, mss);
+    f.send_data(mss, mss);
+    auto segs = f.drain();
+    replied.get();
+    // No pure ACK follows the reply
+    BOOST_REQUIRE_EQUAL(segs.size(), 1u);
+    BOOST_REQUIRE_EQUAL(segs[0].len, 100u);
+    BOOST_REQUIRE_EQUAL(segs[0].h.ack, peer_isn + 1 + 2 * mss);
+    BOOST_REQUIRE(!tcp_tester::ack_scheduled(f.conn));
+}
+
+SEASTAR_THREAD_TEST_CASE(test_immediate_acks) {
+    tcp_fixture f;
+    auto acked = [&f] (uint32_t ack) {
+        BOOST_REQUIRE(!tcp_tester::ack_scheduled(f.conn));
+        auto segs = f.drain();
+        BOOST_REQUIRE_EQUAL(segs.size(), 1u);
+        BOOST_REQUIRE_EQUAL(segs[0].h.ack, peer_isn + 1 + ack);
+    };
+
+    // A duplicate ACK for out-of-order data
+    f.send_data(1000, 100);
+    acked(0);
+    // An ACK for data filling a gap
+    f.send_data(0, 1000);
+    acked(1100);
+    // An ACK for a FIN
+    f.send_data(1100, 0, true);
+    acked(1101);
+}
@@ -0,0 +1,169 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/included/unit_test.hpp>
+#include <seastar/core/timer-wheel.hh>
+#include <seastar/core/timer-set.hh>
+#include <random>
+#include <vector>
+#include <set>
+
+using namespace seastar;
+
+namespace {
+
+struct test_clock {
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<test_clock, duration>;
+    static time_point now() { return time_point(); }
+};
+
+struct test_timer {
+    using clock = test_clock;
+    using time_point = clock::time_point;
+    using duration = clock::duration;
+
+    boost::intrusive::list_member_hook<> link;
+    boost::intrusive::list_member_hook<> ref_link;
+    time_point expiry;
+    unsigned id = 0;
+    bool armed = false;
+
+    time_point get_timeout() const { return expiry; }
+    void cancel() { armed = false; }
+};
+
+using wheel_t = timer_wheel<test_timer, &test_timer::link>;
+using set_t = timer_set<test_timer, &test_timer::ref_link>;
+
+template <typename List>
+std::set<unsigned> ids(List&& list) {
+    std::set<unsigned> ret;
+    for (auto& t : list) {
+        ret.insert(t.id);
+    }
+    return ret;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(test_expires_in_order) {
+    wheel_t wheel;
+    std::vector<test_timer> timers(4);
+    int64_t timeouts[] = { 5, 70, 4100, 300000 };
+    for (unsigned i = 0; i < timers.size(); ++i) {
+        timers[i].id = i;
+        timers[i].expiry = test_timer::time_point(test_timer::duration(timeouts[i]));
+        wheel.insert(timers[i]);
+    }
+    BOOST_REQUIRE_EQUAL(wheel.size(), 4u);
+    BOOST_REQUIRE_EQUAL(wheel.get_next_timeout().time_since_epoch().count(), 5);
+
+    for (unsigned i = 0; i < timers.size(); ++i) {
+        auto exp = wheel.expire(test_timer::time_point(test_timer::duration(timeouts[i] - 1)));
+        BOOST_REQUIRE(exp.empty());
+        exp = wheel.expire(test_timer::time_point(test_timer::duration(timeouts[i])));
+        BOOST_REQUIRE_EQUAL(exp.size(), 1u);
+        BOOST_REQUIRE_EQUAL(exp.begin()->id, i);
+        exp.clear();
+        if (i + 1 < timers.size()) {
+            BOOST_REQUIRE_EQUAL(wheel.get_next_timeout().time_since_epoch().count(), timeouts[i + 1]);
+        }
+    }
+    BOOST_REQUIRE(wheel.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_timer_in_the_past_is_due) {
+    wheel_t wheel;
+    wheel.expire(test_timer::time_point(test_timer::duration(1000)));
+
+    test_timer t;
+    t.expiry = test_timer::time_point(test_timer::duration(10));
+    BOOST_REQUIRE(wheel.insert(t));
+    BOOST_REQUIRE_EQUAL(wheel.get_next_timeout().time_since_epoch().count(), 1000);
+    auto exp = wheel.expire(test_timer::time_point(test_timer::duration(1000)));
+    BOOST_REQUIRE_EQUAL(exp.size(), 1u);
+    exp.clear();
+    BOOST_REQUIRE(wheel.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_matches_timer_set_under_churn) {
+    std::default_random_engine rnd(17);
+    std::uniform_int_distribution<int64_t> delay(0, 1 << 20);
+    std::uniform_int_distribution<int64_t> step(0, 1 << 14);
+    std::uniform_int_distribution<int> op(0, 3);
+
+    std::vector<test_timer> timers(2000);
+    for (unsigned i = 0; i < timers.size(); ++i) {
+        timers[i].id = i;
+    }
+    wheel_t wheel;
+    set_t set;
+    int64_t now = 0;
+
+    for (int iter = 0; iter < 100000; ++iter) {
+        auto& t = timers[rnd() % timers.size()];
+        switch (op(rnd)) {
+        case 0:
+        case 1:
+            if (t.armed) {
+                wheel.remove(t);
+                set.remove(t);
+            }
+            t.expiry = test_timer::time_point(test_timer::duration(now + delay(rnd)));
+            t.armed = true;
+            wheel.insert(t);
+            set.insert(t);
+            break;
+        case 2:
+            if (t.armed) {
+                wheel.remove(t);
+                set.remove(t);
+                t.armed = false;
+            }
+            break;
+        case 3: {
+            now += step(rnd);
+            auto tp = test_timer::time_point(test_timer::duration(now));
+            auto wexp = wheel.expire(tp);
+            auto sexp = set.expire(tp);
+            BOOST_REQUIRE(ids(wexp) == ids(sexp));
+            for (auto& e : wexp) {
+                BOOST_REQUIRE(e.get_timeout() <= tp);
+                e.armed = false;
+            }
+            wexp.clear();
+            sexp.clear();
+            for (auto& a : timers) {
+                BOOST_REQUIRE(!a.armed || wheel.get_next_timeout() <= a.get_timeout());
+            }
+            break;
+        }
+        }
+        BOOST_REQUIRE_EQUAL(wheel.size(), set.size());
+    }
+    wheel.clear();
+    set.clear();
+}
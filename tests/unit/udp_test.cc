@@ -0,0 +1,75 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+#include <seastar/testing/thread_test_case.hh>
+#include <seastar/net/api.hh>
+#include <seastar/net/inet_address.hh>
+#include <seastar/core/reactor.hh>
+
+using namespace seastar;
+
+static std::string payload(size_t i, size_t size) {
+    std::string s(size, char('a' + i % 26));
+    if (size >= sizeof(uint32_t)) {
+        uint32_t n = i;
+        memcpy(&s[0], &n, sizeof(n));
+    }
+    return s;
+}
+
+SEASTAR_THREAD_TEST_CASE(test_udp_batches) {
+    auto sc = make_udp_channel(ipv4_addr{"127.0.0.1", 0});
+    auto cc = make_udp_channel(ipv4_addr{"127.0.0.1", 0});
+
+    // Runs of equally sized datagrams, which may be segmented by the kernel,
+    // mixed with datagrams of other sizes
+    std::vector<std::string> expected;
+    std::vector<std::pair<socket_address, net::packet>> batch;
+    // Few enough to fit in the socket's receive buffer
+    for (size_t i = 0; i < 60; ++i) {
+        size_t size = i % 20 < 12 ? 1000 : i % 20 < 16 ? 300 : 1000 + i;
+        expected.push_back(payload(i, size));
+        batch.emplace_back(sc.local_address(), net::packet(expected.back().data(), size));
+    }
+    cc.send_batch(std::move(batch)).get();
+
+    std::vector<std::string> received;
+    while (received.size() < expected.size()) {
+        auto dgrams = sc.receive_batch(32).get0();
+        BOOST_REQUIRE(!dgrams.empty());
+        BOOST_REQUIRE_LE(dgrams.size(), 32u);
+        for (auto&& d : dgrams) {
+            BOOST_REQUIRE_EQUAL(d.get_src(), cc.local_address());
+            auto& p = d.get_data();
+            p.linearize();
+            received.emplace_back(p.fragments()[0].base, p.len());
+        }
+    }
+    BOOST_REQUIRE(received == expected);
+
+    // Single datagrams still work after batches
+    cc.send(sc.local_address(), "apa").get();
+    auto d = sc.receive().get0();
+    BOOST_REQUIRE_EQUAL(d.get_data().len(), 3u);
+
+    cc.close();
+    sc.close();
+}
@@ -0,0 +1,141 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2020 ScyllaDB Ltd.
+ */
+
+// Socket operations through the io_uring reactor backend. The test is run
+// with --reactor-backend=io_uring, and does nothing where the kernel does
+// not support it (the reactor then falls back to another backend).
+
+#include <seastar/core/reactor.hh>
+#include <seastar/core/sleep.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/testing/test_case.hh>
+#include <seastar/testing/thread_test_case.hh>
+#include <seastar/testing/test_runner.hh>
+#include <seastar/net/api.hh>
+#include "core/reactor_backend.hh"
+#include <sstream>
+
+using namespace seastar;
+using namespace std::chrono_literals;
+
+static bool uring_in_use() {
+    for (auto&& rbs : reactor_backend_selector::available()) {
+        std::ostringstream name;
+        name << rbs;
+        if (name.str() == "io_uring") {
+            return true;
+        }
+    }
+    std::cerr << "io_uring is not supported, skipping\n";
+    return false;
+}
+
+static socket_address random_local_address() {
+    std::default_random_engine& rnd = testing::local_random_engine;
+    auto distr = std::uniform_int_distribution<uint16_t>(12000, 65000);
+    return make_ipv4_address({"127.0.0.1", distr(rnd)});
+}
+
+// Does not wait for the connection, so that the address it was given is
+// gone by the time the reactor submits the request
+static future<connected_socket> connect_detached(uint16_t port) {
+    auto sa = make_ipv4_address({"127.0.0.1", port});
+    return engine().net().connect(sa);
+}
+
+static void clobber_stack() {
+    volatile char junk[4096];
+    for (auto& c : junk) {
+        c = char(0xff);
+    }
+}
+
+SEASTAR_THREAD_TEST_CASE(test_connect_and_read) {
+    if (!uring_in_use()) {
+        return;
+    }
+    auto sa = random_local_address();
+    auto listener = engine().net().listen(sa, listen_options());
+    auto accepted = listener.accept();
+    auto client = engine().net().connect(sa).get0();
+    auto server = accepted.get0().connection;
+
+    // The read is issued before there is anything to read
+    auto in = client.input();
+    auto read = in.read();
+    auto out = server.output();
+    out.write("ping").get();
+    out.flush().get();
+    auto buf = read.get0();
+    BOOST_REQUIRE_EQUAL(sstring(buf.get(), buf.size()), "ping");
+
+    out.close().get();
+    BOOST_REQUIRE(in.read().get0().empty());
+    listener.abort_accept();
+}
+
+SEASTAR_THREAD_TEST_CASE(test_close_while_reading) {
+    if (!uring_in_use()) {
+        return;
+    }
+    auto sa = random_local_address();
+    auto listener = engine().net().listen(sa, listen_options());
+    auto accepted = listener.accept();
+    auto client = std::make_unique<connected_socket>(engine().net().connect(sa).get0());
+    auto server = accepted.get0().connection;
+
+    // Drop the socket while a receive is in flight in the ring. The receive
+    // is cancelled rather than left to complete into freed memory, and the
+    // socket is really closed.
+    auto in = std::make_unique<input_stream<char>>(client->input());
+    auto read = in->read();
+    sleep(10ms).get();
+    in.reset();
+    client.reset();
+    BOOST_REQUIRE_THROW(read.get(), std::system_error);
+
+    auto server_in = server.input();
+    auto eof = server_in.read();
+    BOOST_REQUIRE(with_timeout(lowres_clock::now() + 10s, std::move(eof)).get0().empty());
+    listener.abort_accept();
+}
+
+SEASTAR_THREAD_TEST_CASE(test_connect_after_caller_returned) {
+    if (!uring_in_use()) {
+        return;
+    }
+    auto sa = random_local_address();
+    auto listener = engine().net().listen(sa, listen_options());
+    auto accepted = listener.accept();
+    auto connected = connect_detached(sa.port());
+    clobber_stack();
+    auto client = connected.get0();
+    auto server = accepted.get0().connection;
+
+    auto out = client.output();
+    out.write("ping").get();
+    out.flush().get();
+    auto in = server.input();
+    auto buf = in.read().get0();
+    BOOST_REQUIRE_EQUAL(sstring(buf.get(), buf.size()), "ping");
+    out.close().get();
+    listener.abort_accept();
+}